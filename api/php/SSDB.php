@@ -124,7 +124,7 @@ class SSDB
 		}
 		foreach($this->batch_cmds as $op){
 			list($cmd, $params) = $op;
-			$resp = $this->recv_resp($cmd);
+			$resp = $this->recv_resp($cmd, $params);
 			$resp = $this->check_easy_resp($cmd, $resp);
 			$ret[] = $resp;
 		}
@@ -158,7 +158,7 @@ class SSDB
 			if($this->send_req($cmd, $params) === false){
 				$resp = new SSDB_Response('error', 'send error');
 			}else{
-				$resp = $this->recv_resp($cmd);
+				$resp = $this->recv_resp($cmd, $params);
 			}
 		}catch(SSDBException $e){
 			if($this->_easy){
@@ -517,7 +517,7 @@ class SSDB
 		return $this->send($req);
 	}
 
-	private function recv_resp($cmd){
+	private function recv_resp($cmd, $params=array()){
 		$resp = $this->recv();
 		if($resp === false){
 			return new SSDB_Response('error', 'Unknown error');
@@ -572,9 +572,28 @@ class SSDB
 			case 'qget':
 			case 'qfront':
 			case 'qback':
+				if($resp[0] == 'ok'){
+					if(count($resp) == 2){
+						return new SSDB_Response('ok', $resp[1]);
+					}else{
+						return new SSDB_Response('server_error', 'Invalid response');
+					}
+				}else{
+					$errmsg = isset($resp[1])? $resp[1] : '';
+					return new SSDB_Response($resp[0], $errmsg);
+				}
+				break;
 			case 'qpop':
 			case 'qpop_front':
 			case 'qpop_back':
+				// qpop name size returns an array, even of one or no item
+				if(count($params) > 1){
+					if($resp[0] == 'ok' || $resp[0] == 'not_found'){
+						return new SSDB_Response('ok', array_slice($resp, 1));
+					}
+					$errmsg = isset($resp[1])? $resp[1] : '';
+					return new SSDB_Response($resp[0], $errmsg);
+				}
 				if($resp[0] == 'ok'){
 					if(count($resp) == 2){
 						return new SSDB_Response('ok', $resp[1]);
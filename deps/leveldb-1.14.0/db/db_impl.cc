@@ -122,6 +122,7 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
+      compaction_speed_(options_.compaction_speed),
       db_lock_(NULL),
       shutting_down_(NULL),
       bg_cv_(&mutex_),
@@ -830,14 +831,15 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 		// then sleep 1s/IOs
 		// Added by me@ideawu.com
 		int mbs = current_bytes/1024/1024;
-		if(options_.compaction_speed > 0 && mbs > 1){
-			int count = options_.compaction_speed/mbs;
+		int speed = compaction_speed_;
+		if(speed > 0 && mbs > 1){
+			int count = speed/mbs;
 			if(count < 1){
 				count = 1;
 			}
 			int pause = 1000 * 1000 / count;
 			Log(options_.info_log, "compaction_speed: %d MB, pause: %d us",
-				options_.compaction_speed, pause);
+				speed, pause);
 			env_->SleepForMicroseconds(pause);
 		}
     }
@@ -846,6 +848,10 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 }
 
 
+void DBImpl::SetCompactionSpeed(int speed) {
+  compaction_speed_ = speed;
+}
+
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log,  "Compacted %d@%d + %d@%d files => %lld bytes",
@@ -41,6 +41,7 @@ class DBImpl : public DB {
   virtual bool GetProperty(const Slice& property, std::string* value);
   virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
   virtual void CompactRange(const Slice* begin, const Slice* end);
+  virtual void SetCompactionSpeed(int speed);
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -125,6 +126,10 @@ class DBImpl : public DB {
   bool owns_cache_;
   const std::string dbname_;
 
+  // Initialized from options_.compaction_speed, changed by
+  // SetCompactionSpeed() at any time
+  volatile int compaction_speed_;
+
   // table_cache_ provides its own synchronization
   TableCache* table_cache_;
 
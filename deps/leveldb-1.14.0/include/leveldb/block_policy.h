@@ -0,0 +1,42 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A BlockPolicy lets the block size and the compression of each data
+// block depend on the keys it holds, so that keys of different kinds
+// (point lookups vs. long scans) can be stored in different ways in
+// the same table.
+//
+// Added for ssdb, not in upstream leveldb.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_BLOCK_POLICY_H_
+#define STORAGE_LEVELDB_INCLUDE_BLOCK_POLICY_H_
+
+#include <stddef.h>
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+class Slice;
+
+class BlockPolicy {
+ public:
+  virtual ~BlockPolicy() { }
+
+  // Return the group of "key". A data block only holds keys of the same
+  // group, a new block is started when the group changes.
+  //
+  // "key" is the key passed to TableBuilder::Add(), for a db it is an
+  // internal key, which starts with the user key.
+  virtual int KeyGroup(const Slice& key) const = 0;
+
+  // Approximate size of user data packed per block of "group"
+  virtual size_t BlockSize(int group) const = 0;
+
+  // Compression of blocks of "group"
+  virtual CompressionType Compression(int group) const = 0;
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_BLOCK_POLICY_H_
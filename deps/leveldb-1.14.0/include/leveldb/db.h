@@ -140,6 +140,10 @@ class DB {
   //    db->CompactRange(NULL, NULL);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
 
+  // Change Options::compaction_speed of an opened db, takes effect
+  // from the next compaction output file. 0 means not limited.
+  virtual void SetCompactionSpeed(int speed) {}
+
  private:
   // No copying allowed
   DB(const DB&);
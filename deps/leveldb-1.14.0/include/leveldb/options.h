@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class BlockPolicy;
 class Cache;
 class Comparator;
 class Env;
@@ -142,6 +143,13 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // If non-NULL, block_size and compression of data blocks are chosen
+  // by this policy, according to the keys of each block.
+  // Added for ssdb
+  //
+  // Default: NULL
+  const BlockPolicy* block_policy;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -5,6 +5,7 @@
 #include "leveldb/table_builder.h"
 
 #include <assert.h>
+#include "leveldb/block_policy.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
@@ -29,6 +30,7 @@ struct TableBuilder::Rep {
   int64_t num_entries;
   bool closed;          // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  int block_group;      // BlockPolicy group of keys in data_block
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -55,6 +57,7 @@ struct TableBuilder::Rep {
         closed(false),
         filter_block(opt.filter_policy == NULL ? NULL
                      : new FilterBlockBuilder(opt.filter_policy)),
+        block_group(0),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
   }
@@ -97,6 +100,17 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     assert(r->options.comparator->Compare(key, Slice(r->last_key)) > 0);
   }
 
+  const BlockPolicy* policy = r->options.block_policy;
+  if (policy != NULL) {
+    const int group = policy->KeyGroup(key);
+    if (group != r->block_group) {
+      // Keep keys of different groups in different blocks
+      Flush();
+      if (!ok()) return;
+      r->block_group = group;
+    }
+  }
+
   if (r->pending_index_entry) {
     assert(r->data_block.empty());
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
@@ -115,7 +129,9 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   r->data_block.Add(key, value);
 
   const size_t estimated_block_size = r->data_block.CurrentSizeEstimate();
-  if (estimated_block_size >= r->options.block_size) {
+  const size_t block_size = (policy == NULL) ? r->options.block_size
+                            : policy->BlockSize(r->block_group);
+  if (estimated_block_size >= block_size) {
     Flush();
   }
 }
@@ -147,6 +163,9 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
 
   Slice block_contents;
   CompressionType type = r->options.compression;
+  if (r->options.block_policy != NULL && block == &r->data_block) {
+    type = r->options.block_policy->Compression(r->block_group);
+  }
   // TODO(postrelease): Support more compression options: zlib?
   switch (type) {
     case kNoCompression:
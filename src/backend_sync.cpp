@@ -3,8 +3,29 @@
 #include <errno.h>
 #include <string>
 #include "backend_sync.h"
+#include "t_hash.h"
+#include "t_kv.h"
 #include "util/strings.h"
 
+// a hash write at or before last_key, which was or is a packed hash whose
+// HPACK row is after last_key
+static bool hpack_ahead(const Binlog &log, const std::string &last_key){
+	if(log.cmd() != BinlogCommand::HSET && log.cmd() != BinlogCommand::HDEL){
+		return false;
+	}
+	std::string name, key;
+	if(decode_hash_key(log.key(), &name, &key) == -1){
+		return false;
+	}
+	return encode_hpack_key(name) > last_key;
+}
+
+// a slave decodes kv values as in KV_FORMAT, the plain values of a db not
+// in it, which look like having a ttl header, are sent escaped
+static bool kv_val_to_escape(const SSDB *ssdb, char cmd, const Bytes &val){
+	return cmd == BinlogCommand::KSET && !ssdb->kv_ttl_header && kv_val_has_header(val);
+}
+
 BackendSync::BackendSync(const SSDB *ssdb){
 	thread_quit = false;
 	this->ssdb = ssdb;
@@ -233,10 +254,33 @@ int BackendSync::Client::copy(){
 			cmd = BinlogCommand::KSET;
 		}else if(data_type == DataType::HASH){
 			cmd = BinlogCommand::HSET;
+		}else if(data_type == DataType::HPACK){
+			// a packed small hash is sent as one HSET per field
+			std::string name;
+			hash_fields_t fields;
+			if(decode_hpack_key(key, &name) == -1 || decode_hash_pack(val, &fields) == -1){
+				continue;
+			}
+			for(int i=0; i<(int)fields.size(); i++){
+				std::string hkey = encode_hash_key(name, fields[i].first);
+				Binlog log(this->last_seq, BinlogType::COPY, BinlogCommand::HSET, hkey);
+				log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
+				link->send(log.repr(), fields[i].second);
+			}
+			ret = 1;
+			continue;
 		}else if(data_type == DataType::ZSET){
 			cmd = BinlogCommand::ZSET;
+		}else if(data_type == DataType::DZSET){
+			cmd = BinlogCommand::DZSET;
 		}else if(data_type == DataType::QUEUE){
 			cmd = BinlogCommand::QPUSH_BACK;
+		}else if(data_type == DataType::BITMAP){
+			cmd = BinlogCommand::BSET;
+		}else if(data_type == DataType::HLL){
+			cmd = BinlogCommand::PFSET;
+		}else if(data_type == DataType::XGROUP || data_type == DataType::XPEND){
+			cmd = BinlogCommand::XSET;
 		}else{
 			continue;
 		}
@@ -245,7 +289,11 @@ int BackendSync::Client::copy(){
 		
 		Binlog log(this->last_seq, BinlogType::COPY, cmd, key.Slice());
 		log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
-		link->send(log.repr(), val);
+		if(kv_val_to_escape(backend->ssdb, cmd, val)){
+			link->send(log.repr(), encode_kv_val(val, 0));
+		}else{
+			link->send(log.repr(), val);
+		}
 	}
 	return ret;
 
@@ -290,6 +338,13 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 			}
 			continue;
 		}
+		if(this->status == Client::COPY && this->iter && hpack_ahead(log, this->last_key)){
+			// the rows of the hash are copied, but its packed row is not, the
+			// iterator may send the packed row as it was before this write
+			log_debug("fd: %d, new iterator for a packed hash", link->fd());
+			delete this->iter;
+			this->iter = NULL;
+		}
 		if(this->last_seq != 0 && log.seq() != expect_seq){
 			log_warn("%s:%d fd: %d, OUT_OF_SYNC! log.seq: %" PRIu64 ", expect_seq: %" PRIu64 "",
 				link->remote_ip, link->remote_port,
@@ -325,14 +380,35 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 		case BinlogCommand::ZSET:
 		case BinlogCommand::QPUSH_BACK:
 		case BinlogCommand::QPUSH_FRONT:
+		case BinlogCommand::BSET:
+		case BinlogCommand::PFSET:
+		case BinlogCommand::XSET:
+		case BinlogCommand::DZSET:
 			ret = backend->ssdb->raw_get(log.key(), &val);
+			if(ret == 0 && log.cmd() == BinlogCommand::HSET){
+				// the field may be in a packed small hash
+				std::string name, key;
+				if(decode_hash_key(log.key(), &name, &key) == 0){
+					ret = backend->ssdb->hget(name, key, &val);
+				}
+			}
 			if(ret == -1){
 				log_error("fd: %d, raw_get error!", link->fd());
+			}else if(ret == 0 && (log.cmd() == BinlogCommand::QPUSH_BACK
+				|| log.cmd() == BinlogCommand::QPUSH_FRONT))
+			{
+				// popped or trimmed before synced, the slave still takes the
+				// seq, a later pop or trim log removes it
+				log_trace("fd: %d, %s, item gone", link->fd(), log.dumps().c_str());
+				link->send(log.repr(), "");
 			}else if(ret == 0){
 				//log_debug("%s", hexmem(log.key().data(), log.key().size()).c_str());
 				log_trace("fd: %d, skip not found: %s", link->fd(), log.dumps().c_str());
 			}else{
 				log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
+				if(kv_val_to_escape(backend->ssdb, log.cmd(), val)){
+					val = encode_kv_val(val, 0);
+				}
 				link->send(log.repr(), val);
 			}
 			break;
@@ -341,6 +417,12 @@ int BackendSync::Client::sync(BinlogQueue *logs){
 		case BinlogCommand::ZDEL:
 		case BinlogCommand::QPOP_BACK:
 		case BinlogCommand::QPOP_FRONT:
+		case BinlogCommand::QTRIM_BACK:
+		case BinlogCommand::QTRIM_FRONT:
+		case BinlogCommand::BDEL:
+		case BinlogCommand::PFDEL:
+		case BinlogCommand::XDEL:
+		case BinlogCommand::DZDEL:
 			log_trace("fd: %d, %s", link->fd(), log.dumps().c_str());
 			link->send(log.repr());
 			break;
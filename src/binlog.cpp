@@ -1,4 +1,7 @@
 #include "binlog.h"
+#include "meta_cache.h"
+#include "ztop_cache.h"
+#include "compaction.h"
 #include "util/log.h"
 #include "util/strings.h"
 #include <map>
@@ -99,6 +102,36 @@ std::string Binlog::dumps() const{
 		case BinlogCommand::QPOP_FRONT:
 			str.append("qpop_front ");
 			break;
+		case BinlogCommand::BSET:
+			str.append("bset ");
+			break;
+		case BinlogCommand::BDEL:
+			str.append("bdel ");
+			break;
+		case BinlogCommand::PFSET:
+			str.append("pfset ");
+			break;
+		case BinlogCommand::PFDEL:
+			str.append("pfdel ");
+			break;
+		case BinlogCommand::QTRIM_FRONT:
+			str.append("qtrim_front ");
+			break;
+		case BinlogCommand::QTRIM_BACK:
+			str.append("qtrim_back ");
+			break;
+		case BinlogCommand::XSET:
+			str.append("xset ");
+			break;
+		case BinlogCommand::XDEL:
+			str.append("xdel ");
+			break;
+		case BinlogCommand::DZSET:
+			str.append("dzset ");
+			break;
+		case BinlogCommand::DZDEL:
+			str.append("dzdel ");
+			break;
 	}
 	Bytes b = this->key();
 	str.append(hexmem(b.data(), b.size()));
@@ -108,14 +141,6 @@ std::string Binlog::dumps() const{
 
 /* SyncLogQueue */
 
-static inline std::string encode_seq_key(uint64_t seq){
-	seq = big_endian(seq);
-	std::string ret;
-	ret.push_back(DataType::SYNCLOG);
-	ret.append((char *)&seq, sizeof(seq));
-	return ret;
-}
-
 static inline uint64_t decode_seq_key(const leveldb::Slice &key){
 	uint64_t seq = 0;
 	if(key.size() == (sizeof(uint64_t) + 1) && key.data()[0] == DataType::SYNCLOG){
@@ -127,6 +152,9 @@ static inline uint64_t decode_seq_key(const leveldb::Slice &key){
 
 BinlogQueue::BinlogQueue(leveldb::DB *db){
 	this->db = db;
+	this->meta_cache = NULL;
+	this->ztop_cache = NULL;
+	this->compaction = NULL;
 	this->min_seq = 0;
 	this->last_seq = 0;
 	this->tran_seq = 0;
@@ -194,6 +222,12 @@ void BinlogQueue::begin(){
 
 void BinlogQueue::rollback(){
 	tran_seq = 0;
+	if(meta_cache){
+		meta_cache->rollback();
+	}
+	if(ztop_cache){
+		ztop_cache->rollback();
+	}
 }
 
 leveldb::Status BinlogQueue::commit(){
@@ -202,6 +236,12 @@ leveldb::Status BinlogQueue::commit(){
 	if(s.ok()){
 		last_seq = tran_seq;
 		tran_seq = 0;
+		if(meta_cache){
+			meta_cache->commit();
+		}
+		if(ztop_cache){
+			ztop_cache->commit();
+		}
 	}
 	return s;
 }
@@ -343,6 +383,9 @@ void* BinlogQueue::log_clean_thread_func(void *arg){
 		uint64_t end = logs->last_seq - LOG_QUEUE_SIZE;
 		logs->del_range(start, end);
 		logs->min_seq = end + 1;
+		if(logs->compaction){
+			logs->compaction->add_deletes(encode_seq_key(start), encode_seq_key(end), end - start + 1);
+		}
 		log_info("clean %d logs[%" PRIu64 " ~ %" PRIu64 "], %d left, max: %" PRIu64 "",
 			end-start+1, start, end, logs->last_seq - logs->min_seq + 1, logs->last_seq);
 	}
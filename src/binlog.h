@@ -10,7 +10,19 @@
 #include "leveldb/write_batch.h"
 #include "util/thread.h"
 #include "util/bytes.h"
+#include "util/strings.h"
 
+class MetaCache;
+class ZTopCache;
+class CompactionHandler;
+
+static inline std::string encode_seq_key(uint64_t seq){
+	seq = big_endian(seq);
+	std::string ret;
+	ret.push_back(DataType::SYNCLOG);
+	ret.append((char *)&seq, sizeof(seq));
+	return ret;
+}
 
 class Binlog{
 	private:
@@ -63,6 +75,11 @@ class BinlogQueue{
 		void merge();
 	public:
 		Mutex mutex;
+		// optional, committed/rolled back along with the batch
+		MetaCache *meta_cache;
+		ZTopCache *ztop_cache;
+		// optional, notified of cleaned logs
+		CompactionHandler *compaction;
 
 		BinlogQueue(leveldb::DB *db);
 		~BinlogQueue();
@@ -0,0 +1,387 @@
+#include "compaction.h"
+#include "util/log.h"
+#include "util/strings.h"
+#include "leveldb/iterator.h"
+
+// keep memory bounded if there are too many small ranges
+static const int MAX_DIRTY_RANGES = 10000;
+
+CompactionHandler::CompactionHandler(leveldb::DB *db, int speed, uint64_t max_deletes){
+	this->db = db;
+	this->speed = speed;
+	this->max_deletes = max_deletes;
+	this->compacted_ranges = 0;
+	this->compacted_bytes = 0;
+
+	thread_quit = false;
+	int err = pthread_create(&tid, NULL, &CompactionHandler::thread_func, this);
+	if(err != 0){
+		log_fatal("can't create thread: %s", strerror(err));
+		exit(0);
+	}
+}
+
+CompactionHandler::~CompactionHandler(){
+	thread_quit = true;
+	void *tret;
+	int err = pthread_join(tid, &tret);
+	if(err != 0){
+		log_error("can't join thread: %s", strerror(err));
+	}
+	db = NULL;
+	log_debug("CompactionHandler finalized");
+}
+
+void CompactionHandler::compact_range(const std::string &start, const std::string &end){
+	log_info("compact range begin, \"%s\" - \"%s\"",
+		hexmem(start.data(), start.size()).c_str(),
+		hexmem(end.data(), end.size()).c_str());
+	// Each slice is found with a new iterator, because a living iterator
+	// prevents compacted files from being deleted.
+	std::string slice_start = start;
+	while(!thread_quit){
+		std::string slice_end;
+		bool last_slice = true;
+		{
+			leveldb::ReadOptions opts;
+			opts.fill_cache = false;
+			leveldb::Iterator *it = db->NewIterator(opts);
+			it->Seek(slice_start);
+			for(int n=0; it->Valid(); n++){
+				if(!end.empty() && it->key().compare(end) >= 0){
+					break;
+				}
+				if(n == SLICE_KEYS){
+					slice_end = it->key().ToString();
+					last_slice = false;
+					break;
+				}
+				it->Next();
+			}
+			delete it;
+		}
+		if(last_slice){
+			slice_end = end;
+		}
+		this->compact_slice(slice_start, slice_end);
+		if(last_slice){
+			break;
+		}
+		slice_start = slice_end;
+	}
+
+	Locking l(&mutex);
+	compacted_ranges ++;
+	log_info("compact range end");
+}
+
+void CompactionHandler::compact_slice(const std::string &start, const std::string &end){
+	leveldb::Slice b(start);
+	leveldb::Slice e(end);
+	uint64_t size = 0;
+	{
+		// all keys are less than "\xff"
+		leveldb::Range r(b, end.empty()? leveldb::Slice("\xff", 1) : e);
+		db->GetApproximateSizes(&r, 1, &size);
+	}
+	db->CompactRange(start.empty()? NULL : &b, end.empty()? NULL : &e);
+	{
+		Locking l(&mutex);
+		compacted_bytes += size;
+	}
+
+	if(speed > 0 && size > 0){
+		int64_t pause = (int64_t)(size * 1000 / ((uint64_t)speed * 1024 * 1024));
+		log_debug("compacted %" PRIu64 " bytes, pause: %" PRId64 " ms", size, pause);
+		while(pause > 0 && !thread_quit){
+			usleep((pause > 100? 100 : pause) * 1000);
+			pause -= 100;
+		}
+	}
+}
+
+void CompactionHandler::add_deletes(const std::string &start, const std::string &end, uint64_t count){
+	if(max_deletes == 0 || count == 0){
+		return;
+	}
+	Locking l(&mutex);
+
+	DirtyRange range;
+	range.end = end;
+	range.deletes = count;
+	std::string range_start = start;
+
+	// merge overlapping ranges
+	std::map<std::string, DirtyRange>::iterator it = dirty_ranges.begin();
+	while(it != dirty_ranges.end()){
+		const std::string &s = it->first;
+		const std::string &e = it->second.end;
+		bool overlap = (e.empty() || range_start <= e) && (range.end.empty() || s <= range.end);
+		if(!overlap){
+			it ++;
+			continue;
+		}
+		if(s < range_start){
+			range_start = s;
+		}
+		if(e.empty() || (!range.end.empty() && e > range.end)){
+			range.end = e;
+		}
+		range.deletes += it->second.deletes;
+		dirty_ranges.erase(it++);
+	}
+	if((int)dirty_ranges.size() >= MAX_DIRTY_RANGES){
+		dirty_ranges.erase(dirty_ranges.begin());
+	}
+	dirty_ranges[range_start] = range;
+}
+
+std::string CompactionHandler::stats(){
+	Locking l(&mutex);
+	char buf[160];
+	snprintf(buf, sizeof(buf), "speed: %d MB/s, dirty_ranges: %d, compacted_ranges: %" PRIu64 ", compacted_bytes: %" PRIu64 "",
+		speed, (int)dirty_ranges.size(), compacted_ranges, compacted_bytes);
+	return std::string(buf);
+}
+
+void* CompactionHandler::thread_func(void *arg){
+	CompactionHandler *handler = (CompactionHandler *)arg;
+
+	while(!handler->thread_quit){
+		std::string start, end;
+		bool found = false;
+		{
+			Locking l(&handler->mutex);
+			std::map<std::string, DirtyRange>::iterator it;
+			for(it = handler->dirty_ranges.begin(); it != handler->dirty_ranges.end(); it++){
+				if(it->second.deletes >= handler->max_deletes){
+					start = it->first;
+					end = it->second.end;
+					handler->dirty_ranges.erase(it);
+					found = true;
+					break;
+				}
+			}
+		}
+		if(found){
+			handler->compact_range(start, end);
+		}else{
+			usleep(100 * 1000);
+		}
+	}
+
+	log_debug("CompactionHandler thread_func quit");
+	return (void *)NULL;
+}
+
+
+CompactionScheduler::CompactionScheduler(leveldb::DB *db, int speed){
+	this->db = db;
+	this->default_speed = speed;
+	this->min_speed = 10;
+	this->max_p99_latency = 0;
+	this->max_write_queue = 0;
+	this->max_level0_files = 12;
+
+	memset(latencies, 0, sizeof(latencies));
+	requests = 0;
+	write_queue = 0;
+
+	state = "normal";
+	this->speed = speed;
+	target = speed;
+	window = -1;
+	last_p99 = 0;
+	last_write_queue = 0;
+	last_level0_files = 0;
+
+	thread_quit = false;
+	tid = 0;
+}
+
+CompactionScheduler::~CompactionScheduler(){
+	if(tid){
+		thread_quit = true;
+		void *tret;
+		int err = pthread_join(tid, &tret);
+		if(err != 0){
+			log_error("can't join thread: %s", strerror(err));
+		}
+	}
+	db = NULL;
+	log_debug("CompactionScheduler finalized");
+}
+
+int CompactionScheduler::add_window(const std::string &spec){
+	int h1, m1, h2, m2, speed;
+	if(sscanf(spec.c_str(), "%d:%d-%d:%d %d", &h1, &m1, &h2, &m2, &speed) != 5){
+		return -1;
+	}
+	if(h1 < 0 || h1 > 24 || m1 < 0 || m1 > 59 || h2 < 0 || h2 > 24 || m2 < 0 || m2 > 59 || speed < 0){
+		return -1;
+	}
+	// 24:00 is the end of a day, no time is after it
+	if((h1 == 24 && m1 != 0) || (h2 == 24 && m2 != 0)){
+		return -1;
+	}
+	Window w;
+	w.start = h1 * 60 + m1;
+	w.end = h2 * 60 + m2;
+	w.speed = speed;
+	windows.push_back(w);
+	return 0;
+}
+
+void CompactionScheduler::start(){
+	int err = pthread_create(&tid, NULL, &CompactionScheduler::thread_func, this);
+	if(err != 0){
+		log_fatal("can't create thread: %s", strerror(err));
+		exit(0);
+	}
+}
+
+void CompactionScheduler::add_request(double latency_ms, int write_queue){
+	int i = (int)latency_ms;
+	if(i < 0){
+		i = 0;
+	}else if(i >= LATENCY_BUCKETS){
+		i = LATENCY_BUCKETS - 1;
+	}
+	Locking l(&mutex);
+	latencies[i] ++;
+	requests ++;
+	if(write_queue > this->write_queue){
+		this->write_queue = write_queue;
+	}
+}
+
+int CompactionScheduler::target_speed(int *window) const{
+	time_t now = time(NULL);
+	struct tm tm;
+	localtime_r(&now, &tm);
+	int minute = tm.tm_hour * 60 + tm.tm_min;
+
+	for(int i=0; i<(int)windows.size(); i++){
+		const Window &w = windows[i];
+		bool in;
+		if(w.start <= w.end){
+			in = (minute >= w.start && minute < w.end);
+		}else{
+			in = (minute >= w.start || minute < w.end);
+		}
+		if(in){
+			*window = i;
+			return w.speed;
+		}
+	}
+	*window = -1;
+	return default_speed;
+}
+
+void CompactionScheduler::tick(){
+	int p99 = 0;
+	int queue;
+	{
+		Locking l(&mutex);
+		uint32_t n = 0;
+		uint32_t k = requests - requests / 100;
+		for(int i=0; i<LATENCY_BUCKETS && requests > 0; i++){
+			n += latencies[i];
+			if(n >= k){
+				p99 = i;
+				break;
+			}
+		}
+		queue = write_queue;
+		memset(latencies, 0, sizeof(latencies));
+		requests = 0;
+		write_queue = 0;
+	}
+
+	int level0 = 0;
+	{
+		std::string val;
+		if(db->GetProperty("leveldb.num-files-at-level0", &val)){
+			level0 = str_to_int(val);
+		}
+	}
+
+	int win;
+	int target = this->target_speed(&win);
+	int speed = this->speed;
+	const char *state;
+	if(max_level0_files > 0 && level0 >= max_level0_files){
+		state = "level0";
+		speed = 0;
+	}else if((max_p99_latency > 0 && p99 >= max_p99_latency)
+		|| (max_write_queue > 0 && queue >= max_write_queue))
+	{
+		state = "backoff";
+		speed = min_speed;
+		if(target > 0 && target < speed){
+			speed = target;
+		}
+	}else if(speed > 0 && (target == 0 || speed < target)){
+		// recover from backoff slowly, an unlimited target is
+		// considered reached at 1000 MB/s
+		state = "recover";
+		speed *= 2;
+		if(target > 0 && speed >= target){
+			speed = target;
+			state = "normal";
+		}else if(target == 0 && speed >= 1000){
+			speed = 0;
+			state = "normal";
+		}
+	}else{
+		state = "normal";
+		speed = target;
+	}
+
+	if(speed != this->speed){
+		log_info("compaction_speed: %d => %d MB/s, %s, p99: %d ms, write_queue: %d, level0_files: %d",
+			this->speed, speed, state, p99, queue, level0);
+		db->SetCompactionSpeed(speed);
+	}
+
+	Locking l(&mutex);
+	this->state = state;
+	this->speed = speed;
+	this->target = target;
+	this->window = win;
+	this->last_p99 = p99;
+	this->last_write_queue = queue;
+	this->last_level0_files = level0;
+}
+
+std::string CompactionScheduler::stats(){
+	Locking l(&mutex);
+	char win[32];
+	if(window >= 0){
+		const Window &w = windows[window];
+		snprintf(win, sizeof(win), "%02d:%02d-%02d:%02d",
+			w.start/60, w.start%60, w.end/60, w.end%60);
+	}else{
+		snprintf(win, sizeof(win), "none");
+	}
+	char buf[256];
+	snprintf(buf, sizeof(buf), "state: %s, speed: %d MB/s, target: %d MB/s, window: %s, p99: %d ms, write_queue: %d, level0_files: %d",
+		state, speed, target, win, last_p99, last_write_queue, last_level0_files);
+	return std::string(buf);
+}
+
+void* CompactionScheduler::thread_func(void *arg){
+	CompactionScheduler *scheduler = (CompactionScheduler *)arg;
+
+	int ticks = 0;
+	while(!scheduler->thread_quit){
+		usleep(100 * 1000);
+		if(++ticks == 10){
+			ticks = 0;
+			scheduler->tick();
+		}
+	}
+
+	log_debug("CompactionScheduler thread_func quit");
+	return (void *)NULL;
+}
@@ -0,0 +1,124 @@
+#ifndef SSDB_COMPACTION_H_
+#define SSDB_COMPACTION_H_
+
+#include "include.h"
+#include <string>
+#include <map>
+#include <vector>
+#include <pthread.h>
+#include "leveldb/db.h"
+#include "util/thread.h"
+
+/**
+ * Compacts key ranges instead of the whole db, slice by slice, and
+ * pauses between slices so that disk IO stays under @speed MB/s.
+ *
+ * Ranges which get many deletes(hclear, zclear, qclear, binlog
+ * cleaning...) are recorded by add_deletes(), and compacted in the
+ * background once @max_deletes is reached, to get rid of tombstones.
+ */
+class CompactionHandler{
+	private:
+		static const int SLICE_KEYS = 10000;
+
+		struct DirtyRange{
+			std::string end;
+			uint64_t deletes;
+		};
+
+		leveldb::DB *db;
+		int speed;
+		uint64_t max_deletes;
+		// start => range
+		std::map<std::string, DirtyRange> dirty_ranges;
+		Mutex mutex;
+
+		uint64_t compacted_ranges;
+		uint64_t compacted_bytes;
+
+		volatile bool thread_quit;
+		pthread_t tid;
+		static void* thread_func(void *arg);
+
+		void compact_slice(const std::string &start, const std::string &end);
+	public:
+		// speed: in MB/s, 0 means not limited
+		// max_deletes: 0 means never compact in background
+		CompactionHandler(leveldb::DB *db, int speed, uint64_t max_deletes);
+		~CompactionHandler();
+
+		// compact [start, end], empty end means to the end of db
+		void compact_range(const std::string &start, const std::string &end);
+		// @count keys in [start, end] were deleted
+		void add_deletes(const std::string &start, const std::string &end, uint64_t count);
+
+		std::string stats();
+};
+
+/**
+ * Adjusts leveldb's compaction_speed once a second, by priority:
+ *  - level-0 files reach @max_level0_files: not limited, compaction must
+ *    catch up before leveldb slows down(16 files) or stops writes
+ *  - p99 request latency or writer queue length is over the limit: back
+ *    off to @min_speed, then double each second until back to target
+ *  - otherwise the speed of the current time window, or compaction_speed
+ */
+class CompactionScheduler{
+	private:
+		struct Window{
+			// minutes of the day, end may be less than start(across midnight)
+			int start;
+			int end;
+			int speed;
+		};
+		static const int LATENCY_BUCKETS = 1001; // in ms, last one for >= 1s
+
+		leveldb::DB *db;
+		int default_speed;
+		std::vector<Window> windows;
+
+		Mutex mutex;
+		// stats of requests in the current second
+		uint32_t latencies[LATENCY_BUCKETS];
+		uint32_t requests;
+		int write_queue;
+
+		const char *state;
+		int speed;
+		int target;
+		int window;
+		int last_p99;
+		int last_write_queue;
+		int last_level0_files;
+
+		volatile bool thread_quit;
+		pthread_t tid;
+		static void* thread_func(void *arg);
+
+		int target_speed(int *window) const;
+		void tick();
+	public:
+		// 0 means not checked
+		int min_speed;
+		int max_p99_latency;
+		int max_write_queue;
+		int max_level0_files;
+
+		// speed: leveldb.compaction_speed, in MB/s, 0 means not limited
+		CompactionScheduler(leveldb::DB *db, int speed);
+		~CompactionScheduler();
+		// spec: "hh:mm-hh:mm speed", hh:mm from 00:00 to 24:00
+		// @return -1: bad format, 0: ok
+		int add_window(const std::string &spec);
+		int windows_size() const{
+			return (int)windows.size();
+		}
+		// start adjusting after all params are set
+		void start();
+
+		// called by the server for every request
+		void add_request(double latency_ms, int write_queue);
+		std::string stats();
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "counter.h"
+#include "util/strings.h"
+#include "t_kv.h"
+#include "t_hash.h"
+#include "t_zset.h"
+#include "ttl.h"
+
+CounterBuffer::CounterBuffer(SSDB *ssdb, int interval)
+	: mutex(true), flush_mutex(true)
+{
+	this->ssdb = ssdb;
+	this->interval = interval;
+	this->incrs = 0;
+	this->writes = 0;
+	this->flushes = 0;
+
+	thread_quit = false;
+	int err = pthread_create(&tid, NULL, &CounterBuffer::thread_func, this);
+	if(err != 0){
+		log_fatal("can't create thread: %s", strerror(err));
+		exit(0);
+	}
+}
+
+CounterBuffer::~CounterBuffer(){
+	thread_quit = true;
+	void *tret;
+	int err = pthread_join(tid, &tret);
+	if(err != 0){
+		log_error("can't join thread: %s", strerror(err));
+	}
+	int n = this->flush();
+	log_info("counters flushed: %d", n);
+	ssdb = NULL;
+	log_debug("CounterBuffer finalized");
+}
+
+int CounterBuffer::incr(const Bytes &key, int64_t by, std::string *new_val){
+	return this->merge(DataType::KV, "", key, by, new_val);
+}
+
+int CounterBuffer::hincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val){
+	return this->merge(DataType::HASH, name, key, by, new_val);
+}
+
+int CounterBuffer::zincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val){
+	return this->merge(DataType::ZSET, name, key, by, new_val);
+}
+
+int CounterBuffer::merge(char type, const Bytes &name, const Bytes &key, int64_t by, std::string *new_val){
+	std::string dbkey;
+	if(type == DataType::KV){
+		dbkey = encode_kv_key(key);
+	}else if(type == DataType::HASH){
+		dbkey = encode_hash_key(name, key);
+	}else{
+		dbkey = encode_zset_key(name, key);
+	}
+
+	bool full;
+	{
+		Locking l(&mutex);
+		std::map<std::string, Counter>::iterator it = counters.find(dbkey);
+		if(it == counters.end()){
+			std::map<std::string, Counter>::iterator f = flushing.find(dbkey);
+			if(f != flushing.end()){
+				// being written, db may not have it yet
+				it = counters.insert(*f).first;
+			}
+		}
+		if(it == counters.end()){
+			// first increment since the last flush, read the base value
+			Counter c;
+			c.type = type;
+			c.name = name.String();
+			c.key = key.String();
+			c.expire = 0;
+			std::string old;
+			int ret;
+			if(type == DataType::KV){
+				ret = ssdb->get(key, &old, &c.expire);
+			}else if(type == DataType::HASH){
+				ret = ssdb->hget(name, key, &old);
+			}else{
+				ret = ssdb->zget(name, key, &old);
+			}
+			if(ret == -1){
+				return -1;
+			}
+			c.val = (ret == 0)? 0 : str_to_int64(old.data(), old.size());
+			it = counters.insert(std::make_pair(dbkey, c)).first;
+		}
+		it->second.val += by;
+		*new_val = int64_to_str(it->second.val);
+		incrs ++;
+		full = (int)counters.size() >= MAX_KEYS;
+	}
+	if(full){
+		if(this->flush() == -1){
+			return -1;
+		}
+	}
+	return 1;
+}
+
+int CounterBuffer::get(const Bytes &key, std::string *val){
+	return this->find(encode_kv_key(key), val);
+}
+
+int CounterBuffer::hget(const Bytes &name, const Bytes &key, std::string *val){
+	return this->find(encode_hash_key(name, key), val);
+}
+
+int CounterBuffer::zget(const Bytes &name, const Bytes &key, std::string *score){
+	return this->find(encode_zset_key(name, key), score);
+}
+
+int CounterBuffer::find(const std::string &dbkey, std::string *val){
+	Locking l(&mutex);
+	std::map<std::string, Counter>::const_iterator it = counters.find(dbkey);
+	if(it == counters.end()){
+		it = flushing.find(dbkey);
+		if(it == flushing.end()){
+			return 0;
+		}
+	}
+	const Counter &c = it->second;
+	// expired in buffer, db will tell that too
+	if(c.expire > 0 && c.expire <= time_ms()){
+		return 0;
+	}
+	*val = int64_to_str(c.val);
+	return 1;
+}
+
+int CounterBuffer::size(){
+	Locking l(&mutex);
+	return (int)(counters.size() + flushing.size());
+}
+
+int CounterBuffer::write(const Counter &c){
+	std::string val = int64_to_str(c.val);
+	if(c.type != DataType::KV && ssdb->expiration){
+		// the container expired after the counter was read, it is
+		// deleted along with the counter
+		char size_type = (c.type == DataType::HASH)? DataType::HSIZE : DataType::ZSIZE;
+		if(ssdb->expiration->container_expired(size_type, c.name)){
+			return 0;
+		}
+	}
+	if(c.type == DataType::KV){
+		if(c.expire > 0){
+			// keeps the ttl
+			return ssdb->setx(c.key, val, c.expire);
+		}
+		return ssdb->set(c.key, val);
+	}else if(c.type == DataType::HASH){
+		return ssdb->hset(c.name, c.key, val);
+	}else{
+		return ssdb->zset(c.name, c.key, val);
+	}
+}
+
+// prefix of the db keys of a hash or zset, of all of them if name is empty
+static std::string container_prefix(char type, const Bytes &name){
+	std::string prefix;
+	if(type == DataType::HSIZE){
+		if(name.empty()){
+			return std::string(1, DataType::HASH);
+		}
+		prefix = encode_hash_key(name, "");
+	}else{
+		if(name.empty()){
+			return std::string(1, DataType::ZSET);
+		}
+		prefix = encode_zset_key(name, "");
+		// without the size of the key
+		prefix.resize(prefix.size() - 1);
+	}
+	return prefix;
+}
+
+static bool has_prefix(const std::string &s, const std::string &prefix){
+	return s.compare(0, prefix.size(), prefix) == 0;
+}
+
+int CounterBuffer::flush(){
+	return this->flush_prefix("");
+}
+
+int CounterBuffer::flush(char type, const Bytes &name){
+	if(type == DataType::KV){
+		return this->flush_prefix(std::string(1, DataType::KV));
+	}
+	return this->flush_prefix(container_prefix(type, name));
+}
+
+int CounterBuffer::flush_prefix(const std::string &prefix){
+	{
+		// most reads touch no counter
+		Locking l(&mutex);
+		std::map<std::string, Counter>::iterator it = counters.lower_bound(prefix);
+		std::map<std::string, Counter>::iterator f = flushing.lower_bound(prefix);
+		if((it == counters.end() || !has_prefix(it->first, prefix))
+			&& (f == flushing.end() || !has_prefix(f->first, prefix)))
+		{
+			return 0;
+		}
+	}
+	Locking fl(&flush_mutex);
+	int count = 0;
+	while(1){
+		{
+			Locking l(&mutex);
+			std::map<std::string, Counter>::iterator it = counters.lower_bound(prefix);
+			while((int)flushing.size() < FLUSH_SLICE && it != counters.end()
+				&& has_prefix(it->first, prefix))
+			{
+				flushing.insert(*it);
+				counters.erase(it++);
+			}
+			if(flushing.empty()){
+				if(count > 0){
+					flushes ++;
+				}
+				break;
+			}
+		}
+		// the mutex is not held while writing, so get, hget and zget
+		// never wait for db writes. A write may clear an expired
+		// container and drop counters of the slice.
+		while(1){
+			std::string dbkey;
+			Counter c;
+			{
+				Locking l(&mutex);
+				if(flushing.empty()){
+					break;
+				}
+				dbkey = flushing.begin()->first;
+				c = flushing.begin()->second;
+			}
+			if(this->write(c) == -1){
+				log_error("flush counter error, key: %s",
+					hexmem(dbkey.data(), dbkey.size()).c_str());
+				Locking l(&mutex);
+				// a counter merged since then is newer
+				counters.insert(flushing.begin(), flushing.end());
+				flushing.clear();
+				return -1;
+			}
+			Locking l(&mutex);
+			flushing.erase(dbkey);
+			count ++;
+			writes ++;
+		}
+	}
+	return count;
+}
+
+void CounterBuffer::lock(){
+	flush_mutex.lock();
+	mutex.lock();
+}
+
+void CounterBuffer::unlock(){
+	mutex.unlock();
+	flush_mutex.unlock();
+}
+
+void CounterBuffer::drop(const Bytes &dbkey){
+	counters.erase(dbkey.String());
+	flushing.erase(dbkey.String());
+}
+
+void CounterBuffer::drop_container(char type, const Bytes &name){
+	std::string prefix = container_prefix(type, name);
+	std::map<std::string, Counter> *maps[] = {&counters, &flushing};
+	for(int i=0; i<2; i++){
+		std::map<std::string, Counter>::iterator it = maps[i]->lower_bound(prefix);
+		while(it != maps[i]->end() && has_prefix(it->first, prefix)){
+			maps[i]->erase(it++);
+		}
+	}
+}
+
+std::string CounterBuffer::stats(){
+	Locking l(&mutex);
+	char buf[160];
+	snprintf(buf, sizeof(buf), "interval: %d ms, keys: %d, incrs: %" PRIu64 ", writes: %" PRIu64 ", flushes: %" PRIu64 "",
+		interval, (int)(counters.size() + flushing.size()), incrs, writes, flushes);
+	return std::string(buf);
+}
+
+void* CounterBuffer::thread_func(void *arg){
+	CounterBuffer *buffer = (CounterBuffer *)arg;
+
+	int64_t last = time_ms();
+	while(!buffer->thread_quit){
+		usleep(10 * 1000);
+		int64_t now = time_ms();
+		if(now - last < buffer->interval){
+			continue;
+		}
+		last = now;
+		buffer->flush();
+	}
+
+	log_debug("CounterBuffer thread_func quit");
+	return (void *)NULL;
+}
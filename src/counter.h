@@ -0,0 +1,132 @@
+#ifndef SSDB_COUNTER_H_
+#define SSDB_COUNTER_H_
+
+#include "include.h"
+#include <string>
+#include <map>
+#include <pthread.h>
+#include "ssdb.h"
+#include "util/thread.h"
+
+/**
+ * Merges incr, hincr and zincr in memory, hot counters are written to db
+ * once per @interval ms instead of once per request.
+ *
+ * A counter is read from db on its first increment, then only changed in
+ * memory. A flush writes the absolute values with set/setx, hset and zset,
+ * so binlogs and slaves see ordinary KSET/HSET/ZSET records.
+ *
+ * Reads of single items(get, exists, hget, zget...) see the merged
+ * values, other reads of kv, hash or zset data flush the counters they
+ * touch first. Any other write command flushes all counters before it
+ * runs(see Server::ProcWorker::proc), so writes to the same keys are
+ * applied in order. Counters not yet flushed are lost if the server
+ * crashes, "flush counters" makes them durable.
+ *
+ * Deletes which are not client commands(ttl expiration, slave replay) do
+ * not flush, they hold the lock of the buffer(see CounterLocking) while
+ * they delete keys and drop the counters of them, so a deleted key is
+ * never written back by a flush. Locks are taken in this order: counters,
+ * the container lock of ExpirationHandler, Transaction.
+ */
+class CounterBuffer{
+	private:
+		// counters taken out of the buffer and written by a flush at a
+		// time, a flush waits at most one slice of another flush
+		static const int FLUSH_SLICE = 1000;
+		// flush early when there are too many counters
+		static const int MAX_KEYS = 100000;
+
+		struct Counter{
+			char type; // DataType::KV, HASH or ZSET
+			std::string name;
+			std::string key;
+			int64_t val;
+			int64_t expire; // inline ttl of a kv counter
+		};
+
+		SSDB *ssdb;
+		int interval;
+		// encoded db key => counter
+		std::map<std::string, Counter> counters;
+		// the slice being written, a counter leaves it after it is in db,
+		// so readers find it either here or in db
+		std::map<std::string, Counter> flushing;
+		// guards the maps, it is not held while counters are written
+		Mutex mutex;
+		// one flush at a time keeps the writes of a key in order, a flush
+		// may clear an expired container. Both are recursive, a deleter
+		// holding the lock(CounterLocking) may delete more containers.
+		Mutex flush_mutex;
+
+		uint64_t incrs;
+		uint64_t writes;
+		uint64_t flushes;
+
+		volatile bool thread_quit;
+		pthread_t tid;
+		static void* thread_func(void *arg);
+
+		int merge(char type, const Bytes &name, const Bytes &key, int64_t by, std::string *new_val);
+		int find(const std::string &dbkey, std::string *val);
+		int write(const Counter &c);
+		int flush_prefix(const std::string &prefix);
+	public:
+		// interval: in ms
+		CounterBuffer(SSDB *ssdb, int interval);
+		// flushes all counters
+		~CounterBuffer();
+
+		// same as SSDB::incr, hincr and zincr
+		int incr(const Bytes &key, int64_t by, std::string *new_val);
+		int hincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val);
+		int zincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val);
+
+		// @return 1: buffered, 0: not buffered(read db instead)
+		int get(const Bytes &key, std::string *val);
+		int hget(const Bytes &name, const Bytes &key, std::string *val);
+		int zget(const Bytes &name, const Bytes &key, std::string *score);
+
+		int size();
+		// write all counters to db
+		// @return number of counters written, -1: error
+		int flush();
+		// write the counters a read of db would miss, before sizes, ranges
+		// and scans. type: DataType::HSIZE or ZSIZE, those of all hashes or
+		// zsets if name is empty, or DataType::KV for all kv counters
+		int flush(char type, const Bytes &name);
+
+		std::string stats();
+
+		// waits for a running flush, then blocks merges and flushes
+		void lock();
+		void unlock();
+		// caller holds the lock, dbkey: the encoded kv, hash or zset key
+		void drop(const Bytes &dbkey);
+		// caller holds the lock, drops all counters of a hash or zset
+		// type: DataType::HSIZE or ZSIZE
+		void drop_container(char type, const Bytes &name);
+};
+
+// locks a CounterBuffer, if there is one
+class CounterLocking{
+	private:
+		CounterBuffer *buffer;
+		// No copying allowed
+		CounterLocking(const CounterLocking&);
+		void operator=(const CounterLocking&);
+	public:
+		CounterLocking(CounterBuffer *buffer){
+			this->buffer = buffer;
+			if(buffer){
+				buffer->lock();
+			}
+		}
+		~CounterLocking(){
+			if(buffer){
+				buffer->unlock();
+			}
+		}
+};
+
+#endif
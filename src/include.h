@@ -49,9 +49,17 @@ public:
 	static const char KV		= 'k';
 	static const char HASH		= 'h'; // hashmap(sorted by key)
 	static const char HSIZE		= 'H';
+	static const char HPACK		= 'p'; // fields of a small hash in one value
+	static const char BITMAP	= 'm'; // chunks of a bitmap
+	static const char HLL		= 'l'; // hyperloglog
+	static const char XGROUP	= 'o'; // offset of a stream consumer group
+	static const char XPEND		= 'r'; // item delivered to a group, not yet acked
 	static const char ZSET		= 's'; // key => score
 	static const char ZSCORE	= 'z'; // key|score => ""
 	static const char ZSIZE		= 'Z';
+	static const char DZSET		= 'j'; // key => double score, see t_dzset.h
+	static const char DZSCORE	= 'y'; // key|double score => ""
+	static const char DZSIZE	= 'J';
 	static const char QUEUE		= 'q';
 	static const char QSIZE		= 'Q';
 	static const char MIN_PREFIX = HASH;
@@ -80,6 +88,22 @@ public:
 	static const char QPUSH_FRONT	= 11;
 	static const char QPOP_BACK		= 12;
 	static const char QPOP_FRONT	= 13;
+
+	// key is an encoded bitmap chunk key
+	static const char BSET			= 14;
+	static const char BDEL			= 15;
+	// key is an encoded hyperloglog key
+	static const char PFSET			= 16;
+	static const char PFDEL			= 17;
+	// key is an encoded qtrim log(see t_queue.h), items removed in bulk
+	static const char QTRIM_FRONT	= 18;
+	static const char QTRIM_BACK	= 19;
+	// key is an encoded stream group offset or pending entry key
+	static const char XSET			= 20;
+	static const char XDEL			= 21;
+	// key is an encoded dzset key
+	static const char DZSET			= 22;
+	static const char DZDEL			= 23;
 	
 	static const char BEGIN  = 7;
 	static const char END    = 8;
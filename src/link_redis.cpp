@@ -22,6 +22,10 @@ enum STRATEGY{
 	STRATEGY_ZREVRANGE,
 	STRATEGY_ZRANGEBYSCORE,
 	STRATEGY_ZREVRANGEBYSCORE,
+	// score bounds are passed as they are, dzscan parses "(" and "inf"
+	STRATEGY_DZRANGEBYSCORE,
+	STRATEGY_DZREVRANGEBYSCORE,
+	STRATEGY_ZRANGEBYLEX,
 	STRATEGY_ZADD,
 	STRATEGY_ZINCRBY,
 	STRATEGY_REMRANGEBYRANK,
@@ -29,6 +33,8 @@ enum STRATEGY{
 	STRATEGY_NULL
 };
 
+bool RedisLink::double_zset = false;
+
 static bool inited = false;
 static std::map<std::string, RedisRequestDesc> cmd_table;
 
@@ -72,8 +78,12 @@ static RedisCommand_raw cmds_raw[] = {
 	{STRATEGY_AUTO, "zrank",	"zrank",		REPLY_INT},
 	{STRATEGY_AUTO, "zrevrank",	"zrrank",		REPLY_INT},
 	{STRATEGY_AUTO, "zcount",	"zcount",		REPLY_INT},
+	{STRATEGY_AUTO, "zlexcount",	"zlexcount",	REPLY_INT},
 	{STRATEGY_REMRANGEBYRANK, "zremrangebyrank",	"zremrangebyrank",		REPLY_INT},
 	{STRATEGY_REMRANGEBYSCORE, "zremrangebyscore",	"zremrangebyscore",		REPLY_INT},
+	{STRATEGY_AUTO, "zunionstore",	"zunionstore",	REPLY_INT},
+	{STRATEGY_AUTO, "zinterstore",	"zinterstore",	REPLY_INT},
+	{STRATEGY_AUTO, "zdiffstore",	"zdiffstore",	REPLY_INT},
 	
 	/////////////////////////////////////
 	{STRATEGY_MGET, "mget",		"multi_get",	REPLY_MULTI_BULK},
@@ -89,9 +99,10 @@ static RedisCommand_raw cmds_raw[] = {
 	{STRATEGY_ZINCRBY,	"zincrby",		"zincr", 		REPLY_BULK},
 	{STRATEGY_ZRANGEBYSCORE,	"zrangebyscore",	"zscan",	REPLY_MULTI_BULK},
 	{STRATEGY_ZREVRANGEBYSCORE,	"zrevrangebyscore",	"zrscan",	REPLY_MULTI_BULK},
+	{STRATEGY_ZRANGEBYLEX,	"zrangebylex",	"zrangebylex",	REPLY_MULTI_BULK},
 
-	{STRATEGY_AUTO,		"lpush",		"qpush_front", 		REPLY_STATUS},
-	{STRATEGY_AUTO,		"rpush",		"qpush_back", 		REPLY_STATUS},
+	{STRATEGY_AUTO,		"lpush",		"qpush_front", 		REPLY_INT},
+	{STRATEGY_AUTO,		"rpush",		"qpush_back", 		REPLY_INT},
 	{STRATEGY_AUTO,		"lpop",			"qpop_front", 		REPLY_BULK},
 	{STRATEGY_AUTO,		"rpop",			"qpop_back", 		REPLY_BULK},
 	{STRATEGY_AUTO, 	"llen",			"qsize",			REPLY_INT},
@@ -99,6 +110,35 @@ static RedisCommand_raw cmds_raw[] = {
 	{STRATEGY_AUTO,		"lindex",		"qget", 			REPLY_BULK},
 	{STRATEGY_AUTO,		"lrange",		"qslice",			REPLY_MULTI_BULK},
 
+	{STRATEGY_AUTO,		"setbit",		"setbit",			REPLY_INT},
+	{STRATEGY_AUTO,		"getbit",		"getbit",			REPLY_INT},
+	{STRATEGY_AUTO,		"bitcount",		"bitcount",			REPLY_INT},
+	{STRATEGY_AUTO,		"bitop",		"bitop",			REPLY_INT},
+
+	{STRATEGY_AUTO,		"pfadd",		"pfadd",			REPLY_INT},
+	{STRATEGY_AUTO,		"pfcount",		"pfcount",			REPLY_INT},
+	{STRATEGY_AUTO,		"pfmerge",		"pfmerge",			REPLY_STATUS},
+
+	{STRATEGY_AUTO, 	NULL,			NULL,			0}
+};
+
+// replace the zset commands in cmds_raw if RedisLink::double_zset
+static RedisCommand_raw dz_cmds_raw[] = {
+	{STRATEGY_AUTO, "zcard",	"dzsize",		REPLY_INT},
+	{STRATEGY_AUTO, "zscore",	"dzget",		REPLY_BULK},
+	{STRATEGY_AUTO, "zrem",		"multi_dzdel",	REPLY_INT},
+	{STRATEGY_AUTO, "zrank",	"dzrank",		REPLY_INT},
+	{STRATEGY_AUTO, "zrevrank",	"dzrrank",		REPLY_INT},
+	{STRATEGY_AUTO, "zcount",	"dzcount",		REPLY_INT},
+	{STRATEGY_ZRANGE,	"zrange",		"dzrange",		REPLY_MULTI_BULK},
+	{STRATEGY_ZREVRANGE,"zrevrange",	"dzrrange",		REPLY_MULTI_BULK},
+	{STRATEGY_ZADD,		"zadd",			"multi_dzset", 	REPLY_INT},
+	{STRATEGY_ZINCRBY,	"zincrby",		"dzincr", 		REPLY_BULK},
+	{STRATEGY_DZRANGEBYSCORE,	"zrangebyscore",	"dzscan",	REPLY_MULTI_BULK},
+	{STRATEGY_DZREVRANGEBYSCORE,	"zrevrangebyscore",	"dzrscan",	REPLY_MULTI_BULK},
+	{STRATEGY_AUTO, "zlexcount",	"dzlexcount",	REPLY_INT},
+	{STRATEGY_ZRANGEBYLEX,	"zrangebylex",	"dzrangebylex",	REPLY_MULTI_BULK},
+
 	{STRATEGY_AUTO, 	NULL,			NULL,			0}
 };
 
@@ -106,15 +146,21 @@ int RedisLink::convert_req(){
 	if(!inited){
 		inited = true;
 		
-		RedisCommand_raw *def = &cmds_raw[0];
-		while(def->redis_cmd != NULL){
-			RedisRequestDesc desc;
-			desc.strategy = def->strategy;
-			desc.redis_cmd = def->redis_cmd;
-			desc.ssdb_cmd = def->ssdb_cmd;
-			desc.reply_type = def->reply_type;
-			cmd_table[desc.redis_cmd] = desc;
-			def += 1;
+		RedisCommand_raw *tables[2] = {&cmds_raw[0], NULL};
+		if(double_zset){
+			tables[1] = &dz_cmds_raw[0];
+		}
+		for(int i=0; i<2 && tables[i]; i++){
+			RedisCommand_raw *def = tables[i];
+			while(def->redis_cmd != NULL){
+				RedisRequestDesc desc;
+				desc.strategy = def->strategy;
+				desc.redis_cmd = def->redis_cmd;
+				desc.ssdb_cmd = def->ssdb_cmd;
+				desc.reply_type = def->reply_type;
+				cmd_table[desc.redis_cmd] = desc;
+				def += 1;
+			}
 		}
 	}
 	
@@ -202,6 +248,62 @@ int RedisLink::convert_req(){
 		}
 		return 0;
 	}
+	if(this->req_desc->strategy == STRATEGY_ZRANGEBYLEX){
+		recv_string.push_back(req_desc->ssdb_cmd);
+		if(recv_bytes.size() < 4){
+			return 0;
+		}
+		std::string offset = "0";
+		std::string count = "999999999999";
+		if(recv_bytes.size() >= 7){
+			std::string s = recv_bytes[4].String();
+			strtolower(&s);
+			if(s == "limit"){
+				offset = recv_bytes[5].String();
+				// a negative count returns all, a negative offset nothing
+				if(recv_bytes[5].Int64() < 0){
+					offset = "0";
+					count = "0";
+				}else if(recv_bytes[6].Int64() >= 0){
+					count = recv_bytes[6].String();
+				}
+			}
+		}
+		recv_string.push_back(recv_bytes[1].String());
+		recv_string.push_back(recv_bytes[2].String());
+		recv_string.push_back(recv_bytes[3].String());
+		recv_string.push_back(offset);
+		recv_string.push_back(count);
+		return 0;
+	}
+	if(this->req_desc->strategy == STRATEGY_DZRANGEBYSCORE || this->req_desc->strategy == STRATEGY_DZREVRANGEBYSCORE){
+		recv_string.push_back(req_desc->ssdb_cmd);
+		if(recv_bytes.size() < 4){
+			return 0;
+		}
+		std::string offset, count, withscores;
+		for(int i=4; i<recv_bytes.size(); i++){
+			std::string s = recv_bytes[i].String();
+			strtolower(&s);
+			if(s == "withscores"){
+				withscores = s;
+			}else if(s == "limit" && i + 2 < recv_bytes.size()){
+				offset = recv_bytes[i + 1].String();
+				count = recv_bytes[i + 2].String();
+				i += 2;
+			}
+		}
+		recv_string.push_back(recv_bytes[1].String());
+		recv_string.push_back("");
+		recv_string.push_back(recv_bytes[2].String());
+		recv_string.push_back(recv_bytes[3].String());
+		// zscan takes "limit" as the offset when "count" follows, which
+		// "withscores" always does
+		recv_string.push_back(offset.empty()? "0" : offset);
+		recv_string.push_back(count.empty()? "999999999999" : count);
+		recv_string.push_back(withscores);
+		return 0;
+	}
 	if(this->req_desc->strategy == STRATEGY_ZRANGEBYSCORE || this->req_desc->strategy == STRATEGY_ZREVRANGEBYSCORE){
 		recv_string.push_back(req_desc->ssdb_cmd);
 		std::string name, smin, smax, withscores, offset, count;
@@ -266,9 +368,9 @@ int RedisLink::convert_req(){
 			}
 			recv_string.push_back(smax);
 		}
-		if(!offset.empty()){
-			recv_string.push_back(offset);
-		}
+		// zscan takes "limit" as the offset when "count" follows, which
+		// "withscores" always does
+		recv_string.push_back(offset.empty()? "0" : offset);
 		if(count.empty()){
 			recv_string.push_back("999999999999");
 		}else{
@@ -438,7 +540,9 @@ int RedisLink::send_resp(Buffer *output, const std::vector<std::string> &resp){
 				withscores = false;
 			}
 		}
-		if(req_desc->strategy == STRATEGY_ZRANGEBYSCORE || req_desc->strategy == STRATEGY_ZREVRANGEBYSCORE){
+		if(req_desc->strategy == STRATEGY_ZRANGEBYSCORE || req_desc->strategy == STRATEGY_ZREVRANGEBYSCORE
+			|| req_desc->strategy == STRATEGY_DZRANGEBYSCORE || req_desc->strategy == STRATEGY_DZREVRANGEBYSCORE)
+		{
 			if(recv_string[recv_string.size() - 1] != "withscores"){
 				withscores = false;
 			}
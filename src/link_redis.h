@@ -25,6 +25,10 @@ private:
 	int convert_req();
 	
 public:
+	// server.redis_zset: double, the redis zset commands are served by
+	// the dzset commands, scores are doubles
+	static bool double_zset;
+
 	RedisLink(){
 		req_desc = NULL;
 	}
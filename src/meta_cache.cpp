@@ -0,0 +1,74 @@
+#include "meta_cache.h"
+
+MetaCache::MetaCache(int capacity){
+	this->capacity = capacity;
+	this->hits = 0;
+	this->misses = 0;
+}
+
+MetaCache::~MetaCache(){
+}
+
+int MetaCache::get(const std::string &key, int64_t *val){
+	Locking l(&mutex);
+	map_t::iterator it = items.find(key);
+	if(it == items.end()){
+		misses ++;
+		return 0;
+	}
+	hits ++;
+	// move to front
+	lru.splice(lru.begin(), lru, it->second);
+	*val = it->second->val;
+	return 1;
+}
+
+void MetaCache::set(const std::string &key, int64_t val){
+	Item item;
+	item.key = key;
+	item.val = val;
+	pending.push_back(item);
+}
+
+void MetaCache::commit(){
+	if(pending.empty()){
+		return;
+	}
+	Locking l(&mutex);
+	for(std::vector<Item>::iterator it=pending.begin(); it!=pending.end(); it++){
+		this->_set(it->key, it->val);
+	}
+	pending.clear();
+}
+
+void MetaCache::rollback(){
+	pending.clear();
+}
+
+void MetaCache::_set(const std::string &key, int64_t val){
+	map_t::iterator it = items.find(key);
+	if(it != items.end()){
+		it->second->val = val;
+		lru.splice(lru.begin(), lru, it->second);
+		return;
+	}
+	Item item;
+	item.key = key;
+	item.val = val;
+	lru.push_front(item);
+	items[key] = lru.begin();
+
+	while((int)items.size() > capacity){
+		Item &last = lru.back();
+		items.erase(last.key);
+		lru.pop_back();
+	}
+}
+
+std::string MetaCache::stats(){
+	Locking l(&mutex);
+	char buf[128];
+	snprintf(buf, sizeof(buf), "items: %d, capacity: %d, hits: %" PRIu64 ", misses: %" PRIu64 "",
+		(int)items.size(), capacity, hits, misses);
+	return std::string(buf);
+}
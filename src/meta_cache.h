@@ -0,0 +1,54 @@
+#ifndef SSDB_META_CACHE_H_
+#define SSDB_META_CACHE_H_
+
+#include "include.h"
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include "util/thread.h"
+
+/**
+ * Write-through cache of container meta keys(HSIZE, ZSIZE, QSIZE and
+ * queue's QFRONT_SEQ/QBACK_SEQ), keyed by the encoded leveldb key.
+ *
+ * Values are only filled by the writer(while holding binlogs->mutex),
+ * and become visible after BinlogQueue::commit() succeeds, so readers
+ * never see a value which is not in the db. A value of 0 means the key
+ * does not exist in db(a size key is deleted when it drops to 0, and a
+ * queue seq is never 0).
+ */
+class MetaCache{
+	private:
+		struct Item{
+			std::string key;
+			int64_t val;
+		};
+		typedef std::list<Item> lru_list_t;
+		typedef std::map<std::string, lru_list_t::iterator> map_t;
+
+		int capacity;
+		lru_list_t lru;
+		map_t items;
+		std::vector<Item> pending;
+		Mutex mutex;
+
+		uint64_t hits;
+		uint64_t misses;
+
+		void _set(const std::string &key, int64_t val);
+	public:
+		MetaCache(int capacity);
+		~MetaCache();
+
+		// @return 1: cached, 0: not cached
+		int get(const std::string &key, int64_t *val);
+		// takes effect after commit()
+		void set(const std::string &key, int64_t val);
+		void commit();
+		void rollback();
+
+		std::string stats();
+};
+
+#endif
@@ -0,0 +1,94 @@
+/* bitmap */
+
+static int proc_setbit(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4 || (req[3] != "0" && req[3] != "1")){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->setbit(req[1], req[2].Int64(), req[3] == "1");
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			resp->push_back(ret? "1" : "0");
+		}
+	}
+	return 0;
+}
+
+static int proc_getbit(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->getbit(req[1], req[2].Int64());
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			resp->push_back(ret? "1" : "0");
+		}
+	}
+	return 0;
+}
+
+// bitcount name [start end], start and end are in bytes
+static int proc_bitcount(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2 || req.size() == 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t start = 0;
+	int64_t end = -1;
+	if(req.size() > 3){
+		start = req[2].Int64();
+		end = req[3].Int64();
+	}
+	int64_t ret = serv->ssdb->bitcount(req[1], start, end);
+	if(ret == -1){
+		resp->push_back("error");
+	}else{
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+// bitop and|or|xor|not dest name1 [name2 ...]
+static int proc_bitop(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+		return 0;
+	}
+	std::string op = req[1].String();
+	strtolower(&op);
+	int64_t ret = serv->ssdb->bitop(op, req[2], req, 3);
+	if(ret == -2){
+		resp->push_back("client_error");
+	}else if(ret == -1){
+		resp->push_back("error");
+	}else{
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_bclear(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->bclear(req[1]);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+			resp->push_back("ok");
+			resp->push_back(buf);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,379 @@
+/* dzset */
+
+static int proc_dzset(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double score;
+	if(str_to_dzscore(req[3], &score) == -1){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int ret = serv->ssdb->dzset(req[1], req[2], score);
+	if(ret == -1){
+		resp->push_back("error");
+	}else{
+		resp->push_back("ok");
+		char buf[20];
+		sprintf(buf, "%d", ret);
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_multi_dzset(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4 || req.size() % 2 != 0){
+		resp->push_back("client_error");
+		return 0;
+	}
+	// nothing is written if any score is not a number
+	std::vector<double> scores;
+	for(int i=3; i<(int)req.size(); i+=2){
+		double score;
+		if(str_to_dzscore(req[i], &score) == -1){
+			resp->push_back("client_error");
+			return 0;
+		}
+		scores.push_back(score);
+	}
+	int num = 0;
+	const Bytes &name = req[1];
+	for(int i=0; i<(int)scores.size(); i++){
+		int ret = serv->ssdb->dzset(name, req[2 + i * 2], scores[i]);
+		if(ret == -1){
+			resp->push_back("error");
+			return 0;
+		}
+		num += ret;
+	}
+	resp->push_back("ok");
+	char buf[20];
+	sprintf(buf, "%d", num);
+	resp->push_back(buf);
+	return 0;
+}
+
+static int proc_dzget(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double score;
+	int ret = serv->ssdb->dzget(req[1], req[2], &score);
+	if(ret == 1){
+		resp->push_back("ok");
+		resp->push_back(dzscore_to_str(score));
+	}else if(ret == 0){
+		resp->push_back("not_found");
+	}else{
+		resp->push_back("error");
+	}
+	return 0;
+}
+
+static int proc_dzdel(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->dzdel(req[1], req[2]);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			if(ret == 0){
+				resp->push_back("0");
+			}else{
+				resp->push_back("1");
+			}
+		}
+	}
+	return 0;
+}
+
+static int proc_multi_dzdel(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		int num = 0;
+		const Bytes &name = req[1];
+		std::vector<Bytes>::const_iterator it = req.begin() + 2;
+		for(; it != req.end(); it += 1){
+			const Bytes &key = *it;
+			int ret = serv->ssdb->dzdel(name, key);
+			if(ret == -1){
+				resp->push_back("error");
+				return 0;
+			}else{
+				num += ret;
+			}
+		}
+		resp->push_back("ok");
+		char buf[20];
+		sprintf(buf, "%d", num);
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_dzincr(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double by = 1;
+	if(req.size() > 3 && str_to_dzscore(req[3], &by) == -1){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double new_val;
+	int ret = serv->ssdb->dzincr(req[1], req[2], by, &new_val);
+	if(ret == -2){
+		resp->push_back("client_error");
+	}else if(ret == -1){
+		resp->push_back("error");
+	}else{
+		resp->push_back("ok");
+		resp->push_back(dzscore_to_str(new_val));
+	}
+	return 0;
+}
+
+static int proc_dzsize(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->dzsize(req[1]);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			char buf[20];
+			sprintf(buf, "%" PRId64 "", ret);
+			resp->push_back("ok");
+			resp->push_back(buf);
+		}
+	}
+	return 0;
+}
+
+static int proc_dzclear(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t total = serv->ssdb->dzclear(req[1]);
+	if(total == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%" PRId64 "", total);
+	resp->push_back("ok");
+	resp->push_back(buf);
+	return 0;
+}
+
+static int proc_dzrank(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() != 3){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->dzrank(req[1], req[2]);
+		char buf[20];
+		sprintf(buf, "%" PRId64 "", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_dzrrank(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() != 3){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->dzrrank(req[1], req[2]);
+		char buf[20];
+		sprintf(buf, "%" PRId64 "", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static void dziterator_resp(DZIterator *it, Response *resp){
+	while(it->next()){
+		resp->push_back(it->key.String());
+		resp->push_back(dzscore_to_str(it->score));
+	}
+	delete it;
+}
+
+static int proc_dzrange(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		resp->push_back("ok");
+		dziterator_resp(serv->ssdb->dzrange(req[1], req[2].Uint64(), req[3].Uint64()), resp);
+	}
+	return 0;
+}
+
+static int proc_dzrrange(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		resp->push_back("ok");
+		dziterator_resp(serv->ssdb->dzrrange(req[1], req[2].Uint64(), req[3].Uint64()), resp);
+	}
+	return 0;
+}
+
+/**
+ * req[2...]: key_start score_start score_end, an empty score is the end of
+ * the zset in the direction of the scan, "(" makes a score exclusive. If
+ * only key_start is given, the scan starts after it, at its score.
+ * @return -1: bad scores, 0: the scan is empty, 1: ok
+ */
+static int parse_dzscan(Server *serv, const Request &req, bool reverse,
+		double *start, bool *start_open, double *end, bool *end_open)
+{
+	double lo = -INFINITY;
+	double hi = INFINITY;
+	if(str_to_dzbound(req[3], reverse? hi : lo, start, start_open) == -1){
+		return -1;
+	}
+	if(str_to_dzbound(req[4], reverse? lo : hi, end, end_open) == -1){
+		return -1;
+	}
+	if(!req[2].empty() && req[3].empty()){
+		int ret = serv->ssdb->dzget(req[1], req[2], start);
+		if(ret != 1){
+			return ret == -1? -1 : 0;
+		}
+	}
+	return 1;
+}
+
+static int _dzscan(Server *serv, const Request &req, Response *resp, bool reverse){
+	if(req.size() < 6){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double start, end;
+	bool start_open, end_open;
+	int ret = parse_dzscan(serv, req, reverse, &start, &start_open, &end, &end_open);
+	if(ret == -1){
+		resp->push_back("client_error");
+		return 0;
+	}
+	resp->push_back("ok");
+	if(ret == 0){
+		return 0;
+	}
+	uint64_t limit = req[5].Uint64();
+	uint64_t offset = 0;
+	if(req.size() > 6){
+		offset = limit;
+		limit = offset + req[6].Uint64();
+	}
+	DZIterator *it;
+	if(reverse){
+		it = serv->ssdb->dzrscan(req[1], req[2], start, start_open, end, end_open, limit);
+	}else{
+		it = serv->ssdb->dzscan(req[1], req[2], start, start_open, end, end_open, limit);
+	}
+	if(offset > 0){
+		it->skip(offset);
+	}
+	dziterator_resp(it, resp);
+	return 0;
+}
+
+static int proc_dzscan(Server *serv, Link *link, const Request &req, Response *resp){
+	return _dzscan(serv, req, resp, false);
+}
+
+static int proc_dzrscan(Server *serv, Link *link, const Request &req, Response *resp){
+	return _dzscan(serv, req, resp, true);
+}
+
+static int proc_dzcount(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double start, end;
+	bool start_open, end_open;
+	if(str_to_dzbound(req[2], -INFINITY, &start, &start_open) == -1
+		|| str_to_dzbound(req[3], INFINITY, &end, &end_open) == -1)
+	{
+		resp->push_back("client_error");
+		return 0;
+	}
+	uint64_t count = 0;
+	DZIterator *it = serv->ssdb->dzscan(req[1], "", start, start_open, end, end_open, -1);
+	while(it->next()){
+		count ++;
+	}
+	delete it;
+
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%" PRIu64 "", count);
+	resp->push_back("ok");
+	resp->push_back(buf);
+	return 0;
+}
+
+// dzrangebylex name min max offset limit [score]
+static int proc_dzrangebylex(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 6){
+		resp->push_back("client_error");
+		return 0;
+	}
+	Bytes score = req.size() > 6? req[6] : Bytes("");
+	resp->push_back("ok");
+	int64_t ret = serv->ssdb->dzrangebylex(req[1], req[2], req[3], score,
+		req[4].Uint64(), req[5].Uint64(), resp);
+	if(ret == -2){
+		resp->clear();
+		resp->push_back("client_error");
+	}
+	return 0;
+}
+
+// dzlexcount name min max [score]
+static int proc_dzlexcount(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+		return 0;
+	}
+	Bytes score = req.size() > 4? req[4] : Bytes("");
+	int64_t ret = serv->ssdb->dzrangebylex(req[1], req[2], req[3], score, 0, UINT64_MAX, NULL);
+	if(ret == -2){
+		resp->push_back("client_error");
+		return 0;
+	}
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+	resp->push_back("ok");
+	resp->push_back(buf);
+	return 0;
+}
+
+static int proc_dzlist(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		uint64_t limit = req[3].Uint64();
+		std::vector<std::string> list;
+		int ret = serv->ssdb->dzlist(req[1], req[2], limit, &list);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			for(int i=0; i<list.size(); i++){
+				resp->push_back(list[i]);
+			}
+		}
+	}
+	return 0;
+}
@@ -1,4 +1,13 @@
 /* hash */
+
+// a buffered counter first
+static int hash_get(Server *serv, const Bytes &name, const Bytes &key, std::string *val){
+	if(serv->counters && serv->counters->hget(name, key, val) == 1){
+		return 1;
+	}
+	return serv->ssdb->hget(name, key, val);
+}
+
 static int proc_hexists(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 3){
 		resp->push_back("client_error");
@@ -6,7 +15,7 @@ static int proc_hexists(Server *serv, Link *link, const Request &req, Response *
 		const Bytes &name = req[1];
 		const Bytes &key = req[2];
 		std::string val;
-		int ret = serv->ssdb->hget(name, key, &val);
+		int ret = hash_get(serv, name, key, &val);
 		if(ret == -1){
 			resp->push_back("error");
 			resp->push_back("0");
@@ -30,7 +39,7 @@ static int proc_multi_hexists(Server *serv, Link *link, const Request &req, Resp
 		std::string val;
 		for(Request::const_iterator it=req.begin()+2; it!=req.end(); it++){
 			const Bytes &key = *it;
-			int64_t ret = serv->ssdb->hget(name, key, &val);
+			int64_t ret = hash_get(serv, name, key, &val);
 			resp->push_back(key.String());
 			if(ret > 0){
 				resp->push_back("1");
@@ -49,7 +58,10 @@ static int proc_multi_hsize(Server *serv, Link *link, const Request &req, Respon
 		resp->push_back("ok");
 		for(Request::const_iterator it=req.begin()+1; it!=req.end(); it++){
 			const Bytes &key = *it;
-			int64_t ret = serv->ssdb->hsize(key);
+			int64_t ret = -1;
+			if(flush_counters(serv, DataType::HSIZE, key) != -1){
+				ret = serv->ssdb->hsize(key);
+			}
 			resp->push_back(key.String());
 			if(ret == -1){
 				resp->push_back("-1");
@@ -119,21 +131,23 @@ static int proc_multi_hget(Server *serv, Link *link, const Request &req, Respons
 		resp->push_back("client_error");
 	}else{
 		resp->push_back("ok");
-		Request::const_iterator it=req.begin() + 1;
-		const Bytes name = *it;
-		it ++;
-		for(; it!=req.end(); it+=1){
-			const Bytes &key = *it;
-			std::string val;
-			int ret = serv->ssdb->hget(name, key, &val);
-			if(ret == 1){
-				resp->push_back(key.String());
-				resp->push_back(val);
-			}else if(ret == 0){
-				//
-			}else{
-				resp->push_back("0");
+		if(serv->counters){
+			for(Request::const_iterator it=req.begin()+2; it!=req.end(); it++){
+				std::string val;
+				int ret = hash_get(serv, req[1], *it, &val);
+				if(ret == -1){
+					resp->clear();
+					resp->push_back("error");
+					return 0;
+				}
+				if(ret == 1){
+					resp->push_back(it->String());
+					resp->push_back(val);
+				}
 			}
+		}else if(serv->ssdb->multi_hget(req[1], req, 2, resp) == -1){
+			resp->clear();
+			resp->push_back("error");
 		}
 	}
 	return 0;
@@ -142,6 +156,8 @@ static int proc_multi_hget(Server *serv, Link *link, const Request &req, Respons
 static int proc_hsize(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 2){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		int64_t ret = serv->ssdb->hsize(req[1]);
 		if(ret == -1){
@@ -180,7 +196,7 @@ static int proc_hget(Server *serv, Link *link, const Request &req, Response *res
 		resp->push_back("client_error");
 	}else{
 		std::string val;
-		int ret = serv->ssdb->hget(req[1], req[2], &val);
+		int ret = hash_get(serv, req[1], req[2], &val);
 		if(ret == 1){
 			resp->push_back("ok");
 			resp->push_back(val);
@@ -218,38 +234,32 @@ static int proc_hclear(Server *serv, Link *link, const Request &req, Response *r
 		return 0;
 	}
 	
-	const Bytes &name = req[1];
-	uint64_t total = 0;
-	while(1){
-		HIterator *it = serv->ssdb->hscan(name, "", "", 1000);
-		int num = 0;
-		while(it->next()){
-			int ret = serv->ssdb->hdel(name, it->key);
-			if(ret == -1){
-				resp->push_back("error");
-				delete it;
-				return 0;
-			}
-			num ++;
-		};
-		delete it;
-
-		if(num == 0){
-			break;
-		}
-		total += num;
+	int64_t total = serv->ssdb->hclear(req[1]);
+	if(total == -1 || serv->expiration->set_container_ttl(DataType::HSIZE, req[1], 0) == -1){
+		resp->push_back("error");
+		return 0;
 	}
 	char buf[20];
-	snprintf(buf, sizeof(buf), "%" PRIu64 "", total);
+	snprintf(buf, sizeof(buf), "%" PRId64 "", total);
 	resp->push_back("ok");
 	resp->push_back(buf);
 
 	return 0;
 }
 
+static int proc_hexpire(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_expire(serv, DataType::HSIZE, req, resp);
+}
+
+static int proc_httl(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_ttl(serv, DataType::HSIZE, req, resp);
+}
+
 static int proc_hscan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 5){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[4].Uint64();
 		HIterator *it = serv->ssdb->hscan(req[1], req[2], req[3], limit);
@@ -266,6 +276,8 @@ static int proc_hscan(Server *serv, Link *link, const Request &req, Response *re
 static int proc_hrscan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 5){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[4].Uint64();
 		HIterator *it = serv->ssdb->hrscan(req[1], req[2], req[3], limit);
@@ -282,6 +294,8 @@ static int proc_hrscan(Server *serv, Link *link, const Request &req, Response *r
 static int proc_hkeys(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 5){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[4].Uint64();
 		HIterator *it = serv->ssdb->hscan(req[1], req[2], req[3], limit);
@@ -299,6 +313,8 @@ static int proc_hkeys(Server *serv, Link *link, const Request &req, Response *re
 static int proc_hvals(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 5){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[4].Uint64();
 		HIterator *it = serv->ssdb->hscan(req[1], req[2], req[3], limit);
@@ -315,6 +331,8 @@ static int proc_hvals(Server *serv, Link *link, const Request &req, Response *re
 static int proc_hlist(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::HSIZE, "") == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[3].Uint64();
 		std::vector<std::string> list;
@@ -332,7 +350,7 @@ static int proc_hlist(Server *serv, Link *link, const Request &req, Response *re
 }
 
 // dir := +1|-1
-static int _hincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
+static int _hincr(Server *serv, const Request &req, Response *resp, int dir){
 	if(req.size() < 3){
 		resp->push_back("client_error");
 	}else{
@@ -341,7 +359,12 @@ static int _hincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 		if(req.size() > 3){
 			val = req[3].Int64();
 		}
-		int ret = ssdb->hincr(req[1], req[2], dir * val, &new_val);
+		int ret;
+		if(serv->counters){
+			ret = serv->counters->hincr(req[1], req[2], dir * val, &new_val);
+		}else{
+			ret = serv->ssdb->hincr(req[1], req[2], dir * val, &new_val);
+		}
 		if(ret == -1){
 			resp->push_back("error");
 		}else{
@@ -353,11 +376,11 @@ static int _hincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 }
 
 static int proc_hincr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _hincr(serv->ssdb, req, resp, 1);
+	return _hincr(serv, req, resp, 1);
 }
 
 static int proc_hdecr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _hincr(serv->ssdb, req, resp, -1);
+	return _hincr(serv, req, resp, -1);
 }
 
 
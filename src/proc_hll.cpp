@@ -0,0 +1,65 @@
+/* hyperloglog */
+
+// pfadd name [item ...]
+static int proc_pfadd(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->pfadd(req[1], req, 2);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			resp->push_back(ret? "1" : "0");
+		}
+	}
+	return 0;
+}
+
+// pfcount name [name ...]
+static int proc_pfcount(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->pfcount(req, 1);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+			resp->push_back("ok");
+			resp->push_back(buf);
+		}
+	}
+	return 0;
+}
+
+// pfmerge dest name [name ...]
+static int proc_pfmerge(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->pfmerge(req[1], req, 2);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+		}
+	}
+	return 0;
+}
+
+static int proc_pfclear(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->pfclear(req[1]);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			resp->push_back("1");
+		}
+	}
+	return 0;
+}
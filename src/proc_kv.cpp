@@ -1,11 +1,19 @@
 /* kv */
 
+// a buffered counter first
+static int kv_get(Server *serv, const Bytes &key, std::string *val){
+	if(serv->counters && serv->counters->get(key, val) == 1){
+		return 1;
+	}
+	return serv->ssdb->get(key, val);
+}
+
 static int proc_get(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 2){
 		resp->push_back("client_error");
 	}else{
 		std::string val;
-		int ret = serv->ssdb->get(req[1], &val);
+		int ret = kv_get(serv, req[1], &val);
 		if(ret == 1){
 			resp->push_back("ok");
 			resp->push_back(val);
@@ -75,12 +83,7 @@ static int proc_setx(Server *serv, Link *link, const Request &req, Response *res
 		return 0;
 	}
 	int ret;
-	ret = serv->ssdb->set(req[1], req[2]);
-	if(ret == -1){
-		resp->push_back("error");
-		return 0;
-	}
-	ret = serv->expiration->set_ttl(req[1], req[3].Int());
+	ret = serv->expiration->setx(req[1], req[2], req[3].Int());
 	if(ret == -1){
 		resp->push_back("error");
 		return 0;
@@ -96,7 +99,7 @@ static int proc_exists(Server *serv, Link *link, const Request &req, Response *r
 	}else{
 		const Bytes key = req[1];
 		std::string val;
-		int ret = serv->ssdb->get(key, &val);
+		int ret = kv_get(serv, key, &val);
 		if(ret == 1){
 			resp->push_back("ok");
 			resp->push_back("1");
@@ -119,7 +122,7 @@ static int proc_multi_exists(Server *serv, Link *link, const Request &req, Respo
 		for(Request::const_iterator it=req.begin()+1; it!=req.end(); it++){
 			const Bytes key = *it;
 			std::string val;
-			int ret = serv->ssdb->get(key, &val);
+			int ret = kv_get(serv, key, &val);
 			resp->push_back(key.String());
 			if(ret == 1){
 				resp->push_back("1");
@@ -172,18 +175,23 @@ static int proc_multi_get(Server *serv, Link *link, const Request &req, Response
 		resp->push_back("client_error");
 	}else{
 		resp->push_back("ok");
-		for(int i=1; i<req.size(); i++){
-			std::string val;
-			int ret = serv->ssdb->get(req[i], &val);
-			if(ret == 1){
-				resp->push_back(req[i].String());
-				resp->push_back(val);
-			}else if(ret == 0){
-				//
-			}else{
-				// error
-				log_error("error");
+		if(serv->counters){
+			for(Request::const_iterator it=req.begin()+1; it!=req.end(); it++){
+				std::string val;
+				int ret = kv_get(serv, *it, &val);
+				if(ret == -1){
+					resp->clear();
+					resp->push_back("error");
+					return 0;
+				}
+				if(ret == 1){
+					resp->push_back(it->String());
+					resp->push_back(val);
+				}
 			}
+		}else if(serv->ssdb->multi_get(req, 1, resp) == -1){
+			resp->clear();
+			resp->push_back("error");
 		}
 	}
 	return 0;
@@ -207,6 +215,8 @@ static int proc_del(Server *serv, Link *link, const Request &req, Response *resp
 static int proc_scan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::KV, "") == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[3].Uint64();
 		KIterator *it = serv->ssdb->scan(req[1], req[2], limit);
@@ -223,6 +233,8 @@ static int proc_scan(Server *serv, Link *link, const Request &req, Response *res
 static int proc_rscan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::KV, "") == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[3].Uint64();
 		KIterator *it = serv->ssdb->rscan(req[1], req[2], limit);
@@ -239,6 +251,8 @@ static int proc_rscan(Server *serv, Link *link, const Request &req, Response *re
 static int proc_keys(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::KV, "") == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[3].Uint64();
 		KIterator *it = serv->ssdb->scan(req[1], req[2], limit);
@@ -254,7 +268,7 @@ static int proc_keys(Server *serv, Link *link, const Request &req, Response *res
 }
 
 // dir := +1|-1
-static int _incr(SSDB *ssdb, const Request &req, Response *resp, int dir){
+static int _incr(Server *serv, const Request &req, Response *resp, int dir){
 	if(req.size() <= 1){
 		resp->push_back("client_error");
 	}else{
@@ -263,7 +277,12 @@ static int _incr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 		if(req.size() > 2){
 			val = req[2].Int64();
 		}
-		int ret = ssdb->incr(req[1], dir * val, &new_val);
+		int ret;
+		if(serv->counters){
+			ret = serv->counters->incr(req[1], dir * val, &new_val);
+		}else{
+			ret = serv->ssdb->incr(req[1], dir * val, &new_val);
+		}
 		if(ret == -1){
 			resp->push_back("error");
 		}else{
@@ -275,10 +294,10 @@ static int _incr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 }
 
 static int proc_incr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _incr(serv->ssdb, req, resp, 1);
+	return _incr(serv, req, resp, 1);
 }
 
 static int proc_decr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _incr(serv->ssdb, req, resp, -1);
+	return _incr(serv, req, resp, -1);
 }
 
@@ -56,23 +56,87 @@ static int proc_qback(Server *serv, Link *link, const Request &req, Response *re
 static int QFRONT = 2;
 static int QBACK  = 3;
 
+// answers a link taken from serv->waiters and hands it back to the main loop,
+// called in the writer thread
+static void resume_waiter(Server *serv, Link *link, const Bytes *item){
+	Response resp;
+	if(item){
+		resp.push_back("ok");
+		resp.push_back(item->String());
+	}else{
+		resp.push_back("not_found");
+	}
+	link->send(resp);
+
+	ProcJob job;
+	job.serv = serv;
+	job.link = link;
+	job.result = PROC_WOKEN;
+	serv->writer->push_result(job);
+}
+
+// pops items for links blocked on @name, after a push committed
+static int wake_waiters(Server *serv, const Bytes &name){
+	while(serv->waiters->waiting(name)){
+		Link *link = serv->waiters->take(name);
+		if(link == NULL){
+			break;
+		}
+		std::string item;
+		int ret = serv->ssdb->qpop_front(name, &item);
+		if(ret == -1){
+			resume_waiter(serv, link, NULL);
+			return -1;
+		}
+		if(ret == 0){
+			resume_waiter(serv, link, NULL);
+			break;
+		}
+		Bytes b(item);
+		resume_waiter(serv, link, &b);
+	}
+	return 0;
+}
+
+// qpush name item1 [item2 ...], returns the size of the queue
 static inline
 int proc_qpush_func(Server *serv, Link *link, const Request &req, Response *resp, int front_or_back){
 	if(req.size() < 3){
 		resp->push_back("client_error");
-	}else{
-		int ret;
-		if(front_or_back == QFRONT){
-			ret = serv->ssdb->qpush_front(req[1], req[2]);
-		}else{
-			ret = serv->ssdb->qpush_back(req[1], req[2]);
-		}
-		if(ret == -1){
-			resp->push_back("error");
-		}else{
-			resp->push_back("ok");
+		return 0;
+	}
+	int offset = 2;
+	// handoff: items go straight to blocked links, they are never
+	// written, so there is no push and pop pair in db and binlogs
+	if(serv->waiters->waiting(req[1]) && serv->ssdb->qsize(req[1]) == 0){
+		while(offset < (int)req.size()){
+			Link *waiter = serv->waiters->take(req[1]);
+			if(waiter == NULL){
+				break;
+			}
+			resume_waiter(serv, waiter, &req[offset]);
+			offset ++;
 		}
 	}
+	int64_t size;
+	if(front_or_back == QFRONT){
+		size = serv->ssdb->qpush_front(req[1], req, offset);
+	}else{
+		size = serv->ssdb->qpush_back(req[1], req, offset);
+	}
+	if(size == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	if(size > 0 && serv->waiters->waiting(req[1])){
+		// some were queued before the waiters came
+		wake_waiters(serv, req[1]);
+		size = serv->ssdb->qsize(req[1]);
+	}
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%" PRId64 "", size);
+	resp->push_back("ok");
+	resp->push_back(buf);
 	return 0;
 }
 
@@ -89,25 +153,36 @@ static int proc_qpush(Server *serv, Link *link, const Request &req, Response *re
 }
 
 
+// qpop name [size], pops at most size(default 1, at most 1000) items
 static inline
 int proc_qpop_func(Server *serv, Link *link, const Request &req, Response *resp, int front_or_back){
 	if(req.size() < 2){
 		resp->push_back("client_error");
-	}else{
-		std::string item;
-		int ret;
-		if(front_or_back == QFRONT){
-			ret = serv->ssdb->qpop_front(req[1], &item);
-		}else{
-			ret = serv->ssdb->qpop_back(req[1], &item);
+		return 0;
+	}
+	int64_t limit = 1;
+	if(req.size() > 2){
+		limit = req[2].Int64();
+		if(limit <= 0){
+			resp->push_back("client_error");
+			return 0;
 		}
-		if(ret == -1){
-			resp->push_back("error");
-		}else if(ret == 0){
-			resp->push_back("not_found");
-		}else{
-			resp->push_back("ok");
-			resp->push_back(item);
+	}
+	std::vector<std::string> items;
+	int64_t ret;
+	if(front_or_back == QFRONT){
+		ret = serv->ssdb->qpop_front(req[1], limit, &items);
+	}else{
+		ret = serv->ssdb->qpop_back(req[1], limit, &items);
+	}
+	if(ret == -1){
+		resp->push_back("error");
+	}else if(ret == 0){
+		resp->push_back("not_found");
+	}else{
+		resp->push_back("ok");
+		for(int i=0; i<(int)items.size(); i++){
+			resp->push_back(items[i]);
 		}
 	}
 	return 0;
@@ -125,6 +200,74 @@ static int proc_qpop(Server *serv, Link *link, const Request &req, Response *res
 	return proc_qpop_func(serv, link, req, resp, QFRONT);
 }
 
+// qpop_block name timeout, timeout in seconds, 0 waits forever
+static int proc_qpop_block(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	double timeout = atof(req[2].String().c_str());
+	if(timeout < 0){
+		resp->push_back("client_error");
+		return 0;
+	}
+	std::string item;
+	int ret = serv->ssdb->qpop_front(req[1], &item);
+	if(ret == -1){
+		resp->push_back("error");
+	}else if(ret == 1){
+		resp->push_back("ok");
+		resp->push_back(item);
+	}else{
+		int64_t ms = (int64_t)(timeout * 1000);
+		if(timeout > 0 && ms == 0){
+			ms = 1;
+		}
+		// runs in the writer thread, as every qpush, so no push is
+		// missed before the link is added
+		serv->waiters->add(req[1], link, ms);
+		return PROC_BLOCKED;
+	}
+	return 0;
+}
+
+// qtrim_front|qtrim_back name size, deletes size items
+static inline
+int proc_qtrim_func(Server *serv, Link *link, const Request &req, Response *resp, int front_or_back){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t count = req[2].Int64();
+	if(count < 0){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t ret;
+	if(front_or_back == QFRONT){
+		ret = serv->ssdb->qtrim_front(req[1], count);
+	}else{
+		ret = serv->ssdb->qtrim_back(req[1], count);
+	}
+	if(ret == -1){
+		resp->push_back("error");
+	}else{
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_qtrim_front(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_qtrim_func(serv, link, req, resp, QFRONT);
+}
+
+static int proc_qtrim_back(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_qtrim_func(serv, link, req, resp, QBACK);
+}
+
 static int proc_qlist(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
@@ -162,28 +305,28 @@ static int proc_qclear(Server *serv, Link *link, const Request &req, Response *r
 	if(req.size() < 2){
 		resp->push_back("client_error");
 	}else{
-		uint64_t total = 0;
-		
-		while(1){
-			std::string item;
-			int ret = serv->ssdb->qpop_front(req[1], &item);
-			if(ret == 0){
-				break;
-			}
-			if(ret == -1){
-				return -1;
-			}
-			total += 1;
+		int64_t total = serv->ssdb->qclear(req[1]);
+		if(total == -1 || serv->expiration->set_container_ttl(DataType::QSIZE, req[1], 0) == -1){
+			resp->push_back("error");
+			return 0;
 		}
 		
 		char buf[20];
-		snprintf(buf, sizeof(buf), "%" PRIu64 "", total);
+		snprintf(buf, sizeof(buf), "%" PRId64 "", total);
 		resp->push_back("ok");
 		resp->push_back(buf);
 	}
 	return 0;
 }
 
+static int proc_qexpire(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_expire(serv, DataType::QSIZE, req, resp);
+}
+
+static int proc_qttl(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_ttl(serv, DataType::QSIZE, req, resp);
+}
+
 static int proc_qslice(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
@@ -204,6 +347,37 @@ static int proc_qslice(Server *serv, Link *link, const Request &req, Response *r
 	return 0;
 }
 
+static inline
+int proc_qrange_func(Server *serv, Link *link, const Request &req, Response *resp, bool reverse){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		int64_t offset = req[2].Int64();
+		int64_t limit = req[3].Int64();
+		std::vector<std::string> list;
+		int ret = serv->ssdb->qrange(req[1], offset, limit, reverse, &list);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			for(int i=0; i<list.size(); i++){
+				resp->push_back(list[i]);
+			}
+		}
+	}
+	return 0;
+}
+
+// qrange name offset limit, from the front
+static int proc_qrange(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_qrange_func(serv, link, req, resp, false);
+}
+
+// qrrange name offset limit, from the back
+static int proc_qrrange(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_qrange_func(serv, link, req, resp, true);
+}
+
 static int proc_qget(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 3){
 		resp->push_back("client_error");
@@ -0,0 +1,128 @@
+/* stream */
+
+// xadd name item1 [item2 ...], returns the ids of the items
+static int proc_xadd(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	uint64_t id;
+	int64_t ret = serv->ssdb->xadd(req[1], req, 2, &id);
+	if(ret == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	resp->push_back("ok");
+	for(int i=2; i<(int)req.size(); i++, id++){
+		resp->push_back(uint64_to_str(id));
+	}
+	return 0;
+}
+
+// xget name id
+static int proc_xget(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		std::string item;
+		int ret = serv->ssdb->xget(req[1], req[2].Uint64(), &item);
+		if(ret == -1){
+			resp->push_back("error");
+		}else if(ret == 0){
+			resp->push_back("not_found");
+		}else{
+			resp->push_back("ok");
+			resp->push_back(item);
+		}
+	}
+	return 0;
+}
+
+// xread name group limit, returns id, item, ...
+static int proc_xread(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		std::vector<std::string> list;
+		int ret = serv->ssdb->xread(req[1], req[2], req[3].Int64(), &list);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			for(int i=0; i<(int)list.size(); i++){
+				resp->push_back(list[i]);
+			}
+		}
+	}
+	return 0;
+}
+
+// xack name group id1 [id2 ...]
+static int proc_xack(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->xack(req[1], req[2], req, 3);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+			resp->push_back("ok");
+			resp->push_back(buf);
+		}
+	}
+	return 0;
+}
+
+// xpending name group limit, returns id, delivery time in ms, ...
+static int proc_xpending(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		std::vector<std::string> list;
+		int ret = serv->ssdb->xpending(req[1], req[2], req[3].Int64(), &list);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+			for(int i=0; i<(int)list.size(); i++){
+				resp->push_back(list[i]);
+			}
+		}
+	}
+	return 0;
+}
+
+// xgroup_setid name group id
+static int proc_xgroup_setid(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+	}else{
+		int ret = serv->ssdb->xgroup_setid(req[1], req[2], req[3].Uint64());
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			resp->push_back("ok");
+		}
+	}
+	return 0;
+}
+
+// xgroup_del name group
+static int proc_xgroup_del(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+	}else{
+		int64_t ret = serv->ssdb->xgroup_del(req[1], req[2]);
+		if(ret == -1){
+			resp->push_back("error");
+		}else{
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+			resp->push_back("ok");
+			resp->push_back(buf);
+		}
+	}
+	return 0;
+}
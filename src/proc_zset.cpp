@@ -1,5 +1,13 @@
 /* zset */
 
+// a buffered counter first
+static int zset_get(Server *serv, const Bytes &name, const Bytes &key, std::string *score){
+	if(serv->counters && serv->counters->zget(name, key, score) == 1){
+		return 1;
+	}
+	return serv->ssdb->zget(name, key, score);
+}
+
 static int proc_zexists(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 3){
 		resp->push_back("client_error");
@@ -7,7 +15,7 @@ static int proc_zexists(Server *serv, Link *link, const Request &req, Response *
 		const Bytes &name = req[1];
 		const Bytes &key = req[2];
 		std::string val;
-		int ret = serv->ssdb->zget(name, key, &val);
+		int ret = zset_get(serv, name, key, &val);
 		if(ret == -1){
 			resp->push_back("error");
 			resp->push_back("0");
@@ -31,7 +39,7 @@ static int proc_multi_zexists(Server *serv, Link *link, const Request &req, Resp
 		std::string val;
 		for(Request::const_iterator it=req.begin()+2; it!=req.end(); it++){
 			const Bytes &key = *it;
-			int64_t ret = serv->ssdb->zget(name, key, &val);
+			int64_t ret = zset_get(serv, name, key, &val);
 			resp->push_back(key.String());
 			if(ret > 0){
 				resp->push_back("1");
@@ -50,7 +58,10 @@ static int proc_multi_zsize(Server *serv, Link *link, const Request &req, Respon
 		resp->push_back("ok");
 		for(Request::const_iterator it=req.begin()+1; it!=req.end(); it++){
 			const Bytes &key = *it;
-			int64_t ret = serv->ssdb->zsize(key);
+			int64_t ret = -1;
+			if(flush_counters(serv, DataType::ZSIZE, key) != -1){
+				ret = serv->ssdb->zsize(key);
+			}
 			resp->push_back(key.String());
 			if(ret == -1){
 				resp->push_back("-1");
@@ -120,21 +131,23 @@ static int proc_multi_zget(Server *serv, Link *link, const Request &req, Respons
 		resp->push_back("client_error");
 	}else{
 		resp->push_back("ok");
-		Request::const_iterator it=req.begin() + 1;
-		const Bytes name = *it;
-		it ++;
-		for(; it!=req.end(); it+=1){
-			const Bytes &key = *it;
-			std::string score;
-			int ret = serv->ssdb->zget(name, key, &score);
-			if(ret == 1){
-				resp->push_back(key.String());
-				resp->push_back(score);
-			}else if(ret == 0){
-				//
-			}else{
-				resp->push_back("0");
+		if(serv->counters){
+			for(Request::const_iterator it=req.begin()+2; it!=req.end(); it++){
+				std::string score;
+				int ret = zset_get(serv, req[1], *it, &score);
+				if(ret == -1){
+					resp->clear();
+					resp->push_back("error");
+					return 0;
+				}
+				if(ret == 1){
+					resp->push_back(it->String());
+					resp->push_back(score);
+				}
 			}
+		}else if(serv->ssdb->multi_zget(req[1], req, 2, resp) == -1){
+			resp->clear();
+			resp->push_back("error");
 		}
 	}
 	return 0;
@@ -160,6 +173,8 @@ static int proc_zset(Server *serv, Link *link, const Request &req, Response *res
 static int proc_zsize(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 2){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		int64_t ret = serv->ssdb->zsize(req[1]);
 		if(ret == -1){
@@ -177,7 +192,7 @@ static int proc_zsize(Server *serv, Link *link, const Request &req, Response *re
 static int proc_zget(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() >= 3){
 		std::string score;
-		int ret = serv->ssdb->zget(req[1], req[2], &score);
+		int ret = zset_get(serv, req[1], req[2], &score);
 		if(ret == 1){
 			resp->push_back("ok");
 			resp->push_back(score);
@@ -214,6 +229,8 @@ static int proc_zdel(Server *serv, Link *link, const Request &req, Response *res
 static int proc_zrank(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() != 3){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		int64_t ret = serv->ssdb->zrank(req[1], req[2]);
 		char buf[20];
@@ -227,6 +244,8 @@ static int proc_zrank(Server *serv, Link *link, const Request &req, Response *re
 static int proc_zrrank(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() != 3){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		int64_t ret = serv->ssdb->zrrank(req[1], req[2]);
 		char buf[20];
@@ -240,14 +259,19 @@ static int proc_zrrank(Server *serv, Link *link, const Request &req, Response *r
 static int proc_zrange(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t offset = req[2].Uint64();
 		uint64_t limit = req[3].Uint64();
-		ZIterator *it = serv->ssdb->zrange(req[1], offset, limit);
 		resp->push_back("ok");
+		if(serv->ssdb->zrange_cached(req[1], offset, limit, false, resp) == 1){
+			return 0;
+		}
+		ZIterator *it = serv->ssdb->zrange(req[1], offset, limit);
 		while(it->next()){
-			resp->push_back(it->key);
-			resp->push_back(it->score);
+			resp->push_back(it->key.String());
+			resp->push_back(int64_to_str(it->score));
 		}
 		delete it;
 	}
@@ -257,14 +281,19 @@ static int proc_zrange(Server *serv, Link *link, const Request &req, Response *r
 static int proc_zrrange(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t offset = req[2].Uint64();
 		uint64_t limit = req[3].Uint64();
-		ZIterator *it = serv->ssdb->zrrange(req[1], offset, limit);
 		resp->push_back("ok");
+		if(serv->ssdb->zrange_cached(req[1], offset, limit, true, resp) == 1){
+			return 0;
+		}
+		ZIterator *it = serv->ssdb->zrrange(req[1], offset, limit);
 		while(it->next()){
-			resp->push_back(it->key);
-			resp->push_back(it->score);
+			resp->push_back(it->key.String());
+			resp->push_back(int64_to_str(it->score));
 		}
 		delete it;
 	}
@@ -277,38 +306,32 @@ static int proc_zclear(Server *serv, Link *link, const Request &req, Response *r
 		return 0;
 	}
 	
-	const Bytes &name = req[1];
-	uint64_t total = 0;
-	while(1){
-		ZIterator *it = serv->ssdb->zrange(name, 0, 1000);
-		int num = 0;
-		while(it->next()){
-			int ret = serv->ssdb->zdel(name, it->key);
-			if(ret == -1){
-				resp->push_back("error");
-				delete it;
-				return 0;
-			}
-			num ++;
-		};
-		delete it;
-		
-		if(num == 0){
-			break;
-		}
-		total += num;
+	int64_t total = serv->ssdb->zclear(req[1]);
+	if(total == -1 || serv->expiration->set_container_ttl(DataType::ZSIZE, req[1], 0) == -1){
+		resp->push_back("error");
+		return 0;
 	}
 	char buf[20];
-	snprintf(buf, sizeof(buf), "%" PRIu64 "", total);
+	snprintf(buf, sizeof(buf), "%" PRId64 "", total);
 	resp->push_back("ok");
 	resp->push_back(buf);
 
 	return 0;
 }
 
+static int proc_zexpire(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_expire(serv, DataType::ZSIZE, req, resp);
+}
+
+static int proc_zttl(Server *serv, Link *link, const Request &req, Response *resp){
+	return proc_container_ttl(serv, DataType::ZSIZE, req, resp);
+}
+
 static int proc_zscan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 6){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[5].Uint64();
 		uint64_t offset = 0;
@@ -322,8 +345,8 @@ static int proc_zscan(Server *serv, Link *link, const Request &req, Response *re
 		}
 		resp->push_back("ok");
 		while(it->next()){
-			resp->push_back(it->key);
-			resp->push_back(it->score);
+			resp->push_back(it->key.String());
+			resp->push_back(int64_to_str(it->score));
 		}
 		delete it;
 	}
@@ -333,6 +356,8 @@ static int proc_zscan(Server *serv, Link *link, const Request &req, Response *re
 static int proc_zrscan(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 6){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[5].Uint64();
 		uint64_t offset = 0;
@@ -346,8 +371,8 @@ static int proc_zrscan(Server *serv, Link *link, const Request &req, Response *r
 		}
 		resp->push_back("ok");
 		while(it->next()){
-			resp->push_back(it->key);
-			resp->push_back(it->score);
+			resp->push_back(it->key.String());
+			resp->push_back(int64_to_str(it->score));
 		}
 		delete it;
 	}
@@ -357,21 +382,69 @@ static int proc_zrscan(Server *serv, Link *link, const Request &req, Response *r
 static int proc_zkeys(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 6){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[5].Uint64();
 		ZIterator *it = serv->ssdb->zscan(req[1], req[2], req[3], req[4], limit);
 		resp->push_back("ok");
 		while(it->next()){
-			resp->push_back(it->key);
+			resp->push_back(it->key.String());
 		}
 		delete it;
 	}
 	return 0;
 }
 
+// zrangebylex name min max offset limit [score]
+static int proc_zrangebylex(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 6){
+		resp->push_back("client_error");
+		return 0;
+	}
+	if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	Bytes score = req.size() > 6? req[6] : Bytes("");
+	resp->push_back("ok");
+	int64_t ret = serv->ssdb->zrangebylex(req[1], req[2], req[3], score,
+		req[4].Uint64(), req[5].Uint64(), resp);
+	if(ret == -2){
+		resp->clear();
+		resp->push_back("client_error");
+	}
+	return 0;
+}
+
+// zlexcount name min max [score]
+static int proc_zlexcount(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 4){
+		resp->push_back("client_error");
+		return 0;
+	}
+	if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	Bytes score = req.size() > 4? req[4] : Bytes("");
+	int64_t ret = serv->ssdb->zrangebylex(req[1], req[2], req[3], score, 0, UINT64_MAX, NULL);
+	if(ret == -2){
+		resp->push_back("client_error");
+		return 0;
+	}
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+	resp->push_back("ok");
+	resp->push_back(buf);
+	return 0;
+}
+
 static int proc_zlist(Server *serv, Link *link, const Request &req, Response *resp){
 	if(req.size() < 4){
 		resp->push_back("client_error");
+	}else if(flush_counters(serv, DataType::ZSIZE, "") == -1){
+		resp->push_back("error");
 	}else{
 		uint64_t limit = req[3].Uint64();
 		std::vector<std::string> list;
@@ -389,7 +462,7 @@ static int proc_zlist(Server *serv, Link *link, const Request &req, Response *re
 }
 
 // dir := +1|-1
-static int _zincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
+static int _zincr(Server *serv, const Request &req, Response *resp, int dir){
 	if(req.size() < 3){
 		resp->push_back("client_error");
 	}else{
@@ -398,7 +471,12 @@ static int _zincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 		if(req.size() > 3){
 			val = req[3].Int64();
 		}
-		int ret = ssdb->zincr(req[1], req[2], dir * val, &new_val);
+		int ret;
+		if(serv->counters){
+			ret = serv->counters->zincr(req[1], req[2], dir * val, &new_val);
+		}else{
+			ret = serv->ssdb->zincr(req[1], req[2], dir * val, &new_val);
+		}
 		if(ret == -1){
 			resp->push_back("error");
 		}else{
@@ -410,11 +488,11 @@ static int _zincr(SSDB *ssdb, const Request &req, Response *resp, int dir){
 }
 
 static int proc_zincr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _zincr(serv->ssdb, req, resp, 1);
+	return _zincr(serv, req, resp, 1);
 }
 
 static int proc_zdecr(Server *serv, Link *link, const Request &req, Response *resp){
-	return _zincr(serv->ssdb, req, resp, -1);
+	return _zincr(serv, req, resp, -1);
 }
 
 static int proc_zcount(Server *serv, Link *link, const Request &req, Response *resp){
@@ -422,6 +500,10 @@ static int proc_zcount(Server *serv, Link *link, const Request &req, Response *r
 		resp->push_back("client_error");
 		return 0;
 	}
+	if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
+		return 0;
+	}
 	uint64_t count = 0;
 	ZIterator *it = serv->ssdb->zscan(req[1], "", req[2], req[3], -1);
 	while(it->next()){
@@ -441,10 +523,14 @@ static int proc_zsum(Server *serv, Link *link, const Request &req, Response *res
 		resp->push_back("client_error");
 		return 0;
 	}
+	if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
+		return 0;
+	}
 	int64_t sum = 0;
 	ZIterator *it = serv->ssdb->zscan(req[1], "", req[2], req[3], -1);
 	while(it->next()){
-		sum += str_to_int64(it->score);
+		sum += it->score;
 	}
 	delete it;
 	
@@ -460,11 +546,15 @@ static int proc_zavg(Server *serv, Link *link, const Request &req, Response *res
 		resp->push_back("client_error");
 		return 0;
 	}
+	if(flush_counters(serv, DataType::ZSIZE, req[1]) == -1){
+		resp->push_back("error");
+		return 0;
+	}
 	int64_t sum = 0;
 	uint64_t count = 0;
 	ZIterator *it = serv->ssdb->zscan(req[1], "", req[2], req[3], -1);
 	while(it->next()){
-		sum += str_to_int64(it->score);
+		sum += it->score;
 		count ++;
 	}
 	delete it;
@@ -529,3 +619,102 @@ static int proc_zremrangebyrank(Server *serv, Link *link, const Request &req, Re
 	return 0;
 }
 
+
+// req[pos...]: numkeys name... [weights weight...] [aggregate sum|min|max]
+static int parse_zsetop(const Request &req, int pos, bool diff,
+		std::vector<Bytes> *names, std::vector<int64_t> *weights, std::string *aggregate)
+{
+	if((int)req.size() <= pos){
+		return -1;
+	}
+	int64_t num = req[pos].Int64();
+	pos ++;
+	if(num < 1 || num > (int64_t)req.size() - pos){
+		return -1;
+	}
+	names->assign(req.begin() + pos, req.begin() + pos + num);
+	pos += num;
+	while(pos < (int)req.size()){
+		std::string opt = req[pos].String();
+		strtolower(&opt);
+		if(!diff && opt == "weights" && weights->empty() && (int)req.size() - pos > num){
+			for(int i=0; i<num; i++){
+				weights->push_back(req[pos + 1 + i].Int64());
+			}
+			pos += 1 + num;
+		}else if(!diff && opt == "aggregate" && aggregate->empty() && (int)req.size() - pos > 1){
+			*aggregate = req[pos + 1].String();
+			strtolower(aggregate);
+			pos += 2;
+		}else{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// dest: zunionstore dest numkeys ..., or zunion numkeys ...
+static int _zsetop(Server *serv, const Request &req, Response *resp, const char *op, bool store){
+	std::vector<Bytes> names;
+	std::vector<int64_t> weights;
+	std::string aggregate;
+	int pos = store? 2 : 1;
+	if(parse_zsetop(req, pos, strcmp(op, "diff") == 0, &names, &weights, &aggregate) == -1){
+		resp->push_back("client_error");
+		return 0;
+	}
+	if(!store){
+		for(int i=0; i<(int)names.size(); i++){
+			if(flush_counters(serv, DataType::ZSIZE, names[i]) == -1){
+				resp->push_back("error");
+				return 0;
+			}
+		}
+	}
+	Bytes dest;
+	if(store){
+		dest = req[1];
+		if(dest.empty()){
+			resp->push_back("client_error");
+			return 0;
+		}
+	}
+	resp->push_back("ok");
+	int64_t ret = serv->ssdb->zsetop(op, dest, names, 0, weights, aggregate, resp);
+	if(ret == -2){
+		resp->clear();
+		resp->push_back("client_error");
+	}else if(ret == -1){
+		resp->clear();
+		resp->push_back("error");
+	}else if(store){
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%" PRId64 "", ret);
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+static int proc_zunionstore(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "union", true);
+}
+
+static int proc_zinterstore(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "inter", true);
+}
+
+static int proc_zdiffstore(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "diff", true);
+}
+
+static int proc_zunion(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "union", false);
+}
+
+static int proc_zinter(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "inter", false);
+}
+
+static int proc_zdiff(Server *serv, Link *link, const Request &req, Response *resp){
+	return _zsetop(serv, req, resp, "diff", false);
+}
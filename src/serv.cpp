@@ -5,6 +5,7 @@
 #include "t_kv.h"
 #include "t_hash.h"
 #include "t_zset.h"
+#include "t_dzset.h"
 
 struct BytesEqual{
 	bool operator()(const Bytes &s1, const Bytes &s2) const {
@@ -75,6 +76,8 @@ static proc_map_t proc_map;
 	DEF_PROC(multi_hget);
 	DEF_PROC(multi_hset);
 	DEF_PROC(multi_hdel);
+	DEF_PROC(hexpire);
+	DEF_PROC(httl);
 
 	DEF_PROC(zrank);
 	DEF_PROC(zrrank);
@@ -91,6 +94,8 @@ static proc_map_t proc_map;
 	DEF_PROC(zrscan);
 	DEF_PROC(zkeys);
 	DEF_PROC(zlist);
+	DEF_PROC(zrangebylex);
+	DEF_PROC(zlexcount);
 	DEF_PROC(zcount);
 	DEF_PROC(zsum);
 	DEF_PROC(zavg);
@@ -102,6 +107,33 @@ static proc_map_t proc_map;
 	DEF_PROC(multi_zget);
 	DEF_PROC(multi_zset);
 	DEF_PROC(multi_zdel);
+	DEF_PROC(zexpire);
+	DEF_PROC(zttl);
+	DEF_PROC(zunionstore);
+	DEF_PROC(zinterstore);
+	DEF_PROC(zdiffstore);
+	DEF_PROC(zunion);
+	DEF_PROC(zinter);
+	DEF_PROC(zdiff);
+
+	DEF_PROC(dzset);
+	DEF_PROC(dzget);
+	DEF_PROC(dzdel);
+	DEF_PROC(dzincr);
+	DEF_PROC(dzsize);
+	DEF_PROC(dzclear);
+	DEF_PROC(dzrank);
+	DEF_PROC(dzrrank);
+	DEF_PROC(dzrange);
+	DEF_PROC(dzrrange);
+	DEF_PROC(dzscan);
+	DEF_PROC(dzrscan);
+	DEF_PROC(dzcount);
+	DEF_PROC(dzrangebylex);
+	DEF_PROC(dzlexcount);
+	DEF_PROC(dzlist);
+	DEF_PROC(multi_dzset);
+	DEF_PROC(multi_dzdel);
 	
 	DEF_PROC(qsize);
 	DEF_PROC(qfront);
@@ -112,11 +144,37 @@ static proc_map_t proc_map;
 	DEF_PROC(qpop);
 	DEF_PROC(qpop_front);
 	DEF_PROC(qpop_back);
+	DEF_PROC(qpop_block);
+	DEF_PROC(qtrim_front);
+	DEF_PROC(qtrim_back);
 	DEF_PROC(qfix);
 	DEF_PROC(qclear);
 	DEF_PROC(qlist);
 	DEF_PROC(qslice);
+	DEF_PROC(qrange);
+	DEF_PROC(qrrange);
 	DEF_PROC(qget);
+	DEF_PROC(qexpire);
+	DEF_PROC(qttl);
+
+	DEF_PROC(setbit);
+	DEF_PROC(getbit);
+	DEF_PROC(bitcount);
+	DEF_PROC(bitop);
+	DEF_PROC(bclear);
+
+	DEF_PROC(pfadd);
+	DEF_PROC(pfcount);
+	DEF_PROC(pfmerge);
+	DEF_PROC(pfclear);
+
+	DEF_PROC(xadd);
+	DEF_PROC(xget);
+	DEF_PROC(xread);
+	DEF_PROC(xack);
+	DEF_PROC(xpending);
+	DEF_PROC(xgroup_setid);
+	DEF_PROC(xgroup_del);
 
 	DEF_PROC(dump);
 	DEF_PROC(sync140);
@@ -124,6 +182,7 @@ static proc_map_t proc_map;
 	DEF_PROC(compact);
 	DEF_PROC(key_range);
 	DEF_PROC(ttl);
+	DEF_PROC(flush);
 	DEF_PROC(clear_binlog);
 	DEF_PROC(ping);
 #undef DEF_PROC
@@ -137,8 +196,8 @@ static Command commands[] = {
 	PROC(setnx, "wt"),
 	PROC(getset, "wt"),
 	PROC(del, "wt"),
-	PROC(incr, "wt"),
-	PROC(decr, "wt"),
+	PROC(incr, "wtc"),
+	PROC(decr, "wtc"),
 	PROC(scan, "rt"),
 	PROC(rscan, "rt"),
 	PROC(keys, "rt"),
@@ -152,8 +211,8 @@ static Command commands[] = {
 	PROC(hget, "r"),
 	PROC(hset, "wt"),
 	PROC(hdel, "wt"),
-	PROC(hincr, "wt"),
-	PROC(hdecr, "wt"),
+	PROC(hincr, "wtc"),
+	PROC(hdecr, "wtc"),
 	PROC(hclear, "wt"),
 	PROC(hscan, "rt"),
 	PROC(hrscan, "rt"),
@@ -166,6 +225,8 @@ static Command commands[] = {
 	PROC(multi_hget, "r"),
 	PROC(multi_hset, "wt"),
 	PROC(multi_hdel, "wt"),
+	PROC(hexpire, "wt"),
+	PROC(httl, "r"),
 
 	// because zrank may be extremly slow, execute in a seperate thread
 	PROC(zrank, "rt"),
@@ -176,13 +237,15 @@ static Command commands[] = {
 	PROC(zget, "rt"),
 	PROC(zset, "wt"),
 	PROC(zdel, "wt"),
-	PROC(zincr, "wt"),
-	PROC(zdecr, "wt"),
+	PROC(zincr, "wtc"),
+	PROC(zdecr, "wtc"),
 	PROC(zclear, "wt"),
 	PROC(zscan, "rt"),
 	PROC(zrscan, "rt"),
 	PROC(zkeys, "rt"),
 	PROC(zlist, "rt"),
+	PROC(zrangebylex, "rt"),
+	PROC(zlexcount, "rt"),
 	PROC(zcount, "rt"),
 	PROC(zsum, "rt"),
 	PROC(zavg, "rt"),
@@ -194,6 +257,33 @@ static Command commands[] = {
 	PROC(multi_zget, "r"),
 	PROC(multi_zset, "wt"),
 	PROC(multi_zdel, "wt"),
+	PROC(zexpire, "wt"),
+	PROC(zttl, "r"),
+	PROC(zunionstore, "wt"),
+	PROC(zinterstore, "wt"),
+	PROC(zdiffstore, "wt"),
+	PROC(zunion, "rt"),
+	PROC(zinter, "rt"),
+	PROC(zdiff, "rt"),
+
+	PROC(dzset, "wt"),
+	PROC(dzget, "r"),
+	PROC(dzdel, "wt"),
+	PROC(dzincr, "wt"),
+	PROC(dzsize, "r"),
+	PROC(dzclear, "wt"),
+	PROC(dzrank, "rt"),
+	PROC(dzrrank, "rt"),
+	PROC(dzrange, "rt"),
+	PROC(dzrrange, "rt"),
+	PROC(dzscan, "rt"),
+	PROC(dzrscan, "rt"),
+	PROC(dzcount, "rt"),
+	PROC(dzrangebylex, "rt"),
+	PROC(dzlexcount, "rt"),
+	PROC(dzlist, "rt"),
+	PROC(multi_dzset, "wt"),
+	PROC(multi_dzdel, "wt"),
 
 	PROC(qsize, "r"),
 	PROC(qfront, "r"),
@@ -204,11 +294,37 @@ static Command commands[] = {
 	PROC(qpop, "wt"),
 	PROC(qpop_front, "wt"),
 	PROC(qpop_back, "wt"),
+	PROC(qpop_block, "wt"),
+	PROC(qtrim_front, "wt"),
+	PROC(qtrim_back, "wt"),
 	PROC(qfix, "wt"),
 	PROC(qclear, "wt"),
 	PROC(qlist, "rt"),
 	PROC(qslice, "rt"),
+	PROC(qrange, "rt"),
+	PROC(qrrange, "rt"),
 	PROC(qget, "r"),
+	PROC(qexpire, "wt"),
+	PROC(qttl, "r"),
+
+	PROC(setbit, "wt"),
+	PROC(getbit, "r"),
+	PROC(bitcount, "rt"),
+	PROC(bitop, "wt"),
+	PROC(bclear, "wt"),
+
+	PROC(pfadd, "wt"),
+	PROC(pfcount, "rt"),
+	PROC(pfmerge, "wt"),
+	PROC(pfclear, "wt"),
+
+	PROC(xadd, "wt"),
+	PROC(xget, "r"),
+	PROC(xread, "wt"),
+	PROC(xack, "wt"),
+	PROC(xpending, "rt"),
+	PROC(xgroup_setid, "wt"),
+	PROC(xgroup_del, "wt"),
 
 	PROC(clear_binlog, "wt"),
 
@@ -221,13 +337,14 @@ static Command commands[] = {
 	PROC(key_range, "r"),
 
 	PROC(ttl, "wt"),
+	PROC(flush, "wtc"),
 	PROC(ping, "r"),
 
 	{NULL, NULL, 0, NULL}
 };
 #undef PROC
 
-Server::Server(SSDB *ssdb){
+Server::Server(SSDB *ssdb, const Config &conf){
 	this->ssdb = ssdb;
 	backend_dump = new BackendDump(ssdb);
 	backend_sync = new BackendSync(ssdb);
@@ -247,15 +364,45 @@ Server::Server(SSDB *ssdb){
 				case 't':
 					cmd->flags |= Command::FLAG_THREAD;
 					break;
+				case 'c':
+					cmd->flags |= Command::FLAG_COUNTER;
+					break;
 			}
 		}
 		proc_map[cmd->name] = cmd;
 	}
 	// for k-v data, list === keys
 	proc_map["list"] = proc_map["keys"];
-
-	expiration = new ExpirationHandler(ssdb);
+	proc_map["bqpop"] = proc_map["qpop_block"];
+
+	{
+		int speed = conf.get_num("server.expiration_speed");
+		int window = conf.get_num("server.expiration_window");
+		int max_keys = conf.get_num("server.expiration_max_keys");
+		log_info("expiration       : %d keys/s", speed);
+		log_info("expiration_window: %d min, max %d keys",
+			window > 0? window : 10, max_keys > 0? max_keys : 1000000);
+		expiration = new ExpirationHandler(ssdb, speed, window, max_keys);
+	}
+	ssdb->expiration = expiration;
+
+	counters = NULL;
+	{
+		int interval = conf.get_num("server.counter_flush_interval");
+		if(interval > 0){
+			log_info("counter_flush_interval: %d ms", interval);
+			counters = new CounterBuffer(ssdb, interval);
+		}
+	}
+	ssdb->counters = counters;
 	
+	waiters = new QueueWaiters();
+
+	if(strcmp(conf.get_str("server.redis_zset"), "double") == 0){
+		log_info("redis_zset       : double");
+		RedisLink::double_zset = true;
+	}
+
 	writer = new WorkerPool<ProcWorker, ProcJob>("writer");
 	writer->start(WRITER_THREADS);
 	reader = new WorkerPool<ProcWorker, ProcJob>("reader");
@@ -266,6 +413,7 @@ Server::~Server(){
 	delete backend_dump;
 	delete backend_sync;
 	
+	ssdb->expiration = NULL;
 	delete expiration;
 	
 	writer->stop();
@@ -273,6 +421,11 @@ Server::~Server(){
 	reader->stop();
 	delete reader;
 
+	// after the writer stopped, no more increments
+	ssdb->counters = NULL;
+	delete counters;
+	delete waiters;
+
 	log_debug("Server finalized");
 }
 
@@ -339,11 +492,25 @@ int Server::ProcWorker::proc(ProcJob *job){
 	Response resp;
 	
 	double stime = millitime();
+	if(job->serv->counters && (job->cmd->flags & Command::FLAG_WRITE)
+		&& !(job->cmd->flags & Command::FLAG_COUNTER))
+	{
+		// keeps writes to the same keys in order
+		if(job->serv->counters->flush() == -1){
+			resp.push_back("error");
+			job->link->send(resp);
+			return 0;
+		}
+	}
 	proc_t p = job->cmd->proc;
 	job->result = (*p)(job->serv, job->link, *req, &resp);
 	double etime = millitime();
 	job->time_wait = 1000 * (stime - job->stime);
 	job->time_proc = 1000 *(etime - stime);
+	if(job->result == PROC_BLOCKED){
+		// answered later by a qpush, or by the main loop on timeout
+		return 0;
+	}
 
 	if(job->link->send(resp) == -1){
 		job->result = PROC_ERROR;
@@ -390,6 +557,23 @@ static int proc_info(Server *serv, Link *link, const Request &req, Response *res
 		}
 	}
 
+	if(req.size() == 1 || req[1] == "expiration"){
+		resp->push_back("expiration");
+		resp->push_back(serv->expiration->stats());
+	}
+
+	if(serv->counters && (req.size() == 1 || req[1] == "counters")){
+		resp->push_back("counters");
+		resp->push_back(serv->counters->stats());
+	}
+
+	if(req.size() == 1 || req[1] == "waiters"){
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%d", serv->waiters->size());
+		resp->push_back("queue_waiters");
+		resp->push_back(buf);
+	}
+
 	if(req.size() == 1 || req[1] == "range"){
 		std::vector<std::string> tmp;
 		int ret = serv->ssdb->key_range(&tmp);
@@ -430,8 +614,32 @@ static int proc_info(Server *serv, Link *link, const Request &req, Response *res
 	return 0;
 }
 
+// compact [kv|binlog [start] [end]]
+// compact [hash|zset|queue|bitmap [name]]
 static int proc_compact(Server *serv, Link *link, const Request &req, Response *resp){
-	serv->ssdb->compact();
+	if(req.size() == 1){
+		serv->ssdb->compact();
+	}else{
+		std::string type = req[1].String();
+		Bytes start, end;
+		if(req.size() > 2){
+			start = req[2];
+		}
+		if(req.size() > 3){
+			end = req[3];
+		}
+		int ret = serv->ssdb->compact(type, start, end);
+		if(ret == -1){
+			resp->push_back("client_error");
+			resp->push_back("unknown type: " + type);
+			return 0;
+		}
+		if(ret == -2){
+			resp->push_back("client_error");
+			resp->push_back("no range of names for " + type + ", one name or all");
+			return 0;
+		}
+	}
 	resp->push_back("ok");
 	return 0;
 }
@@ -465,12 +673,103 @@ static int proc_ttl(Server *serv, Link *link, const Request &req, Response *resp
 	return 0;
 }
 
+static int64_t container_size(Server *serv, char type, const Bytes &name){
+	switch(type){
+		case DataType::HSIZE:
+			return serv->ssdb->hsize(name);
+		case DataType::ZSIZE:
+			return serv->ssdb->zsize(name);
+		default:
+			return serv->ssdb->qsize(name);
+	}
+}
+
+// hexpire|zexpire|qexpire name ttl, ttl <= 0 removes the ttl
+static int proc_container_expire(Server *serv, char type, const Request &req, Response *resp){
+	if(req.size() < 3){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t size = container_size(serv, type, req[1]);
+	if(size == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	if(size == 0){
+		resp->push_back("ok");
+		resp->push_back("0");
+		return 0;
+	}
+	if(serv->expiration->set_container_ttl(type, req[1], req[2].Int64()) == -1){
+		resp->push_back("error");
+		return 0;
+	}
+	resp->push_back("ok");
+	resp->push_back("1");
+	return 0;
+}
+
+// httl|zttl|qttl name, returns ttl in seconds, -1 if there is none
+static int proc_container_ttl(Server *serv, char type, const Request &req, Response *resp){
+	if(req.size() < 2){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int64_t ttl = serv->expiration->container_ttl(type, req[1]);
+	if(ttl == -2){
+		resp->push_back("error");
+		return 0;
+	}
+	if(ttl > 0){
+		ttl = (ttl + 999) / 1000;
+	}
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRId64 "", ttl);
+	resp->push_back("ok");
+	resp->push_back(buf);
+	return 0;
+}
+
 static int proc_ping(Server *serv, Link *link, const Request &req, Response *resp){
 	resp->push_back("ok");
 	return 0;
 }
 
+// flush counters: write the buffered counters to db
+static int proc_flush(Server *serv, Link *link, const Request &req, Response *resp){
+	if(req.size() < 2 || req[1] != "counters"){
+		resp->push_back("client_error");
+		return 0;
+	}
+	int ret = 0;
+	if(serv->counters){
+		ret = serv->counters->flush();
+	}
+	if(ret == -1){
+		resp->push_back("error");
+	}else{
+		char buf[20];
+		snprintf(buf, sizeof(buf), "%d", ret);
+		resp->push_back("ok");
+		resp->push_back(buf);
+	}
+	return 0;
+}
+
+// before a read which does not look into the counter buffer, see
+// CounterBuffer::flush(type, name)
+static int flush_counters(Server *serv, char type, const Bytes &name){
+	if(serv->counters == NULL){
+		return 0;
+	}
+	return serv->counters->flush(type, name);
+}
+
 #include "proc_kv.cpp"
 #include "proc_hash.cpp"
 #include "proc_zset.cpp"
+#include "proc_dzset.cpp"
 #include "proc_queue.cpp"
+#include "proc_bitmap.cpp"
+#include "proc_hll.cpp"
+#include "proc_stream.cpp"
@@ -10,10 +10,16 @@
 #include "backend_dump.h"
 #include "backend_sync.h"
 #include "ttl.h"
+#include "counter.h"
+#include "waiter.h"
 
 #define PROC_OK			0
 #define PROC_ERROR		-1
 #define PROC_THREAD     1
+// qpop_block found the queue empty, the link is parked in Server::waiters
+#define PROC_BLOCKED	2
+// a parked link has been answered by a qpush
+#define PROC_WOKEN		3
 #define PROC_BACKEND	100
 
 typedef std::vector<Bytes> Request;
@@ -28,6 +34,8 @@ struct Command{
 	static const int FLAG_WRITE		= (1 << 1);
 	static const int FLAG_BACKEND	= (1 << 2);
 	static const int FLAG_THREAD	= (1 << 3);
+	// a write which does not need buffered counters to be flushed first
+	static const int FLAG_COUNTER	= (1 << 4);
 
 	const char *name;
 	const char *sflags;
@@ -68,8 +76,12 @@ class Server{
 		BackendDump *backend_dump;
 		BackendSync *backend_sync;
 		ExpirationHandler *expiration;
+		// NULL if server.counter_flush_interval is not configured
+		CounterBuffer *counters;
+		// links blocked in qpop_block
+		QueueWaiters *waiters;
 
-		Server(SSDB *ssdb);
+		Server(SSDB *ssdb, const Config &conf);
 		~Server();
 		void proc(ProcJob *job);
 
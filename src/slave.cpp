@@ -3,7 +3,11 @@
 #include "t_kv.h"
 #include "t_hash.h"
 #include "t_zset.h"
+#include "t_dzset.h"
 #include "t_queue.h"
+#include "t_hll.h"
+#include "counter.h"
+#include "ttl.h"
 #include "include.h"
 
 Slave::Slave(SSDB *ssdb, leveldb::DB* meta_db, const char *ip, int port, bool is_mirror){
@@ -291,7 +295,31 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 					break;
 				}
 				log_trace("set %s", hexmem(key.data(), key.size()).c_str());
-				if(ssdb->set(key, req[1], log_type) == -1){
+				// replaces a counter buffered on this server
+				CounterLocking cl(ssdb->counters);
+				if(ssdb->counters){
+					ssdb->counters->drop(log.key());
+				}
+				if(kv_val_has_header(req[1]) && ssdb->kv_ttl_header){
+					// inline ttl
+					int64_t expire = decode_kv_expire(req[1]);
+					if(ssdb->setx(key, decode_kv_val(req[1]), expire, log_type) == -1){
+						return -1;
+					}
+				}else if(kv_val_has_header(req[1])){
+					// this db is not in KV_FORMAT, the value is kept plain,
+					// an inline ttl goes to the expiration list
+					int64_t expire = decode_kv_expire(req[1]);
+					if(ssdb->set(key, decode_kv_val(req[1]), log_type) == -1){
+						return -1;
+					}
+					if(expire > 0 && ssdb->expiration){
+						int64_t ttl = (expire - time_ms() + 999) / 1000;
+						if(ssdb->expiration->set_ttl(key, ttl > 0? ttl : 1) == -1){
+							return -1;
+						}
+					}
+				}else if(ssdb->set(key, req[1], log_type) == -1){
 					return -1;
 				}
 			}
@@ -320,6 +348,10 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 				log_trace("hset %s %s",
 					hexmem(name.data(), name.size()).c_str(),
 					hexmem(key.data(), key.size()).c_str());
+				CounterLocking cl(ssdb->counters);
+				if(ssdb->counters){
+					ssdb->counters->drop(log.key());
+				}
 				if(ssdb->hset(name, key, req[1], log_type) == -1){
 					return -1;
 				}
@@ -351,6 +383,10 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 				log_trace("zset %s %s",
 					hexmem(name.data(), name.size()).c_str(),
 					hexmem(key.data(), key.size()).c_str());
+				CounterLocking cl(ssdb->counters);
+				if(ssdb->counters){
+					ssdb->counters->drop(log.key());
+				}
 				if(ssdb->zset(name, key, req[1], log_type) == -1){
 					return -1;
 				}
@@ -370,6 +406,101 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 				}
 			}
 			break;
+		case BinlogCommand::BSET:
+			{
+				if(req.size() != 2){
+					break;
+				}
+				log_trace("bset %s", hexmem(log.key().data(), log.key().size()).c_str());
+				if(ssdb->bset_chunk(log.key(), req[1], log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::BDEL:
+			{
+				log_trace("bdel %s", hexmem(log.key().data(), log.key().size()).c_str());
+				if(ssdb->bdel_chunk(log.key(), log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::PFSET:
+			{
+				if(req.size() != 2){
+					break;
+				}
+				log_trace("pfset %s", hexmem(log.key().data(), log.key().size()).c_str());
+				if(ssdb->pfset_raw(log.key(), req[1], log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::XSET:
+			{
+				if(req.size() != 2){
+					break;
+				}
+				log_trace("xset %s", hexmem(log.key().data(), log.key().size()).c_str());
+				if(ssdb->xset_raw(log.key(), req[1], log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::XDEL:
+			{
+				log_trace("xdel %s", hexmem(log.key().data(), log.key().size()).c_str());
+				if(ssdb->xdel_raw(log.key(), log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::DZSET:
+			{
+				if(req.size() != 2){
+					break;
+				}
+				std::string name, key;
+				uint64_t score;
+				if(decode_dzset_key(log.key(), &name, &key) == -1
+					|| decode_dzscore_val(req[1], &score) == -1)
+				{
+					break;
+				}
+				log_trace("dzset %s %s",
+					hexmem(name.data(), name.size()).c_str(),
+					hexmem(key.data(), key.size()).c_str());
+				if(ssdb->dzset(name, key, decode_dzscore(score), log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::DZDEL:
+			{
+				std::string name, key;
+				if(decode_dzset_key(log.key(), &name, &key) == -1){
+					break;
+				}
+				log_trace("dzdel %s %s",
+					hexmem(name.data(), name.size()).c_str(),
+					hexmem(key.data(), key.size()).c_str());
+				if(ssdb->dzdel(name, key, log_type) == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::PFDEL:
+			{
+				std::string name;
+				if(decode_hll_key(log.key(), &name) == -1){
+					break;
+				}
+				log_trace("pfdel %s", hexmem(name.data(), name.size()).c_str());
+				if(ssdb->pfclear(name, log_type) == -1){
+					return -1;
+				}
+			}
+			break;
 		case BinlogCommand::QPUSH_BACK:
 		case BinlogCommand::QPUSH_FRONT:
 			{
@@ -387,10 +518,31 @@ int Slave::proc_sync(const Binlog &log, const std::vector<Bytes> &req){
 				int ret;
 				if(log.cmd() == BinlogCommand::QPUSH_BACK){
 					log_trace("qpush_back %s", hexmem(name.data(), name.size()).c_str());
-					ret = ssdb->qpush_back(name, req[1], log_type);
+					ret = ssdb->qpush_seq(name, seq, req[1], QBACK_SEQ, log_type);
 				}else{
 					log_trace("qpush_front %s", hexmem(name.data(), name.size()).c_str());
-					ret = ssdb->qpush_front(name, req[1], log_type);
+					ret = ssdb->qpush_seq(name, seq, req[1], QFRONT_SEQ, log_type);
+				}
+				if(ret == -1){
+					return -1;
+				}
+			}
+			break;
+		case BinlogCommand::QTRIM_BACK:
+		case BinlogCommand::QTRIM_FRONT:
+			{
+				std::string name;
+				uint64_t count;
+				if(decode_qtrim_log(log.key(), &name, &count) == -1){
+					break;
+				}
+				int64_t ret;
+				if(log.cmd() == BinlogCommand::QTRIM_BACK){
+					log_trace("qtrim_back %s %" PRIu64 "", hexmem(name.data(), name.size()).c_str(), count);
+					ret = ssdb->qtrim_back(name, (int64_t)count, log_type);
+				}else{
+					log_trace("qtrim_front %s %" PRIu64 "", hexmem(name.data(), name.size()).c_str(), count);
+					ret = ssdb->qtrim_front(name, (int64_t)count, log_type);
 				}
 				if(ret == -1){
 					return -1;
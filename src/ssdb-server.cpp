@@ -6,6 +6,7 @@
 #include "ssdb.h"
 #include "link.h"
 #include "serv.h"
+#include "compaction.h"
 #include "util/fde.h"
 #include "util/config.h"
 #include "util/daemon.h"
@@ -110,6 +111,10 @@ int proc_result(ProcJob &job, ready_list_t &ready_list){
 		job.cmd->calls += 1;
 		job.cmd->time_wait += job.time_wait;
 		job.cmd->time_proc += job.time_proc;
+		if(ssdb->compaction_scheduler){
+			ssdb->compaction_scheduler->add_request(job.time_wait + job.time_proc,
+				job.serv->writer->size());
+		}
 	}
 	if(job.result == PROC_ERROR){
 		log_info("fd: %d, proc error, delete link", link->fd());
@@ -195,12 +200,52 @@ int proc_client_event(const Fdevent *fde, ready_list_t &ready_list){
 	return 0;
 }
 
+// a parked link(blocked in qpop_block) is only watched for disconnection,
+// requests pipelined after qpop_block are left in its buffer
+int proc_parked_event(const Fdevent *fde, QueueWaiters *waiters){
+	Link *link = (Link *)fde->data.ptr;
+	int len = link->read();
+	if(len > 0){
+		fdes->clr(link->fd(), FDEVENT_IN);
+		return 0;
+	}
+	log_debug("fd: %d, read: %d, delete parked link", link->fd(), len);
+	fdes->del(link->fd());
+	if(waiters->cancel(link) == 1){
+		link_count --;
+		delete link;
+	}else{
+		// taken by a qpush, its PROC_WOKEN result is on the way
+		link->mark_error();
+	}
+	return 0;
+}
+
+// answers parked links whose timeout has passed
+void expire_parked(Server *serv, ready_list_t &ready_list){
+	std::vector<Link *> links;
+	serv->waiters->expire(time_ms(), &links);
+	for(int i=0; i<(int)links.size(); i++){
+		ProcJob job;
+		job.serv = serv;
+		job.link = links[i];
+		Response resp;
+		resp.push_back("not_found");
+		if(job.link->send(resp) == -1){
+			job.result = PROC_ERROR;
+		}
+		if(proc_result(job, ready_list) == PROC_ERROR){
+			link_count --;
+		}
+	}
+}
+
 void run(int argc, char **argv){
 	ready_list_t ready_list;
 	ready_list_t ready_list_2;
 	ready_list_t::iterator it;
 	const Fdevents::events_t *events;
-	Server serv(ssdb);
+	Server serv(ssdb, *conf);
 
 	fdes->set(serv_link->fd(), FDEVENT_IN, 0, serv_link);
 	fdes->set(serv.reader->fd(), FDEVENT_IN, 0, serv.reader);
@@ -217,6 +262,7 @@ void run(int argc, char **argv){
 		
 		ready_list.swap(ready_list_2);
 		ready_list_2.clear();
+		expire_parked(&serv, ready_list);
 		
 		if(!ready_list.empty()){
 			// ready_list not empty, so we should return immediately
@@ -243,9 +289,28 @@ void run(int argc, char **argv){
 					log_fatal("reading result from workers error!");
 					exit(0);
 				}
+				if(job.result == PROC_BLOCKED){
+					serv.waiters->park(job.link);
+					if(job.link->input->empty()){
+						fdes->set(job.link->fd(), FDEVENT_IN, 1, job.link);
+					}
+					continue;
+				}
+				if(job.result == PROC_WOKEN){
+					serv.waiters->resume(job.link);
+					if(job.link->error()){
+						// closed while parked
+						link_count --;
+						delete job.link;
+						continue;
+					}
+					job.result = PROC_OK;
+				}
 				if(proc_result(job, ready_list) == PROC_ERROR){
 					link_count --;
 				}
+			}else if(serv.waiters->parked((Link *)fde->data.ptr)){
+				proc_parked_event(fde, serv.waiters);
 			}else{
 				proc_client_event(fde, ready_list);
 			}
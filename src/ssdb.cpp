@@ -1,18 +1,35 @@
 #include "ssdb.h"
 #include "slave.h"
+#include "meta_cache.h"
+#include "ztop_cache.h"
+#include "compaction.h"
+#include "type_options.h"
+#include "ttl.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "leveldb/cache.h"
 #include "leveldb/filter_policy.h"
+#include <algorithm>
 
 #include "t_kv.h"
 #include "t_hash.h"
 #include "t_zset.h"
+#include "t_queue.h"
 
 SSDB::SSDB(){
 	db = NULL;
 	meta_db = NULL;
 	binlogs = NULL;
+	meta_cache = NULL;
+	ztop_cache = NULL;
+	compaction = NULL;
+	compaction_scheduler = NULL;
+	inline_ttl = false;
+	kv_ttl_header = false;
+	small_hash_fields = 0;
+	small_hash_value = 0;
+	expiration = NULL;
+	counters = NULL;
 }
 
 SSDB::~SSDB(){
@@ -24,6 +41,18 @@ SSDB::~SSDB(){
 	if(binlogs){
 		delete binlogs;
 	}
+	if(meta_cache){
+		delete meta_cache;
+	}
+	if(ztop_cache){
+		delete ztop_cache;
+	}
+	if(compaction){
+		delete compaction;
+	}
+	if(compaction_scheduler){
+		delete compaction_scheduler;
+	}
 	if(db){
 		delete db;
 	}
@@ -33,6 +62,9 @@ SSDB::~SSDB(){
 	if(options.filter_policy){
 		delete options.filter_policy;
 	}
+	if(options.block_policy){
+		delete options.block_policy;
+	}
 	if(meta_db){
 		delete meta_db;
 	}
@@ -46,12 +78,22 @@ SSDB* SSDB::open(const Config &conf, const std::string &base_dir){
 	int write_buffer_size = conf.get_num("leveldb.write_buffer_size");
 	int block_size = conf.get_num("leveldb.block_size");
 	int compaction_speed = conf.get_num("leveldb.compaction_speed");
+	int meta_cache_size = conf.get_num("leveldb.meta_cache_size");
+	int range_compaction_speed = conf.get_num("leveldb.range_compaction_speed");
+	int range_compaction_deletes = conf.get_num("leveldb.range_compaction_deletes");
 	std::string compression = conf.get_str("leveldb.compression");
+	std::string inline_ttl = conf.get_str("leveldb.inline_ttl");
+	int small_hash_fields = conf.get_num("leveldb.small_hash_fields");
+	int small_hash_value = conf.get_num("leveldb.small_hash_value");
 
 	strtolower(&compression);
 	if(compression != "yes"){
 		compression = "no";
 	}
+	strtolower(&inline_ttl);
+	if(inline_ttl != "yes"){
+		inline_ttl = "no";
+	}
 
 	if(cache_size <= 0){
 		cache_size = 8;
@@ -62,6 +104,22 @@ SSDB* SSDB::open(const Config &conf, const std::string &base_dir){
 	if(block_size <= 0){
 		block_size = 4;
 	}
+	if(meta_cache_size <= 0){
+		meta_cache_size = 10000;
+	}
+	if(range_compaction_speed <= 0){
+		range_compaction_speed = compaction_speed;
+	}
+	if(range_compaction_deletes <= 0){
+		range_compaction_deletes = 100000;
+	}
+	if(small_hash_fields < 0){
+		small_hash_fields = 0;
+	}
+	// lengths are packed in one byte
+	if(small_hash_value <= 0 || small_hash_value > 255){
+		small_hash_value = 64;
+	}
 
 	log_info("main_db          : %s", main_db_path.c_str());
 	log_info("meta_db          : %s", meta_db_path.c_str());
@@ -70,11 +128,17 @@ SSDB* SSDB::open(const Config &conf, const std::string &base_dir){
 	log_info("write_buffer     : %d MB", write_buffer_size);
 	log_info("compaction_speed : %d MB/s", compaction_speed);
 	log_info("compression      : %s", compression.c_str());
+	log_info("inline_ttl       : %s", inline_ttl.c_str());
+	log_info("meta_cache_size  : %d", meta_cache_size);
+	log_info("small_hash       : %d fields, %d bytes", small_hash_fields, small_hash_value);
+	log_info("range_compaction : %d MB/s, after %d deletes", range_compaction_speed, range_compaction_deletes);
 
 	SSDB *ssdb = new SSDB();
+	ssdb->inline_ttl = (inline_ttl == "yes");
+	ssdb->small_hash_fields = small_hash_fields;
+	ssdb->small_hash_value = small_hash_value;
 	//
 	ssdb->options.create_if_missing = true;
-	ssdb->options.filter_policy = leveldb::NewBloomFilterPolicy(10);
 	ssdb->options.block_cache = leveldb::NewLRUCache(cache_size * 1048576);
 	ssdb->options.block_size = block_size * 1024;
 	ssdb->options.write_buffer_size = write_buffer_size * 1024 * 1024;
@@ -85,6 +149,58 @@ SSDB* SSDB::open(const Config &conf, const std::string &base_dir){
 		ssdb->options.compression = leveldb::kNoCompression;
 	}
 
+	{ // per data type tuning
+		const Config *types_conf = conf.get("leveldb.types");
+		if(types_conf == NULL){
+			ssdb->options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+		}else{
+			TypeOptions type_opts(10, ssdb->options.block_size, ssdb->options.compression);
+			std::vector<Config *> children = types_conf->children;
+			for(std::vector<Config *>::iterator it = children.begin(); it != children.end(); it++){
+				Config *c = *it;
+				if(c->is_comment()){
+					continue;
+				}
+				int group = TypeOptions::group(c->key);
+				if(group == -1){
+					log_error("unknown data type: %s", c->key.c_str());
+					continue;
+				}
+				if(c->get("bloom_bits") != NULL){
+					type_opts.bloom_bits[group] = c->get_num("bloom_bits");
+				}
+				if(c->get_num("block_size") > 0){
+					type_opts.block_size[group] = c->get_num("block_size") * 1024;
+				}
+				if(c->get("prefix_bloom") != NULL){
+					std::string str = c->get_str("prefix_bloom");
+					strtolower(&str);
+					type_opts.prefix_bloom[group] = (str == "yes");
+				}
+				if(c->get("compression") != NULL){
+					std::string str = c->get_str("compression");
+					strtolower(&str);
+					if(str == "yes"){
+						type_opts.compression[group] = leveldb::kSnappyCompression;
+					}else{
+						type_opts.compression[group] = leveldb::kNoCompression;
+					}
+				}
+			}
+			log_info("data type tuning :");
+			for(int i=0; i<TypeOptions::GROUPS; i++){
+				log_info("  %-7s: bloom_bits: %d%s, block_size: %d KB, compression: %s",
+					TypeOptions::group_name(i),
+					type_opts.bloom_bits[i],
+					type_opts.prefix_bloom[i]? "(prefix)" : "",
+					(int)type_opts.block_size[i] / 1024,
+					type_opts.compression[i] == leveldb::kSnappyCompression? "yes" : "no");
+			}
+			ssdb->options.filter_policy = new TypeFilterPolicy(type_opts);
+			ssdb->options.block_policy = new TypeBlockPolicy(type_opts);
+		}
+	}
+
 	leveldb::Status status;
 	{
 		leveldb::Options options;
@@ -100,7 +216,70 @@ SSDB* SSDB::open(const Config &conf, const std::string &base_dir){
 		log_error("open main_db failed");
 		goto err;
 	}
+	if(ssdb->upgrade_kv_format() == -1){
+		goto err;
+	}
 	ssdb->binlogs = new BinlogQueue(ssdb->db);
+	ssdb->meta_cache = new MetaCache(meta_cache_size);
+	ssdb->binlogs->meta_cache = ssdb->meta_cache;
+
+	{ // top-K cache of leaderboard zsets
+		const Config *zc_conf = conf.get("leveldb.zset_cache");
+		if(zc_conf != NULL){
+			int top = zc_conf->get_num("top");
+			int memory = zc_conf->get_num("memory");
+			if(top <= 0){
+				top = 100;
+			}
+			if(memory <= 0){
+				memory = 64;
+			}
+			ZTopCache *cache = new ZTopCache(top, (int64_t)memory * 1024 * 1024);
+			std::vector<Config *> children = zc_conf->children;
+			for(std::vector<Config *>::iterator it = children.begin(); it != children.end(); it++){
+				Config *c = *it;
+				if(c->key != "name" || c->val.empty()){
+					continue;
+				}
+				cache->add(c->val);
+			}
+			log_info("zset_cache       : %d zsets, top: %d, memory: %d MB", cache->size(), top, memory);
+			ssdb->ztop_cache = cache;
+			ssdb->binlogs->ztop_cache = cache;
+		}
+	}
+	ssdb->compaction = new CompactionHandler(ssdb->db, range_compaction_speed, range_compaction_deletes);
+	ssdb->binlogs->compaction = ssdb->compaction;
+
+	{ // adaptive compaction speed
+		const Config *sched_conf = conf.get("leveldb.compaction_schedule");
+		if(sched_conf != NULL){
+			CompactionScheduler *sched = new CompactionScheduler(ssdb->db, compaction_speed);
+			std::vector<Config *> children = sched_conf->children;
+			for(std::vector<Config *>::iterator it = children.begin(); it != children.end(); it++){
+				Config *c = *it;
+				if(c->key != "window"){
+					continue;
+				}
+				if(sched->add_window(c->val) == -1){
+					log_error("bad compaction window: %s", c->val.c_str());
+				}
+			}
+			if(sched_conf->get_num("min_speed") > 0){
+				sched->min_speed = sched_conf->get_num("min_speed");
+			}
+			sched->max_p99_latency = sched_conf->get_num("max_p99_latency");
+			sched->max_write_queue = sched_conf->get_num("max_write_queue");
+			if(sched_conf->get_num("max_level0_files") > 0){
+				sched->max_level0_files = sched_conf->get_num("max_level0_files");
+			}
+			log_info("compaction_schedule: %d windows, min_speed: %d MB/s, max_p99_latency: %d ms, max_write_queue: %d, max_level0_files: %d",
+				sched->windows_size(), sched->min_speed, sched->max_p99_latency,
+				sched->max_write_queue, sched->max_level0_files);
+			sched->start();
+			ssdb->compaction_scheduler = sched;
+		}
+	}
 
 	{ // slaves
 		const Config *repl_conf = conf.get("replication");
@@ -172,6 +351,61 @@ Iterator* SSDB::rev_iterator(const std::string &start, const std::string &end, u
 	return new Iterator(it, end, limit, Iterator::BACKWARD);
 }
 
+struct BatchKeyLess{
+	const std::vector<std::string> *keys;
+	bool operator()(int a, int b) const{
+		return (*keys)[a] < (*keys)[b];
+	}
+};
+
+int SSDB::batch_get(const std::vector<std::string> &keys,
+		std::vector<std::string> *vals, std::vector<bool> *found) const
+{
+	vals->clear();
+	vals->resize(keys.size());
+	found->clear();
+	found->resize(keys.size(), false);
+	if(keys.empty()){
+		return 0;
+	}
+
+	std::vector<int> order(keys.size());
+	for(int i=0; i<(int)keys.size(); i++){
+		order[i] = i;
+	}
+	BatchKeyLess less;
+	less.keys = &keys;
+	std::sort(order.begin(), order.end(), less);
+
+	leveldb::Iterator *it = db->NewIterator(leveldb::ReadOptions());
+	it->Seek(keys[order[0]]);
+	for(int n=0; n<(int)order.size(); n++){
+		const std::string &key = keys[order[n]];
+		for(int step=0; it->Valid() && it->key().compare(key) < 0; step++){
+			if(step == BATCH_NEXT_STEPS){
+				it->Seek(key);
+				break;
+			}
+			it->Next();
+		}
+		if(!it->Valid()){
+			// the rest keys are all after the last key in db
+			break;
+		}
+		if(it->key() == key){
+			(*found)[order[n]] = true;
+			(*vals)[order[n]].assign(it->value().data(), it->value().size());
+		}
+	}
+	leveldb::Status s = it->status();
+	delete it;
+	if(!s.ok()){
+		log_error("batch_get error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 0;
+}
+
 
 /* raw operates */
 
@@ -195,9 +429,9 @@ int SSDB::raw_del(const Bytes &key) const{
 	return 1;
 }
 
-int SSDB::raw_get(const Bytes &key, std::string *val) const{
+int SSDB::raw_get(const Bytes &key, std::string *val, bool fill_cache) const{
 	leveldb::ReadOptions opts;
-	opts.fill_cache = false;
+	opts.fill_cache = fill_cache;
 	leveldb::Status s = db->Get(opts, key.Slice(), val);
 	if(s.IsNotFound()){
 		return 0;
@@ -228,6 +462,23 @@ std::vector<std::string> SSDB::info() const{
 	keys.push_back("leveldb.stats");
 	//keys.push_back("leveldb.sstables");
 
+	if(meta_cache){
+		info.push_back("meta_cache");
+		info.push_back(meta_cache->stats());
+	}
+	if(ztop_cache){
+		info.push_back("zset_cache");
+		info.push_back(ztop_cache->stats());
+	}
+	if(compaction){
+		info.push_back("range_compaction");
+		info.push_back(compaction->stats());
+	}
+	if(compaction_scheduler){
+		info.push_back("compaction_schedule");
+		info.push_back(compaction_scheduler->stats());
+	}
+
 	for(size_t i=0; i<keys.size(); i++){
 		std::string key = keys[i];
 		std::string val;
@@ -244,6 +495,129 @@ void SSDB::compact() const{
 	db->CompactRange(NULL, NULL);
 }
 
+// the least key greater than all keys with @prefix, empty if there is none
+static std::string prefix_end(const std::string &prefix){
+	std::string ret = prefix;
+	while(!ret.empty() && (uint8_t)ret[ret.size() - 1] == 0xff){
+		ret.erase(ret.size() - 1);
+	}
+	if(!ret.empty()){
+		ret[ret.size() - 1] ++;
+	}
+	return ret;
+}
+
+// hash, zset and queue items are all prefixed by type, len, name
+static std::string container_prefix(char type, const Bytes &name){
+	std::string buf;
+	buf.append(1, type);
+	if(!name.empty()){
+		buf.append(1, (uint8_t)name.size());
+		buf.append(name.data(), name.size());
+	}
+	return buf;
+}
+
+int SSDB::compact(const std::string &type, const Bytes &start, const Bytes &end) const{
+	std::vector<std::string> ranges;
+	if(type == "kv"){
+		ranges.push_back(encode_kv_key(start));
+		if(end.empty()){
+			ranges.push_back(prefix_end(encode_kv_key("")));
+		}else{
+			ranges.push_back(encode_kv_key(end));
+		}
+	}else if(type == "binlog"){
+		ranges.push_back(encode_seq_key(start.Uint64()));
+		if(end.empty()){
+			ranges.push_back(prefix_end(std::string(1, DataType::SYNCLOG)));
+		}else{
+			ranges.push_back(encode_seq_key(end.Uint64()));
+		}
+	}else{
+		std::string types;
+		if(type == "hash"){
+			types.append(1, DataType::HASH);
+			types.append(1, DataType::HPACK);
+		}else if(type == "zset"){
+			types.append(1, DataType::ZSET);
+			types.append(1, DataType::ZSCORE);
+			types.append(1, DataType::DZSET);
+			types.append(1, DataType::DZSCORE);
+		}else if(type == "queue"){
+			types.append(1, DataType::QUEUE);
+		}else if(type == "bitmap"){
+			types.append(1, DataType::BITMAP);
+		}else{
+			return -1;
+		}
+		// items are sorted by name size first, a range of names is not
+		// a range of keys
+		if(!end.empty()){
+			return -2;
+		}
+		for(int i=0; i<(int)types.size(); i++){
+			std::string prefix = container_prefix(types[i], start);
+			ranges.push_back(prefix);
+			ranges.push_back(prefix_end(prefix));
+		}
+	}
+	for(int i=0; i<(int)ranges.size(); i+=2){
+		compaction->compact_range(ranges[i], ranges[i+1]);
+	}
+	return 0;
+}
+
+void SSDB::add_deletes(char type, const Bytes &name, uint64_t count) const{
+	std::string prefix = container_prefix(type, name);
+	compaction->add_deletes(prefix, prefix_end(prefix), count);
+	if(type == DataType::ZSET || type == DataType::DZSET){
+		prefix = container_prefix(type == DataType::ZSET? DataType::ZSCORE : DataType::DZSCORE, name);
+		compaction->add_deletes(prefix, prefix_end(prefix), count);
+	}
+}
+
+int64_t SSDB::container_size(const std::string &size_key) const{
+	int64_t size;
+	if(meta_cache->get(size_key, &size) == 1){
+		return size < 0? 0 : size;
+	}
+
+	std::string val;
+	leveldb::Status s;
+
+	s = db->Get(leveldb::ReadOptions(), size_key, &val);
+	if(s.IsNotFound()){
+		return 0;
+	}else if(!s.ok()){
+		return -1;
+	}else{
+		if(val.size() != sizeof(uint64_t)){
+			return 0;
+		}
+		int64_t ret = *(int64_t *)val.data();
+		return ret < 0? 0 : ret;
+	}
+}
+
+bool SSDB::container_expired(char type, const Bytes &name) const{
+	return expiration != NULL && expiration->container_expired(type, name);
+}
+
+int SSDB::del_container_ttl(char type, const Bytes &name){
+	if(expiration == NULL){
+		return 0;
+	}
+	return expiration->del_container_ttl(type, name);
+}
+
+int SSDB::clear_expired(char type, const Bytes &name){
+	if(expiration == NULL){
+		return 0;
+	}
+	return expiration->clear_expired_container(type, name);
+}
+
 int SSDB::key_range(std::vector<std::string> *keys) const{
 	int ret = 0;
 	std::string kstart, kend;
@@ -16,7 +16,14 @@
 class KIterator;
 class HIterator;
 class ZIterator;
+class DZIterator;
 class Slave;
+class MetaCache;
+class ZTopCache;
+class CompactionHandler;
+class CompactionScheduler;
+class ExpirationHandler;
+class CounterBuffer;
 
 
 class SSDB{
@@ -30,6 +37,28 @@ private:
 	SSDB();
 public:
 	BinlogQueue *binlogs;
+	MetaCache *meta_cache;
+	// NULL if leveldb.zset_cache is not configured
+	ZTopCache *ztop_cache;
+	CompactionHandler *compaction;
+	// NULL if leveldb.compaction_schedule is not configured
+	CompactionScheduler *compaction_scheduler;
+	// leveldb.inline_ttl: setx and ttl keep the expire time in kv values
+	bool inline_ttl;
+	// the db is in KV_FORMAT, kv values may have the ttl header(see t_kv.h),
+	// set once inline_ttl is enabled, and kept after it is disabled
+	bool kv_ttl_header;
+	// leveldb.small_hash_fields: a new hash is kept in one packed value,
+	// until it has more fields, or a key or value longer than
+	// small_hash_value, 0 means never pack
+	int small_hash_fields;
+	int small_hash_value;
+	// if set, told of the expired kv keys found by get(), and checked for
+	// expired containers
+	ExpirationHandler *expiration;
+	// if set, deletes of kv, hash and zset keys drop the buffered counters
+	// of the keys, under the lock of the buffer
+	CounterBuffer *counters;
 	
 	~SSDB();
 	static SSDB* open(const Config &conf, const std::string &base_dir);
@@ -41,6 +70,21 @@ public:
 	//void flushdb();
 	std::vector<std::string> info() const;
 	void compact() const;
+	/**
+	 * Compact keys of one data type only, throttled by range_compaction_speed.
+	 * type: kv|hash|zset|queue|bitmap|binlog
+	 * For kv, [start, end] is a range of keys, for binlog, a range of seqs,
+	 * for others, start is the name of a container, empty for all containers,
+	 * and end must be empty.
+	 * @return -1: unknown type, -2: end given for a container type, 0: ok
+	 */
+	int compact(const std::string &type, const Bytes &start, const Bytes &end) const;
+	// tells that @count items of a hash, zset or queue have been deleted
+	void add_deletes(char type, const Bytes &name, uint64_t count) const;
+	// caller holds a Transaction which deletes the size key of a hash,
+	// zset or queue, its ttl is deleted in it, so a new container of the
+	// same name does not inherit it. type: DataType::HSIZE, ZSIZE or QSIZE
+	int del_container_ttl(char type, const Bytes &name);
 	int key_range(std::vector<std::string> *keys) const;
 
 	/* raw operates */
@@ -48,7 +92,7 @@ public:
 	// repl: whether to sync this operation to slaves
 	int raw_set(const Bytes &key, const Bytes &val) const;
 	int raw_del(const Bytes &key) const;
-	int raw_get(const Bytes &key, std::string *val) const;
+	int raw_get(const Bytes &key, std::string *val, bool fill_cache=false) const;
 
 	/* key value */
 
@@ -60,7 +104,26 @@ public:
 	int multi_del(const std::vector<Bytes> &keys, int offset=0, char log_type=BinlogType::SYNC);
 	
 	int get(const Bytes &key, std::string *val) const;
+	// expire: set to the inline ttl of the key, untouched if it has none
+	int get(const Bytes &key, std::string *val, int64_t *expire) const;
+	// get keys[offset...] in one batch, found keys and their values are
+	// appended to @list in the order of @keys
+	// @return number of keys found, -1: error
+	int multi_get(const std::vector<Bytes> &keys, int offset, std::vector<std::string> *list) const;
 	int getset(const Bytes &key, std::string *val, const Bytes &newval, char log_type=BinlogType::SYNC);
+	// set with an inline ttl, expire: unix time in ms
+	int setx(const Bytes &key, const Bytes &val, int64_t expire, char log_type=BinlogType::SYNC);
+	// set the inline ttl of an existing key
+	// @return 0: not found, 1: ok, -1: error
+	int expire(const Bytes &key, int64_t expire, char log_type=BinlogType::SYNC);
+	// delete those of @keys which are still expired(inline ttl)
+	// @return number of keys deleted, -1: error
+	int del_expired(const std::vector<std::string> &keys, char log_type=BinlogType::SYNC);
+	// scan at most @limit kv keys after @start, append the expired ones
+	// to @keys, the last key scanned is copied into @last
+	// @return number of keys scanned
+	int scan_expired(const Bytes &start, uint64_t limit,
+			std::vector<std::string> *keys, std::string *last) const;
 	// return (start, end]
 	KIterator* scan(const Bytes &start, const Bytes &end, uint64_t limit) const;
 	KIterator* rscan(const Bytes &start, const Bytes &end, uint64_t limit) const;
@@ -70,11 +133,17 @@ public:
 	int hset(const Bytes &name, const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC);
 	int hdel(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC);
 	int hincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val, char log_type=BinlogType::SYNC);
+	// delete all fields, one transaction per chunk
+	// @return number of fields deleted, -1: error
+	int64_t hclear(const Bytes &name, char log_type=BinlogType::SYNC);
 	//int multi_hset(const Bytes &name, const std::vector<Bytes> &kvs, int offset=0, char log_type=BinlogType::SYNC);
 	//int multi_hdel(const Bytes &name, const std::vector<Bytes> &keys, int offset=0, char log_type=BinlogType::SYNC);
 
 	int64_t hsize(const Bytes &name) const;
 	int hget(const Bytes &name, const Bytes &key, std::string *val) const;
+	// same as multi_get
+	int multi_hget(const Bytes &name, const std::vector<Bytes> &keys, int offset,
+			std::vector<std::string> *list) const;
 	int hlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 			std::vector<std::string> *list) const;
 	HIterator* hscan(const Bytes &name, const Bytes &start, const Bytes &end, uint64_t limit) const;
@@ -85,6 +154,18 @@ public:
 	int zset(const Bytes &name, const Bytes &key, const Bytes &score, char log_type=BinlogType::SYNC);
 	int zdel(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC);
 	int zincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val, char log_type=BinlogType::SYNC);
+	// delete all items, one transaction per chunk
+	// @return number of items deleted, -1: error
+	int64_t zclear(const Bytes &name, char log_type=BinlogType::SYNC);
+	/**
+	 * Delete the kv keys which are expired in @list(a zset of
+	 * key => expire time), with their entries in @list, in one batch.
+	 * @return number of keys deleted, -1: error
+	 */
+	int zdel_expired(const Bytes &list, const std::vector<std::string> &keys, int64_t now, char log_type=BinlogType::SYNC);
+	// zdel in the Transaction held by the caller
+	// @return 1: deleted, 0: not found, -1: error
+	int zdel_in_trans(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC);
 	//int multi_zset(const Bytes &name, const std::vector<Bytes> &kvs, int offset=0, char log_type=BinlogType::SYNC);
 	//int multi_zdel(const Bytes &name, const std::vector<Bytes> &keys, int offset=0, char log_type=BinlogType::SYNC);
 	
@@ -93,10 +174,18 @@ public:
 	 * @return -1: error; 0: not found; 1: found
 	 */
 	int zget(const Bytes &name, const Bytes &key, std::string *score) const;
+	// same as multi_get
+	int multi_zget(const Bytes &name, const std::vector<Bytes> &keys, int offset,
+			std::vector<std::string> *list) const;
 	int64_t zrank(const Bytes &name, const Bytes &key) const;
 	int64_t zrrank(const Bytes &name, const Bytes &key) const;
 	ZIterator* zrange(const Bytes &name, uint64_t offset, uint64_t limit);
 	ZIterator* zrrange(const Bytes &name, uint64_t offset, uint64_t limit);
+	// served from ztop_cache if @name is cached and the range is in its
+	// first or last(reverse) items, list: key, score, ...
+	// @return 1: served, 0: not served
+	int zrange_cached(const Bytes &name, uint64_t offset, uint64_t limit, bool reverse,
+			std::vector<std::string> *list) const;
 	/**
 	 * scan by score, but won't return @key if key.score=score_start.
 	 * return (score_start, score_end]
@@ -107,7 +196,61 @@ public:
 			const Bytes &score_start, const Bytes &score_end, uint64_t limit) const;
 	int zlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 			std::vector<std::string> *list) const;
-	
+	/**
+	 * Members with score @score(the lowest score of the zset if empty),
+	 * from @min to @max by their bytes, as in redis zrangebylex: "-", "+",
+	 * "[key" included or "(key" excluded. One seek, then a scan which
+	 * stops at @max. Appended to @list if it is not NULL.
+	 * @return number of members, -2: bad bounds or score
+	 */
+	int64_t zrangebylex(const Bytes &name, const Bytes &min, const Bytes &max, const Bytes &score,
+			uint64_t offset, uint64_t limit, std::vector<std::string> *list) const;
+	/**
+	 * op: union|inter|diff of the zsets names[offset...], merged with one
+	 * cursor per zset, in member order. For union and inter, each score is
+	 * multiplied by the weight of its zset(1 if @weights is empty), and
+	 * the scores of a member are combined by @aggregate: sum|min|max. diff
+	 * keeps the members of the first zset in none of the others.
+	 * Scores saturate at the int64 range. The result replaces @dest and
+	 * its ttl in one transaction, after the arguments are checked, or if
+	 * @dest is empty, is appended to @list(key, score, ...).
+	 * @return number of items in the result, -1: error, -2: bad arguments
+	 */
+	int64_t zsetop(const std::string &op, const Bytes &dest, const std::vector<Bytes> &names, int offset,
+			const std::vector<int64_t> &weights, const std::string &aggregate,
+			std::vector<std::string> *list, char log_type=BinlogType::SYNC);
+
+	/* dzset, a zset of double scores(see t_dzset.h), without ttl */
+
+	// @return -1: error, 0: item updated, 1: new item inserted
+	int dzset(const Bytes &name, const Bytes &key, double score, char log_type=BinlogType::SYNC);
+	int dzdel(const Bytes &name, const Bytes &key, char log_type=BinlogType::SYNC);
+	// @return same as dzset, -2: the new score is not a number
+	int dzincr(const Bytes &name, const Bytes &key, double by, double *new_val, char log_type=BinlogType::SYNC);
+	// @return number of items deleted, -1: error
+	int64_t dzclear(const Bytes &name, char log_type=BinlogType::SYNC);
+	int64_t dzsize(const Bytes &name) const;
+	// @return -1: error; 0: not found; 1: found
+	int dzget(const Bytes &name, const Bytes &key, double *score) const;
+	int64_t dzrank(const Bytes &name, const Bytes &key) const;
+	int64_t dzrrank(const Bytes &name, const Bytes &key) const;
+	DZIterator* dzrange(const Bytes &name, uint64_t offset, uint64_t limit);
+	DZIterator* dzrrange(const Bytes &name, uint64_t offset, uint64_t limit);
+	/**
+	 * Scan by score from @start to @end, a bound is excluded if it is
+	 * open. If @key is not empty, the scan starts after it, at @start.
+	 * dzrscan scans from the higher score @start down to @end.
+	 */
+	DZIterator* dzscan(const Bytes &name, const Bytes &key, double start, bool start_open,
+			double end, bool end_open, uint64_t limit) const;
+	DZIterator* dzrscan(const Bytes &name, const Bytes &key, double start, bool start_open,
+			double end, bool end_open, uint64_t limit) const;
+	// zrangebylex on a dzset, -2: bad bounds or score
+	int64_t dzrangebylex(const Bytes &name, const Bytes &min, const Bytes &max, const Bytes &score,
+			uint64_t offset, uint64_t limit, std::vector<std::string> *list) const;
+	int dzlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
+			std::vector<std::string> *list) const;
+
 	int64_t qsize(const Bytes &name);
 	// @return 0: empty queue, 1: item peeked, -1: error
 	int qfront(const Bytes &name, std::string *item);
@@ -119,16 +262,136 @@ public:
 	// @return 0: empty queue, 1: item popped, -1: error
 	int qpop_front(const Bytes &name, std::string *item, char log_type=BinlogType::SYNC);
 	int qpop_back(const Bytes &name, std::string *item, char log_type=BinlogType::SYNC);
+	// push items[offset...] in one transaction
+	// @return the size of the queue after pushed, -1: error
+	int64_t qpush_front(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type=BinlogType::SYNC);
+	int64_t qpush_back(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type=BinlogType::SYNC);
+	// pop at most @limit(capped to QPOP_MAX) items in one transaction
+	// @return number of items popped, -1: error
+	int64_t qpop_front(const Bytes &name, int64_t limit, std::vector<std::string> *items, char log_type=BinlogType::SYNC);
+	int64_t qpop_back(const Bytes &name, int64_t limit, std::vector<std::string> *items, char log_type=BinlogType::SYNC);
+	// push @item at @seq if it is next to the front or back, used by slaves,
+	// so stream ids(queue seqs) are the same as the master's
+	int qpush_seq(const Bytes &name, uint64_t seq, const Bytes &item, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
+	// delete @count items from the front or back without reading them
+	// @return number of items deleted, -1: error
+	int64_t qtrim_front(const Bytes &name, int64_t count, char log_type=BinlogType::SYNC);
+	int64_t qtrim_back(const Bytes &name, int64_t count, char log_type=BinlogType::SYNC);
+	// delete all items, one transaction per chunk
+	// @return number of items deleted, -1: error
+	int64_t qclear(const Bytes &name, char log_type=BinlogType::SYNC);
 	int qfix(const Bytes &name);
 	int qlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 			std::vector<std::string> *list);
-	int qslice(const Bytes &name, int64_t offset, int64_t limit,
+	// items from index begin to end, both inclusive, negative counts from the back
+	int qslice(const Bytes &name, int64_t begin, int64_t end,
+			std::vector<std::string> *list);
+	// at most @limit items from index @offset toward the back, or if
+	// @reverse, from the @offset'th item from the back toward the front
+	int qrange(const Bytes &name, int64_t offset, int64_t limit, bool reverse,
 			std::vector<std::string> *list);
 	int qget(const Bytes &name, int64_t index, std::string *item);
 
+	/* bitmap */
+
+	// @return the old bit, -1: error
+	int setbit(const Bytes &name, int64_t offset, int on, char log_type=BinlogType::SYNC);
+	// @return 0 or 1, -1: error
+	int getbit(const Bytes &name, int64_t offset) const;
+	// in bytes, up to the last non-zero byte
+	int64_t bitlen(const Bytes &name) const;
+	// number of set bits in bytes [start, end], negative means from the end
+	int64_t bitcount(const Bytes &name, int64_t start, int64_t end) const;
+	/**
+	 * op: and|or|xor|not(of one bitmap) of names[offset...], the sources
+	 * are read chunk by chunk, the result replaces @dest in one transaction
+	 * @return bitlen of the longest source, -1: error, -2: bad arguments
+	 */
+	int64_t bitop(const std::string &op, const Bytes &dest, const std::vector<Bytes> &names,
+			int offset, char log_type=BinlogType::SYNC);
+	// delete all chunks, CLEAR_CHUNK chunks per transaction
+	// @return number of chunks deleted, -1: error
+	int64_t bclear(const Bytes &name, char log_type=BinlogType::SYNC);
+	// key: an encoded chunk key, used by slaves
+	int bset_chunk(const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC);
+	int bdel_chunk(const Bytes &key, char log_type=BinlogType::SYNC);
+
+	/* hyperloglog */
+
+	// add items[offset...]
+	// @return 1: changed or created, 0: not changed, -1: error
+	int pfadd(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type=BinlogType::SYNC);
+	// estimated cardinality of the union of names[offset...]
+	int64_t pfcount(const std::vector<Bytes> &names, int offset) const;
+	// union of @dest and names[offset...] into @dest
+	int pfmerge(const Bytes &dest, const std::vector<Bytes> &names, int offset, char log_type=BinlogType::SYNC);
+	int pfclear(const Bytes &name, char log_type=BinlogType::SYNC);
+	// key: an encoded hyperloglog key, used by slaves
+	int pfset_raw(const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC);
+
+	/* stream */
+
+	// append items[offset...], @first_id is set to the id of the first one
+	// @return the length of the stream, -1: error
+	int64_t xadd(const Bytes &name, const std::vector<Bytes> &items, int offset, uint64_t *first_id, char log_type=BinlogType::SYNC);
+	// @return 1: found, 0: not found, -1: error
+	int xget(const Bytes &name, uint64_t id, std::string *item) const;
+	// at most @limit items after the offset of @group, they are pending
+	// until acked, list: id, item, ...
+	// @return number of items read, -1: error
+	int xread(const Bytes &name, const Bytes &group, int64_t limit, std::vector<std::string> *list, char log_type=BinlogType::SYNC);
+	// @return number of pending items acked, -1: error
+	int64_t xack(const Bytes &name, const Bytes &group, const std::vector<Bytes> &ids, int offset, char log_type=BinlogType::SYNC);
+	// list: id, delivery time in ms, ...
+	int xpending(const Bytes &name, const Bytes &group, int64_t limit, std::vector<std::string> *list) const;
+	// the group reads items after @id next, 0 reads from the oldest
+	int xgroup_setid(const Bytes &name, const Bytes &group, uint64_t id, char log_type=BinlogType::SYNC);
+	// delete the offset and pending items of a group
+	// @return number of pending items deleted, -1: error
+	int64_t xgroup_del(const Bytes &name, const Bytes &group, char log_type=BinlogType::SYNC);
+	// key: an encoded group offset or pending key, used by slaves
+	int xset_raw(const Bytes &key, const Bytes &val, char log_type=BinlogType::SYNC);
+	int xdel_raw(const Bytes &key, char log_type=BinlogType::SYNC);
+
 private:
-	int _qpush(const Bytes &name, const Bytes &item, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
-	int _qpop(const Bytes &name, std::string *item, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
+	// items deleted in one transaction by hclear, zclear and qclear
+	static const int CLEAR_CHUNK = 1000;
+	// items deleted in one transaction by qtrim, blind deletes are cheap
+	static const int TRIM_CHUNK = 10000;
+	// items popped by one qpop at most, they are all read into memory
+	static const int QPOP_MAX = 1000;
+
+	// tries Next() this many times before a Seek() in batch_get
+	static const int BATCH_NEXT_STEPS = 8;
+
+	// with inline_ttl, escapes kv values of a db written before the inline
+	// ttl header, once, the format is recorded in meta_db(see t_kv.h)
+	int upgrade_kv_format();
+
+	/**
+	 * Look up encoded db keys with one iterator(one consistent view of
+	 * the db). Keys are visited in sorted order, so a key which is near
+	 * the previous one is reached by a few Next() instead of a new Seek().
+	 * found[i] and vals[i] are set for keys[i].
+	 * @return -1: error, 0: ok
+	 */
+	int batch_get(const std::vector<std::string> &keys,
+			std::vector<std::string> *vals, std::vector<bool> *found) const;
+	// size of a hash, zset or queue, without checking its ttl
+	int64_t container_size(const std::string &size_key) const;
+	// type: DataType::HSIZE, ZSIZE or QSIZE
+	bool container_expired(char type, const Bytes &name) const;
+	// delete an expired container before writing to it
+	// @return -1: error, 0: not expired, 1: deleted
+	int clear_expired(char type, const Bytes &name);
+
+	// @first_seq: if not NULL, set to the seq of items[offset]
+	int64_t _qpush(const Bytes &name, const std::vector<Bytes> &items, int offset, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC, uint64_t *first_seq=NULL);
+	int64_t _qpop(const Bytes &name, int64_t limit, std::vector<std::string> *items, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
+	int64_t _qtrim(const Bytes &name, int64_t count, uint64_t front_or_back_seq, char log_type=BinlogType::SYNC);
+	// delete the offsets and pending items of all groups of a stream,
+	// called by qclear, @return number of keys deleted, -1: error
+	int64_t xclear_groups(const Bytes &name, char log_type=BinlogType::SYNC);
 };
 
 
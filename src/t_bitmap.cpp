@@ -0,0 +1,434 @@
+#include "t_bitmap.h"
+#include "ssdb.h"
+
+/* word-at-a-time kernels, chunks are not aligned, words are memcpy'ed */
+
+static int64_t popcount(const char *p, int len){
+	int64_t n = 0;
+	int i = 0;
+	for(; i + 8 <= len; i += 8){
+		uint64_t w;
+		memcpy(&w, p + i, 8);
+		n += __builtin_popcountll(w);
+	}
+	for(; i < len; i++){
+		n += __builtin_popcount((uint8_t)p[i]);
+	}
+	return n;
+}
+
+// dst = dst op src, op: 'a'(and), 'o'(or), 'x'(xor), 'n'(not, src unused)
+static void bitop_words(char op, char *dst, const char *src, int len){
+	int i = 0;
+	for(; i + 8 <= len; i += 8){
+		uint64_t d, s = 0;
+		memcpy(&d, dst + i, 8);
+		if(op != 'n'){
+			memcpy(&s, src + i, 8);
+		}
+		switch(op){
+			case 'a': d &= s; break;
+			case 'o': d |= s; break;
+			case 'x': d ^= s; break;
+			default: d = ~d; break;
+		}
+		memcpy(dst + i, &d, 8);
+	}
+	for(; i < len; i++){
+		switch(op){
+			case 'a': dst[i] &= src[i]; break;
+			case 'o': dst[i] |= src[i]; break;
+			case 'x': dst[i] ^= src[i]; break;
+			default: dst[i] = ~dst[i]; break;
+		}
+	}
+}
+
+static void trim_chunk(std::string *chunk){
+	int len = (int)chunk->size();
+	while(len > 0 && (*chunk)[len - 1] == '\0'){
+		len --;
+	}
+	chunk->resize(len);
+}
+
+// chunks [first, last] of a bitmap
+static Iterator* chunk_iterator(const SSDB *ssdb, const Bytes &name, uint64_t first, uint64_t last){
+	std::string start;
+	if(first == 0){
+		start = encode_bitmap_key(name, 0);
+		start.resize(start.size() - sizeof(uint64_t));
+	}else{
+		// after chunk first-1, before chunk first
+		start = encode_bitmap_key(name, first - 1);
+		start.append(1, (char)0xff);
+	}
+	return ssdb->iterator(start, encode_bitmap_key(name, last), -1);
+}
+
+/**
+ * The chunks of a bitmap in order of their indexes, read one at a time,
+ * chunk is valid until the cursor moves. The iterator reads the db as of
+ * its creation.
+ */
+class BitmapCursor{
+	private:
+		Iterator *it;
+		std::string name;
+	public:
+		bool valid;
+		uint64_t index;
+		Bytes chunk;
+
+		BitmapCursor(const SSDB *ssdb, const Bytes &name){
+			this->it = chunk_iterator(ssdb, name, 0, (uint64_t)-1);
+			this->name.assign(name.data(), name.size());
+			this->next();
+		}
+
+		~BitmapCursor(){
+			delete it;
+		}
+
+		void next(){
+			valid = false;
+			if(!it->next()){
+				return;
+			}
+			std::string n;
+			if(decode_bitmap_key(it->key(), &n, &index) == -1 || n != name){
+				return;
+			}
+			chunk = it->val();
+			valid = true;
+		}
+};
+
+static int check_offset(const Bytes &name, int64_t offset){
+	if(name.empty() || name.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty name or name too long!");
+		return -1;
+	}
+	if(offset < 0 || offset > BITMAP_MAX_OFFSET){
+		log_error("bad bit offset: %" PRId64 "", offset);
+		return -1;
+	}
+	return 0;
+}
+
+int SSDB::setbit(const Bytes &name, int64_t offset, int on, char log_type){
+	if(check_offset(name, offset) == -1){
+		return -1;
+	}
+	uint64_t index = offset / (BITMAP_CHUNK_SIZE * 8);
+	int byte = (int)((offset / 8) % BITMAP_CHUNK_SIZE);
+	// bit 0 is the highest bit of byte 0, as redis
+	uint8_t mask = 0x80 >> (offset % 8);
+
+	Transaction trans(binlogs);
+
+	std::string key = encode_bitmap_key(name, index);
+	std::string chunk;
+	if(this->raw_get(key, &chunk, true) == -1){
+		return -1;
+	}
+	int old = ((int)chunk.size() > byte && (chunk[byte] & mask))? 1 : 0;
+	if(old == (on? 1 : 0)){
+		return old;
+	}
+	if((int)chunk.size() <= byte){
+		chunk.resize(byte + 1, '\0');
+	}
+	if(on){
+		chunk[byte] |= mask;
+	}else{
+		chunk[byte] &= ~mask;
+	}
+	trim_chunk(&chunk);
+	if(chunk.empty()){
+		binlogs->Delete(key);
+		binlogs->add_log(log_type, BinlogCommand::BDEL, key);
+	}else{
+		binlogs->Put(key, chunk);
+		binlogs->add_log(log_type, BinlogCommand::BSET, key);
+	}
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("setbit error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return old;
+}
+
+int SSDB::getbit(const Bytes &name, int64_t offset) const{
+	if(check_offset(name, offset) == -1){
+		return -1;
+	}
+	uint64_t index = offset / (BITMAP_CHUNK_SIZE * 8);
+	int byte = (int)((offset / 8) % BITMAP_CHUNK_SIZE);
+	uint8_t mask = 0x80 >> (offset % 8);
+
+	std::string chunk;
+	if(this->raw_get(encode_bitmap_key(name, index), &chunk, true) == -1){
+		return -1;
+	}
+	return ((int)chunk.size() > byte && (chunk[byte] & mask))? 1 : 0;
+}
+
+int64_t SSDB::bitlen(const Bytes &name) const{
+	std::string start = encode_bitmap_key(name, (uint64_t)-1);
+	std::string end = encode_bitmap_key(name, 0);
+	int64_t len = 0;
+	Iterator *it = this->rev_iterator(start, end, 1);
+	if(it->next()){
+		std::string n;
+		uint64_t index;
+		if(decode_bitmap_key(it->key(), &n, &index) == 0 && n == name){
+			len = (int64_t)index * BITMAP_CHUNK_SIZE + it->val().size();
+		}
+	}
+	delete it;
+	return len;
+}
+
+int64_t SSDB::bitcount(const Bytes &name, int64_t start, int64_t end) const{
+	int64_t len = this->bitlen(name);
+	if(len == -1){
+		return -1;
+	}
+	if(start < 0){
+		start += len;
+	}
+	if(end < 0){
+		end += len;
+	}
+	if(start < 0){
+		start = 0;
+	}
+	if(end >= len){
+		end = len - 1;
+	}
+	if(start > end){
+		return 0;
+	}
+
+	int64_t count = 0;
+	Iterator *it = chunk_iterator(this, name, start / BITMAP_CHUNK_SIZE, end / BITMAP_CHUNK_SIZE);
+	while(it->next()){
+		std::string n;
+		uint64_t index;
+		if(decode_bitmap_key(it->key(), &n, &index) == -1 || n != name){
+			break;
+		}
+		// bytes [s, e) of this chunk are in range
+		Bytes chunk = it->val();
+		int64_t base = (int64_t)index * BITMAP_CHUNK_SIZE;
+		int64_t s = start > base? start - base : 0;
+		int64_t e = end + 1 - base;
+		if(e > chunk.size()){
+			e = chunk.size();
+		}
+		if(s < e){
+			count += popcount(chunk.data() + s, (int)(e - s));
+		}
+	}
+	delete it;
+	return count;
+}
+
+// puts a result chunk of bitop into the transaction, unless it is zeros
+static void bitop_put(BinlogQueue *binlogs, const Bytes &dest, uint64_t index, std::string *chunk, char log_type){
+	trim_chunk(chunk);
+	if(chunk->empty()){
+		return;
+	}
+	std::string key = encode_bitmap_key(dest, index);
+	binlogs->Put(key, *chunk);
+	binlogs->add_log(log_type, BinlogCommand::BSET, key);
+}
+
+int64_t SSDB::bitop(const std::string &op, const Bytes &dest, const std::vector<Bytes> &names, int offset, char log_type){
+	char o;
+	if(op == "and"){
+		o = 'a';
+	}else if(op == "or"){
+		o = 'o';
+	}else if(op == "xor"){
+		o = 'x';
+	}else if(op == "not"){
+		o = 'n';
+	}else{
+		return -2;
+	}
+	int num = (int)names.size() - offset;
+	if(num < 1 || (o == 'n' && num != 1)){
+		return -2;
+	}
+	if(dest.empty() || dest.size() > SSDB_KEY_LEN_MAX){
+		return -2;
+	}
+
+	// dest is rebuilt in one transaction: its chunks are deleted, then the
+	// result is put chunk by chunk while the sources are read, dest may be
+	// one of them
+	Transaction trans(binlogs);
+
+	int ret = 0;
+	int64_t maxlen = 0;
+	std::vector<BitmapCursor *> cursors;
+	for(int i=offset; i<(int)names.size(); i++){
+		int64_t len = this->bitlen(names[i]);
+		if(len == -1){
+			ret = -1;
+		}
+		if(len > maxlen){
+			maxlen = len;
+		}
+		cursors.push_back(new BitmapCursor(this, names[i]));
+	}
+
+	int64_t deleted = 0;
+	if(ret == 0){
+		BitmapCursor old(this, dest);
+		for(; old.valid; old.next()){
+			std::string key = encode_bitmap_key(dest, old.index);
+			binlogs->Delete(key);
+			binlogs->add_log(log_type, BinlogCommand::BDEL, key);
+			deleted ++;
+		}
+	}
+
+	std::string r;
+	if(ret == 0 && o == 'n'){
+		// chunks not stored are zeros, they become ones
+		BitmapCursor *c = cursors[0];
+		for(uint64_t index=0; (int64_t)index * BITMAP_CHUNK_SIZE < maxlen; index++){
+			r.clear();
+			if(c->valid && c->index == index){
+				r.assign(c->chunk.data(), c->chunk.size());
+				c->next();
+			}
+			int64_t size = maxlen - (int64_t)index * BITMAP_CHUNK_SIZE;
+			r.resize(size < BITMAP_CHUNK_SIZE? size : BITMAP_CHUNK_SIZE, '\0');
+			bitop_words(o, &r[0], NULL, (int)r.size());
+			bitop_put(binlogs, dest, index, &r, log_type);
+		}
+	}else if(ret == 0){
+		while(1){
+			// the lowest chunk index of all sources
+			bool found = false;
+			uint64_t index = 0;
+			for(int i=0; i<(int)cursors.size(); i++){
+				BitmapCursor *c = cursors[i];
+				if(c->valid && (!found || c->index < index)){
+					index = c->index;
+					found = true;
+				}
+			}
+			if(!found){
+				break;
+			}
+			// and: a chunk missing in any source is zeros
+			bool zeros = false;
+			bool first = true;
+			for(int i=0; i<(int)cursors.size(); i++){
+				BitmapCursor *c = cursors[i];
+				if(!c->valid || c->index != index){
+					zeros = zeros || o == 'a';
+					continue;
+				}
+				const Bytes &chunk = c->chunk;
+				if(first){
+					r.assign(chunk.data(), chunk.size());
+					first = false;
+				}else if(o == 'a'){
+					if(r.size() > (size_t)chunk.size()){
+						r.resize(chunk.size());
+					}
+					bitop_words(o, &r[0], chunk.data(), (int)r.size());
+				}else{
+					if(r.size() < (size_t)chunk.size()){
+						r.resize(chunk.size(), '\0');
+					}
+					bitop_words(o, &r[0], chunk.data(), chunk.size());
+				}
+				c->next();
+			}
+			if(!zeros){
+				bitop_put(binlogs, dest, index, &r, log_type);
+			}
+		}
+	}
+	for(int i=0; i<(int)cursors.size(); i++){
+		delete cursors[i];
+	}
+	if(ret == -1){
+		return -1;
+	}
+
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("bitop error: %s", s.ToString().c_str());
+		return -1;
+	}
+	this->add_deletes(DataType::BITMAP, dest, deleted);
+	return maxlen;
+}
+
+int64_t SSDB::bclear(const Bytes &name, char log_type){
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
+
+		int num = 0;
+		Iterator *it = chunk_iterator(this, name, 0, (uint64_t)-1);
+		while(num < CLEAR_CHUNK && it->next()){
+			std::string n;
+			uint64_t index;
+			if(decode_bitmap_key(it->key(), &n, &index) == -1 || n != name){
+				break;
+			}
+			std::string key = it->key().String();
+			binlogs->Delete(key);
+			binlogs->add_log(log_type, BinlogCommand::BDEL, key);
+			num ++;
+		}
+		delete it;
+
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("bclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
+		}
+	}
+	this->add_deletes(DataType::BITMAP, name, total);
+	return total;
+}
+
+int SSDB::bset_chunk(const Bytes &key, const Bytes &val, char log_type){
+	Transaction trans(binlogs);
+	binlogs->Put(key.Slice(), val.Slice());
+	binlogs->add_log(log_type, BinlogCommand::BSET, key.Slice());
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("bset_chunk error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::bdel_chunk(const Bytes &key, char log_type){
+	Transaction trans(binlogs);
+	binlogs->Delete(key.Slice());
+	binlogs->add_log(log_type, BinlogCommand::BDEL, key.Slice());
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("bdel_chunk error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef SSDB_BITMAP_H_
+#define SSDB_BITMAP_H_
+
+#include "ssdb.h"
+
+// A bitmap is stored in chunks of BITMAP_CHUNK_SIZE bytes, trailing zero
+// bytes of a chunk are not stored, and a chunk of all zeros is deleted.
+const int BITMAP_CHUNK_SIZE = 1024;
+const int64_t BITMAP_MAX_OFFSET = (int64_t)4 * 1024 * 1024 * 1024 - 1;
+
+inline static
+std::string encode_bitmap_key(const Bytes &name, uint64_t chunk){
+	std::string buf;
+	buf.append(1, DataType::BITMAP);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	chunk = big_endian(chunk);
+	buf.append((char *)&chunk, sizeof(uint64_t));
+	return buf;
+}
+
+inline static
+int decode_bitmap_key(const Bytes &slice, std::string *name, uint64_t *chunk){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(name) == -1){
+		return -1;
+	}
+	if(decoder.read_uint64(chunk) == -1){
+		return -1;
+	}
+	*chunk = big_endian(*chunk);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include <limits.h>
+#include "t_dzset.h"
+#include "leveldb/write_batch.h"
+#include "meta_cache.h"
+
+static int dzset_one(SSDB *ssdb, const Bytes &name, const Bytes &key, double score, char log_type);
+static int dzdel_one(SSDB *ssdb, const Bytes &name, const Bytes &key, char log_type);
+static int incr_dzsize(SSDB *ssdb, const Bytes &name, int64_t incr);
+static int dzget_raw(const SSDB *ssdb, const Bytes &name, const Bytes &key, uint64_t *score);
+
+int SSDB::dzset(const Bytes &name, const Bytes &key, double score, char log_type){
+	Transaction trans(binlogs);
+
+	int ret = dzset_one(this, name, key, score, log_type);
+	if(ret >= 0){
+		if(ret > 0){
+			if(incr_dzsize(this, name, ret) == -1){
+				return -1;
+			}
+		}
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("dzset error: %s", s.ToString().c_str());
+			return -1;
+		}
+	}
+	return ret;
+}
+
+int SSDB::dzdel(const Bytes &name, const Bytes &key, char log_type){
+	Transaction trans(binlogs);
+
+	int ret = dzdel_one(this, name, key, log_type);
+	if(ret >= 0){
+		if(ret > 0){
+			if(incr_dzsize(this, name, -ret) == -1){
+				return -1;
+			}
+		}
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("dzdel error: %s", s.ToString().c_str());
+			return -1;
+		}
+	}
+	return ret;
+}
+
+int SSDB::dzincr(const Bytes &name, const Bytes &key, double by, double *new_val, char log_type){
+	Transaction trans(binlogs);
+
+	uint64_t old;
+	int ret = dzget_raw(this, name, key, &old);
+	if(ret == -1){
+		return -1;
+	}else if(ret == 0){
+		*new_val = by;
+	}else{
+		*new_val = decode_dzscore(old) + by;
+	}
+	// inf + -inf
+	if(isnan(*new_val)){
+		return -2;
+	}
+
+	ret = dzset_one(this, name, key, *new_val, log_type);
+	if(ret >= 0){
+		if(ret > 0){
+			if(incr_dzsize(this, name, ret) == -1){
+				return -1;
+			}
+		}
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("dzincr error: %s", s.ToString().c_str());
+			return -1;
+		}
+	}
+	return ret;
+}
+
+int64_t SSDB::dzclear(const Bytes &name, char log_type){
+	std::string size_key = encode_dzsize_key(name);
+	std::string start = encode_dzset_key(name, "");
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
+
+		int num = 0;
+		Iterator *it = this->iterator(start, "", CLEAR_CHUNK);
+		while(it->next()){
+			Bytes ks = it->key();
+			if(ks.data()[0] != DataType::DZSET){
+				break;
+			}
+			std::string n, key;
+			if(decode_dzset_key(ks, &n, &key) == -1){
+				continue;
+			}
+			if(n != name){
+				break;
+			}
+			uint64_t score;
+			if(decode_dzscore_val(it->val(), &score) == 0){
+				binlogs->Delete(encode_dzscore_key(name, key, score));
+			}
+			binlogs->Delete(ks.Slice());
+			binlogs->add_log(log_type, BinlogCommand::DZDEL, ks.Slice());
+			num ++;
+		}
+		delete it;
+
+		int64_t size = this->container_size(size_key);
+		if(size == -1){
+			return -1;
+		}
+		size -= num;
+		if(num < CLEAR_CHUNK || size <= 0){
+			// the last chunk
+			size = 0;
+			binlogs->Delete(size_key);
+		}else{
+			binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
+		}
+		meta_cache->set(size_key, size);
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("dzclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
+		}
+	}
+	this->add_deletes(DataType::DZSET, name, total);
+	return total;
+}
+
+int64_t SSDB::dzsize(const Bytes &name) const{
+	return this->container_size(encode_dzsize_key(name));
+}
+
+int SSDB::dzget(const Bytes &name, const Bytes &key, double *score) const{
+	uint64_t u;
+	int ret = dzget_raw(this, name, key, &u);
+	if(ret == 1){
+		*score = decode_dzscore(u);
+	}
+	return ret;
+}
+
+/**
+ * Both bounds are encoded scores and included, so a score key at a bound
+ * is at or after encode_dzscore_key(name, "", bound) as its key is not
+ * empty, and before encode_dzscore_key(name, "", bound + 1).
+ */
+static DZIterator* dziterator(
+	const SSDB *ssdb,
+	const Bytes &name, const Bytes &key_start,
+	uint64_t start, uint64_t end,
+	uint64_t limit, Iterator::Direction direction)
+{
+	if(direction == Iterator::FORWARD){
+		if(start > end){
+			return new DZIterator(ssdb->iterator("", "", 0), name);
+		}
+		std::string s = encode_dzscore_key(name, key_start, start);
+		std::string e = encode_dzscore_key(name, "", end + 1);
+		return new DZIterator(ssdb->iterator(s, e, limit), name);
+	}else{
+		if(start < end){
+			return new DZIterator(ssdb->iterator("", "", 0), name);
+		}
+		std::string s;
+		if(key_start.empty()){
+			s = encode_dzscore_key(name, "", start + 1);
+		}else{
+			s = encode_dzscore_key(name, key_start, start);
+		}
+		std::string e = encode_dzscore_key(name, "", end);
+		return new DZIterator(ssdb->rev_iterator(s, e, limit), name);
+	}
+}
+
+// bounds of a scan in encoded scores, an open bound moves to the next
+// encoded value inward
+static void dzscan_bounds(double start, bool start_open, double end, bool end_open,
+		Iterator::Direction direction, uint64_t *s, uint64_t *e)
+{
+	*s = encode_dzscore(start);
+	*e = encode_dzscore(end);
+	if(direction == Iterator::FORWARD){
+		*s += start_open;
+		*e -= end_open;
+	}else{
+		*s -= start_open;
+		*e += end_open;
+	}
+}
+
+int64_t SSDB::dzrank(const Bytes &name, const Bytes &key) const{
+	DZIterator *it = dziterator(this, name, "", 0, UINT64_MAX - 1, INT_MAX, Iterator::FORWARD);
+	int64_t ret = 0;
+	while(true){
+		if(it->next() == false){
+			ret = -1;
+			break;
+		}
+		if(key == it->key){
+			break;
+		}
+		ret ++;
+	}
+	delete it;
+	return ret;
+}
+
+int64_t SSDB::dzrrank(const Bytes &name, const Bytes &key) const{
+	DZIterator *it = dziterator(this, name, "", UINT64_MAX - 1, 0, INT_MAX, Iterator::BACKWARD);
+	int64_t ret = 0;
+	while(true){
+		if(it->next() == false){
+			ret = -1;
+			break;
+		}
+		if(key == it->key){
+			break;
+		}
+		ret ++;
+	}
+	delete it;
+	return ret;
+}
+
+DZIterator* SSDB::dzrange(const Bytes &name, uint64_t offset, uint64_t limit){
+	if(offset + limit > limit){
+		limit = offset + limit;
+	}
+	DZIterator *it = dziterator(this, name, "", 0, UINT64_MAX - 1, limit, Iterator::FORWARD);
+	it->skip(offset);
+	return it;
+}
+
+DZIterator* SSDB::dzrrange(const Bytes &name, uint64_t offset, uint64_t limit){
+	if(offset + limit > limit){
+		limit = offset + limit;
+	}
+	DZIterator *it = dziterator(this, name, "", UINT64_MAX - 1, 0, limit, Iterator::BACKWARD);
+	it->skip(offset);
+	return it;
+}
+
+DZIterator* SSDB::dzscan(const Bytes &name, const Bytes &key, double start, bool start_open,
+		double end, bool end_open, uint64_t limit) const
+{
+	uint64_t s, e;
+	dzscan_bounds(start, start_open && key.empty(), end, end_open, Iterator::FORWARD, &s, &e);
+	return dziterator(this, name, key, s, e, limit, Iterator::FORWARD);
+}
+
+DZIterator* SSDB::dzrscan(const Bytes &name, const Bytes &key, double start, bool start_open,
+		double end, bool end_open, uint64_t limit) const
+{
+	uint64_t s, e;
+	dzscan_bounds(start, start_open && key.empty(), end, end_open, Iterator::BACKWARD, &s, &e);
+	return dziterator(this, name, key, s, e, limit, Iterator::BACKWARD);
+}
+
+int SSDB::dzlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
+		std::vector<std::string> *list) const{
+	std::string start;
+	std::string end;
+	start = encode_dzsize_key(name_s);
+	if(!name_e.empty()){
+		end = encode_dzsize_key(name_e);
+	}
+	Iterator *it = this->iterator(start, end, limit);
+	while(it->next()){
+		Bytes ks = it->key();
+		if(ks.data()[0] != DataType::DZSIZE){
+			break;
+		}
+		std::string n;
+		if(decode_dzsize_key(ks, &n) == -1){
+			continue;
+		}
+		list->push_back(n);
+	}
+	delete it;
+	return 0;
+}
+
+// @return -1: error; 0: not found; 1: found, score is encoded
+static int dzget_raw(const SSDB *ssdb, const Bytes &name, const Bytes &key, uint64_t *score){
+	std::string val;
+	int ret = ssdb->raw_get(encode_dzset_key(name, key), &val, true);
+	if(ret != 1){
+		return ret;
+	}
+	if(decode_dzscore_val(val, score) == -1){
+		log_error("bad dzset score");
+		return -1;
+	}
+	return 1;
+}
+
+// returns the number of newly added items
+static int dzset_one(SSDB *ssdb, const Bytes &name, const Bytes &key, double score, char log_type){
+	if(name.empty() || key.empty()){
+		log_error("empty name or key!");
+		return 0;
+	}
+	if(name.size() > SSDB_KEY_LEN_MAX ){
+		log_error("name too long!");
+		return -1;
+	}
+	if(key.size() > SSDB_KEY_LEN_MAX){
+		log_error("key too long!");
+		return -1;
+	}
+	if(isnan(score)){
+		log_error("score is NaN!");
+		return -1;
+	}
+	uint64_t new_s = encode_dzscore(score);
+	uint64_t old_s;
+	int found = dzget_raw(ssdb, name, key, &old_s);
+	if(found == -1){
+		return -1;
+	}
+	if(found == 0 || old_s != new_s){
+		if(found){
+			ssdb->binlogs->Delete(encode_dzscore_key(name, key, old_s));
+		}
+		ssdb->binlogs->Put(encode_dzscore_key(name, key, new_s), "");
+
+		std::string k0 = encode_dzset_key(name, key);
+		ssdb->binlogs->Put(k0, encode_dzscore_val(new_s));
+		ssdb->binlogs->add_log(log_type, BinlogCommand::DZSET, k0);
+
+		return found? 0 : 1;
+	}
+	return 0;
+}
+
+static int dzdel_one(SSDB *ssdb, const Bytes &name, const Bytes &key, char log_type){
+	if(name.size() > SSDB_KEY_LEN_MAX ){
+		log_error("name too long!");
+		return -1;
+	}
+	if(key.size() > SSDB_KEY_LEN_MAX){
+		log_error("key too long!");
+		return -1;
+	}
+	uint64_t old_s;
+	int found = dzget_raw(ssdb, name, key, &old_s);
+	if(found != 1){
+		return found;
+	}
+	ssdb->binlogs->Delete(encode_dzscore_key(name, key, old_s));
+
+	std::string k0 = encode_dzset_key(name, key);
+	ssdb->binlogs->Delete(k0);
+	ssdb->binlogs->add_log(log_type, BinlogCommand::DZDEL, k0);
+	return 1;
+}
+
+static int incr_dzsize(SSDB *ssdb, const Bytes &name, int64_t incr){
+	int64_t size = ssdb->dzsize(name);
+	if(size == -1){
+		return -1;
+	}
+	size += incr;
+	std::string size_key = encode_dzsize_key(name);
+	if(size == 0){
+		ssdb->binlogs->Delete(size_key);
+	}else{
+		ssdb->binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
+	}
+	ssdb->meta_cache->set(size_key, size);
+	return 0;
+}
@@ -0,0 +1,243 @@
+#ifndef SSDB_DZSET_H_
+#define SSDB_DZSET_H_
+
+#include "include.h"
+#include "ssdb.h"
+#include "util/strings.h"
+
+/*
+A dzset is a zset whose scores are doubles, kept apart from the int64
+zsets under its own prefixes. A score is stored as 8 bytes which sort as
+the doubles do: the sign bit is flipped for positive numbers, all bits for
+negative ones, so score keys are scanned by seeks just as zscore keys.
+-0.0 is stored as 0.0, NaN is rejected.
+*/
+
+static inline
+uint64_t encode_dzscore(double score){
+	if(score == 0){
+		score = 0;
+	}
+	uint64_t u;
+	memcpy(&u, &score, sizeof(u));
+	if(u >> 63){
+		u = ~u;
+	}else{
+		u |= (uint64_t)1 << 63;
+	}
+	return u;
+}
+
+static inline
+double decode_dzscore(uint64_t u){
+	if(u >> 63){
+		u &= ~((uint64_t)1 << 63);
+	}else{
+		u = ~u;
+	}
+	double score;
+	memcpy(&score, &u, sizeof(score));
+	return score;
+}
+
+// the value of a dzset key, and the score in a dzscore key
+static inline
+std::string encode_dzscore_val(uint64_t u){
+	u = big_endian(u);
+	return std::string((char *)&u, sizeof(u));
+}
+
+static inline
+int decode_dzscore_val(const Bytes &val, uint64_t *u){
+	if(val.size() != sizeof(uint64_t)){
+		return -1;
+	}
+	memcpy(u, val.data(), sizeof(uint64_t));
+	*u = big_endian(*u);
+	return 0;
+}
+
+/**
+ * Parse a score, "inf", "+inf" and "-inf" are accepted, spaces are not
+ * skipped, as str_to_score().
+ * @return -1: not a number
+ */
+static inline
+int str_to_dzscore(const Bytes &s, double *score){
+	char buf[64];
+	if(s.empty() || s.size() >= (int)sizeof(buf) || isspace(s.data()[0])){
+		return -1;
+	}
+	memcpy(buf, s.data(), s.size());
+	buf[s.size()] = '\0';
+	char *end;
+	errno = 0;
+	double d = strtod(buf, &end);
+	if(end != buf + s.size() || isnan(d) || (errno == ERANGE && isinf(d))){
+		return -1;
+	}
+	*score = d;
+	return 0;
+}
+
+// the shortest of %.15g and %.17g which reads back as the same double
+static inline
+std::string dzscore_to_str(double score){
+	if(isinf(score)){
+		return score > 0? "inf" : "-inf";
+	}
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.15g", score);
+	if(strtod(buf, NULL) != score){
+		snprintf(buf, sizeof(buf), "%.17g", score);
+	}
+	return std::string(buf);
+}
+
+/**
+ * Parse a range bound of dzscan/dzrscan/dzcount: a score, "(" before it
+ * makes it exclusive, an empty bound is @dflt(-inf or +inf).
+ * @return -1: not a number
+ */
+static inline
+int str_to_dzbound(const Bytes &s, double dflt, double *score, bool *open){
+	*open = false;
+	if(s.empty()){
+		*score = dflt;
+		return 0;
+	}
+	if(s.data()[0] == '('){
+		*open = true;
+		return str_to_dzscore(Bytes(s.data() + 1, s.size() - 1), score);
+	}
+	return str_to_dzscore(s, score);
+}
+
+static inline
+std::string encode_dzsize_key(const Bytes &name){
+	std::string buf;
+	buf.append(1, DataType::DZSIZE);
+	buf.append(name.data(), name.size());
+	return buf;
+}
+
+inline static
+int decode_dzsize_key(const Bytes &slice, std::string *name){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_data(name) == -1){
+		return -1;
+	}
+	return 0;
+}
+
+static inline
+std::string encode_dzset_key(const Bytes &name, const Bytes &key){
+	std::string buf;
+	buf.append(1, DataType::DZSET);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	buf.append(1, (uint8_t)key.size());
+	buf.append(key.data(), key.size());
+	return buf;
+}
+
+static inline
+int decode_dzset_key(const Bytes &slice, std::string *name, std::string *key){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(name) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(key) == -1){
+		return -1;
+	}
+	return 0;
+}
+
+// type, len, name, score, =, key
+static inline
+std::string encode_dzscore_key(const Bytes &name, const Bytes &key, uint64_t u){
+	std::string buf;
+	buf.reserve(1 + 1 + name.size() + sizeof(uint64_t) + 1 + key.size());
+	buf.append(1, DataType::DZSCORE);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	u = big_endian(u);
+	buf.append((char *)&u, sizeof(uint64_t));
+	buf.append(1, '=');
+	buf.append(key.data(), key.size());
+	return buf;
+}
+
+// key is a view into @slice, nothing is copied
+static inline
+int decode_dzscore_key(const Bytes &slice, Bytes *key, double *score){
+	const char *p = slice.data();
+	int size = slice.size();
+	if(size < 2){
+		return -1;
+	}
+	int head = 2 + (uint8_t)p[1];
+	if(size < head + (int)sizeof(uint64_t) + 1){
+		return -1;
+	}
+	uint64_t u;
+	memcpy(&u, p + head, sizeof(uint64_t));
+	*score = decode_dzscore(big_endian(u));
+	head += sizeof(uint64_t) + 1;
+	*key = Bytes(p + head, size - head);
+	return 0;
+}
+
+
+class DZIterator{
+	private:
+		Iterator *it;
+	public:
+		std::string name;
+		// the current item, key is a view into the db key, valid until
+		// the next call of next()
+		Bytes key;
+		double score;
+
+		DZIterator(Iterator *it, const Bytes &name){
+			this->it = it;
+			this->name.assign(name.data(), name.size());
+			this->score = 0;
+		}
+
+		~DZIterator(){
+			delete it;
+		}
+
+		bool skip(uint64_t offset){
+			while(offset-- > 0){
+				if(this->next() == false){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool next(){
+			while(it->next()){
+				Bytes ks = it->key();
+				if(ks.data()[0] != DataType::DZSCORE){
+					return false;
+				}
+				if(decode_dzscore_key(ks, &key, &score) == -1){
+					continue;
+				}
+				return true;
+			}
+			return false;
+		}
+};
+
+
+#endif
@@ -1,10 +1,17 @@
 #include "t_hash.h"
 #include "ssdb.h"
 #include "leveldb/write_batch.h"
+#include "meta_cache.h"
+#include "counter.h"
 
 static int hset_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, const Bytes &val, char log_type);
 static int hdel_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, char log_type);
 static int incr_hsize(SSDB *ssdb, const Bytes &name, int64_t incr);
+static int hpack_load(const SSDB *ssdb, const Bytes &name, hash_fields_t *fields);
+static int hpack_find(const hash_fields_t &fields, const Bytes &key);
+static int hpack_get(const SSDB *ssdb, const Bytes &name, const Bytes &key, std::string *val);
+static int hpack_set(const SSDB *ssdb, const Bytes &name, hash_fields_t *fields,
+		const Bytes &key, const Bytes &val, char log_type);
 
 // multi_hset work incorrect when same key occurs in kvs more than once
 //int SSDB::multi_hset(const Bytes &name, const std::vector<Bytes> &kvs, int offset, char log_type){
@@ -70,6 +77,9 @@ static int incr_hsize(SSDB *ssdb, const Bytes &name, int64_t incr);
  * @return -1: error, 0: item updated, 1: new item inserted
  */
 int SSDB::hset(const Bytes &name, const Bytes &key, const Bytes &val, char log_type){
+	if(this->clear_expired(DataType::HSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int ret = hset_one(this, name, key, val, log_type);
@@ -88,6 +98,10 @@ int SSDB::hset(const Bytes &name, const Bytes &key, const Bytes &val, char log_t
 }
 
 int SSDB::hdel(const Bytes &name, const Bytes &key, char log_type){
+	CounterLocking cl(counters);
+	if(this->clear_expired(DataType::HSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int ret = hdel_one(this, name, key, log_type);
@@ -102,10 +116,16 @@ int SSDB::hdel(const Bytes &name, const Bytes &key, char log_type){
 			return -1;
 		}
 	}
+	if(counters){
+		counters->drop(encode_hash_key(name, key));
+	}
 	return ret;
 }
 
 int SSDB::hincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val, char log_type){
+	if(this->clear_expired(DataType::HSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int64_t val;
@@ -135,30 +155,113 @@ int SSDB::hincr(const Bytes &name, const Bytes &key, int64_t by, std::string *ne
 	return ret;
 }
 
-int64_t SSDB::hsize(const Bytes &name) const{
+int64_t SSDB::hclear(const Bytes &name, char log_type){
+	CounterLocking cl(counters);
+	if(counters){
+		// they go with the container
+		counters->drop_container(DataType::HSIZE, name);
+	}
 	std::string size_key = encode_hsize_key(name);
-	std::string val;
-	leveldb::Status s;
+	{
+		hash_fields_t fields;
+		int packed = hpack_load(this, name, &fields);
+		if(packed == -1){
+			return -1;
+		}
+		if(packed){
+			Transaction trans(binlogs);
+			binlogs->Delete(encode_hpack_key(name));
+			for(int i=0; i<(int)fields.size(); i++){
+				binlogs->add_log(log_type, BinlogCommand::HDEL, encode_hash_key(name, fields[i].first));
+			}
+			binlogs->Delete(size_key);
+			meta_cache->set(size_key, 0);
+			if(this->del_container_ttl(DataType::HSIZE, name) == -1){
+				return -1;
+			}
+			leveldb::Status s = binlogs->commit();
+			if(!s.ok()){
+				log_error("hclear error: %s", s.ToString().c_str());
+				return -1;
+			}
+			return (int64_t)fields.size();
+		}
+	}
+	std::string start = encode_hash_key(name, "");
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
 
-	s = db->Get(leveldb::ReadOptions(), size_key, &val);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		return -1;
-	}else{
-		if(val.size() != sizeof(uint64_t)){
-			return 0;
+		// fields are deleted without reading, the hash may have expired
+		int num = 0;
+		HIterator *it = new HIterator(this->iterator(start, "", CLEAR_CHUNK), name);
+		it->return_val(false);
+		while(it->next()){
+			std::string hkey = encode_hash_key(name, it->key);
+			binlogs->Delete(hkey);
+			binlogs->add_log(log_type, BinlogCommand::HDEL, hkey);
+			num ++;
+		}
+		delete it;
+
+		int64_t size = this->container_size(size_key);
+		if(size == -1){
+			return -1;
+		}
+		size -= num;
+		if(num < CLEAR_CHUNK || size <= 0){
+			// the last chunk
+			size = 0;
+			binlogs->Delete(size_key);
+			if(this->del_container_ttl(DataType::HSIZE, name) == -1){
+				return -1;
+			}
+		}else{
+			binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
+		}
+		meta_cache->set(size_key, size);
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("hclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
 		}
-		int64_t ret = *(int64_t *)val.data();
-		return ret < 0? 0 : ret;
 	}
+	this->add_deletes(DataType::HASH, name, total);
+	return total;
+}
+
+int64_t SSDB::hsize(const Bytes &name) const{
+	if(this->container_expired(DataType::HSIZE, name)){
+		return 0;
+	}
+	return this->container_size(encode_hsize_key(name));
 }
 
 int SSDB::hget(const Bytes &name, const Bytes &key, std::string *val) const{
+	if(this->container_expired(DataType::HSIZE, name)){
+		return 0;
+	}
+	// a hash small enough to be packed is probably packed, a larger one
+	// may still be, if it was packed with a larger small_hash_fields
+	int64_t size = this->container_size(encode_hsize_key(name));
+	if(size == -1){
+		return -1;
+	}
+	bool small = size <= small_hash_fields;
+	if(small){
+		int ret = hpack_get(this, name, key, val);
+		if(ret != 0){
+			return ret;
+		}
+	}
 	std::string dbkey = encode_hash_key(name, key);
 	leveldb::Status s = db->Get(leveldb::ReadOptions(), dbkey, val);
 	if(s.IsNotFound()){
-		return 0;
+		return small? 0 : hpack_get(this, name, key, val);
 	}
 	if(!s.ok()){
 		return -1;
@@ -166,7 +269,69 @@ int SSDB::hget(const Bytes &name, const Bytes &key, std::string *val) const{
 	return 1;
 }
 
+int SSDB::multi_hget(const Bytes &name, const std::vector<Bytes> &keys, int offset,
+		std::vector<std::string> *list) const
+{
+	if(this->container_expired(DataType::HSIZE, name)){
+		return 0;
+	}
+	hash_fields_t fields;
+	int packed = hpack_load(this, name, &fields);
+	if(packed == -1){
+		return -1;
+	}
+	if(packed){
+		int num = 0;
+		for(int i=offset; i<(int)keys.size(); i++){
+			int n = hpack_find(fields, keys[i]);
+			if(n < (int)fields.size() && fields[n].first == keys[i]){
+				list->push_back(fields[n].first);
+				list->push_back(fields[n].second);
+				num ++;
+			}
+		}
+		return num;
+	}
+	// keys of one container share a prefix, and are mostly in the same blocks
+	std::vector<std::string> bufs;
+	for(int i=offset; i<(int)keys.size(); i++){
+		bufs.push_back(encode_hash_key(name, keys[i]));
+	}
+	std::vector<std::string> vals;
+	std::vector<bool> found;
+	if(this->batch_get(bufs, &vals, &found) == -1){
+		return -1;
+	}
+	int num = 0;
+	for(int i=0; i<(int)bufs.size(); i++){
+		if(found[i]){
+			list->push_back(keys[offset + i].String());
+			list->push_back(vals[i]);
+			num ++;
+		}
+	}
+	return num;
+}
+
 HIterator* SSDB::hscan(const Bytes &name, const Bytes &start, const Bytes &end, uint64_t limit) const{
+	if(this->container_expired(DataType::HSIZE, name)){
+		return new HIterator(this->iterator("", "", 0), name);
+	}
+	hash_fields_t fields;
+	if(hpack_load(this, name, &fields) == 1){
+		// (start, end]
+		hash_fields_t items;
+		for(int i=hpack_find(fields, start); i<(int)fields.size() && items.size()<limit; i++){
+			if(fields[i].first == start.String()){
+				continue;
+			}
+			if(!end.empty() && Bytes(fields[i].first).compare(end) > 0){
+				break;
+			}
+			items.push_back(fields[i]);
+		}
+		return new HIterator(items, name);
+	}
 	std::string key_start, key_end;
 
 	key_start = encode_hash_key(name, start);
@@ -180,6 +345,22 @@ HIterator* SSDB::hscan(const Bytes &name, const Bytes &start, const Bytes &end,
 }
 
 HIterator* SSDB::hrscan(const Bytes &name, const Bytes &start, const Bytes &end, uint64_t limit) const{
+	if(this->container_expired(DataType::HSIZE, name)){
+		return new HIterator(this->iterator("", "", 0), name);
+	}
+	hash_fields_t fields;
+	if(hpack_load(this, name, &fields) == 1){
+		// [end, start), all keys if start is empty
+		hash_fields_t items;
+		int i = start.empty()? (int)fields.size() : hpack_find(fields, start);
+		for(i--; i>=0 && items.size()<limit; i--){
+			if(!end.empty() && Bytes(fields[i].first).compare(end) < 0){
+				break;
+			}
+			items.push_back(fields[i]);
+		}
+		return new HIterator(items, name);
+	}
 	std::string key_start, key_end;
 
 	key_start = encode_hash_key(name, start);
@@ -219,6 +400,85 @@ int SSDB::hlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 	return 0;
 }
 
+// @return 1: packed, 0: not packed, -1: error
+static int hpack_load(const SSDB *ssdb, const Bytes &name, hash_fields_t *fields){
+	std::string raw;
+	int ret = ssdb->raw_get(encode_hpack_key(name), &raw, true);
+	if(ret != 1){
+		return ret;
+	}
+	if(decode_hash_pack(raw, fields) == -1){
+		log_error("bad packed hash: %s", hexmem(name.data(), name.size()).c_str());
+		return -1;
+	}
+	return 1;
+}
+
+// index of the first field not less than @key
+static int hpack_find(const hash_fields_t &fields, const Bytes &key){
+	int lo = 0;
+	int hi = (int)fields.size();
+	while(lo < hi){
+		int mid = (lo + hi) / 2;
+		if(Bytes(fields[mid].first).compare(key) < 0){
+			lo = mid + 1;
+		}else{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+// @return 1: found in the packed hash, 0: not found or not packed, -1: error
+static int hpack_get(const SSDB *ssdb, const Bytes &name, const Bytes &key, std::string *val){
+	hash_fields_t fields;
+	int packed = hpack_load(ssdb, name, &fields);
+	if(packed != 1){
+		return packed;
+	}
+	int i = hpack_find(fields, key);
+	if(i == (int)fields.size() || fields[i].first != key){
+		return 0;
+	}
+	val->swap(fields[i].second);
+	return 1;
+}
+
+// set a field of a packed hash, convert it into one row per field if it
+// grows over small_hash_fields or small_hash_value
+static int hpack_set(const SSDB *ssdb, const Bytes &name, hash_fields_t *fields,
+		const Bytes &key, const Bytes &val, char log_type)
+{
+	int ret = 0;
+	int i = hpack_find(*fields, key);
+	if(i < (int)fields->size() && (*fields)[i].first == key){
+		if((*fields)[i].second == val){
+			return 0;
+		}
+		(*fields)[i].second = val.String();
+	}else{
+		fields->insert(fields->begin() + i, std::make_pair(key.String(), val.String()));
+		ret = 1;
+	}
+	bool fits = (int)fields->size() <= ssdb->small_hash_fields
+		&& key.size() <= ssdb->small_hash_value && val.size() <= ssdb->small_hash_value;
+	if(fits){
+		ssdb->binlogs->Put(encode_hpack_key(name), encode_hash_pack(*fields));
+		ssdb->binlogs->add_log(log_type, BinlogCommand::HSET, encode_hash_key(name, key));
+	}else{
+		// every field is logged, a slave in the copy phase may have passed
+		// the rows but not the packed row yet(see BackendSync)
+		for(int n=0; n<(int)fields->size(); n++){
+			const std::pair<std::string, std::string> &f = (*fields)[n];
+			std::string hkey = encode_hash_key(name, f.first);
+			ssdb->binlogs->Put(hkey, f.second);
+			ssdb->binlogs->add_log(log_type, BinlogCommand::HSET, hkey);
+		}
+		ssdb->binlogs->Delete(encode_hpack_key(name));
+	}
+	return ret;
+}
+
 // returns the number of newly added items
 static int hset_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, const Bytes &val, char log_type){
 	if(name.empty() || key.empty()){
@@ -233,6 +493,25 @@ static int hset_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, const
 		log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
 		return -1;
 	}
+	hash_fields_t fields;
+	int packed = hpack_load(ssdb, name, &fields);
+	if(packed == -1){
+		return -1;
+	}
+	if(packed == 0 && ssdb->small_hash_fields > 0
+		&& key.size() <= ssdb->small_hash_value && val.size() <= ssdb->small_hash_value)
+	{
+		// a new hash starts packed
+		int64_t size = ssdb->hsize(name);
+		if(size == -1){
+			return -1;
+		}
+		packed = (size == 0);
+	}
+	if(packed){
+		return hpack_set(ssdb, name, &fields, key, val, log_type);
+	}
+
 	int ret = 0;
 	std::string dbval;
 	if(ssdb->hget(name, key, &dbval) == 0){ // not found
@@ -260,6 +539,26 @@ static int hdel_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, char
 		log_error("key too long! %s", hexmem(key.data(), key.size()).c_str());
 		return -1;
 	}
+	hash_fields_t fields;
+	int packed = hpack_load(ssdb, name, &fields);
+	if(packed == -1){
+		return -1;
+	}
+	if(packed){
+		int i = hpack_find(fields, key);
+		if(i == (int)fields.size() || fields[i].first != key){
+			return 0;
+		}
+		fields.erase(fields.begin() + i);
+		if(fields.empty()){
+			ssdb->binlogs->Delete(encode_hpack_key(name));
+		}else{
+			ssdb->binlogs->Put(encode_hpack_key(name), encode_hash_pack(fields));
+		}
+		ssdb->binlogs->add_log(log_type, BinlogCommand::HDEL, encode_hash_key(name, key));
+		return 1;
+	}
+
 	std::string dbval;
 	if(ssdb->hget(name, key, &dbval) == 0){
 		return 0;
@@ -274,12 +573,19 @@ static int hdel_one(const SSDB *ssdb, const Bytes &name, const Bytes &key, char
 
 static int incr_hsize(SSDB *ssdb, const Bytes &name, int64_t incr){
 	int64_t size = ssdb->hsize(name);
+	if(size == -1){
+		return -1;
+	}
 	size += incr;
 	std::string size_key = encode_hsize_key(name);
 	if(size == 0){
 		ssdb->binlogs->Delete(size_key);
+		if(ssdb->del_container_ttl(DataType::HSIZE, name) == -1){
+			return -1;
+		}
 	}else{
 		ssdb->binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
 	}
+	ssdb->meta_cache->set(size_key, size);
 	return 0;
 }
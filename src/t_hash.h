@@ -2,6 +2,7 @@
 #define SSDB_HASH_H_
 
 #include "ssdb.h"
+#include <vector>
 
 inline static
 std::string encode_hsize_key(const Bytes &name){
@@ -52,12 +53,65 @@ int decode_hash_key(const Bytes &slice, std::string *name, std::string *key){
 	return 0;
 }
 
+inline static
+std::string encode_hpack_key(const Bytes &name){
+	std::string buf;
+	buf.append(1, DataType::HPACK);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	return buf;
+}
+
+inline static
+int decode_hpack_key(const Bytes &slice, std::string *name){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(name) == -1){
+		return -1;
+	}
+	return 0;
+}
+
+// fields of a small hash, sorted by key
+typedef std::vector<std::pair<std::string, std::string> > hash_fields_t;
+
+// packed value of a small hash: key_len(1) key val_len(1) val ...
+inline static
+std::string encode_hash_pack(const hash_fields_t &fields){
+	std::string buf;
+	for(int i=0; i<(int)fields.size(); i++){
+		buf.append(1, (uint8_t)fields[i].first.size());
+		buf.append(fields[i].first);
+		buf.append(1, (uint8_t)fields[i].second.size());
+		buf.append(fields[i].second);
+	}
+	return buf;
+}
+
+inline static
+int decode_hash_pack(const Bytes &slice, hash_fields_t *fields){
+	Decoder decoder(slice.data(), slice.size());
+	fields->clear();
+	std::string key, val;
+	while(decoder.read_8_data(&key) != -1){
+		if(decoder.read_8_data(&val) == -1){
+			return -1;
+		}
+		fields->push_back(std::make_pair(key, val));
+	}
+	return 0;
+}
 
 
 class HIterator{
 	private:
 		Iterator *it;
 		bool return_val_;
+		// fields of a packed hash, when it is NULL
+		hash_fields_t fields;
+		int index;
 	public:
 		std::string name;
 		std::string key;
@@ -69,6 +123,15 @@ class HIterator{
 			this->return_val_ = true;
 		}
 
+		// @fields: in the order to be returned
+		HIterator(const hash_fields_t &fields, const Bytes &name){
+			this->it = NULL;
+			this->fields = fields;
+			this->index = 0;
+			this->name.assign(name.data(), name.size());
+			this->return_val_ = true;
+		}
+
 		~HIterator(){
 			delete it;
 		}
@@ -78,6 +141,17 @@ class HIterator{
 		}
 
 		bool next(){
+			if(it == NULL){
+				if(index >= (int)fields.size()){
+					return false;
+				}
+				key = fields[index].first;
+				if(return_val_){
+					val = fields[index].second;
+				}
+				index ++;
+				return true;
+			}
 			while(it->next()){
 				Bytes ks = it->key();
 				Bytes vs = it->val();
@@ -0,0 +1,342 @@
+#include "t_hll.h"
+#include "ssdb.h"
+#include <math.h>
+
+/*
+HyperLogLog with 2^14 registers of 6 bits(standard error 0.81%), the
+same parameters as redis, stored in one value:
+	sparse: 'S' (index(2 bytes, big endian) value(1 byte))...
+		non-zero registers sorted by index, used while it is smaller
+		than HLL_SPARSE_MAX bytes
+	dense: 'D' registers packed in 6 bits each, 12 KB
+*/
+
+static const int HLL_P = 14;
+static const int HLL_Q = 64 - HLL_P;
+static const int HLL_REGISTERS = 1 << HLL_P;
+static const int HLL_DENSE_SIZE = 1 + (HLL_REGISTERS * 6 + 7) / 8;
+static const int HLL_SPARSE_MAX = 3000;
+static const char HLL_SPARSE = 'S';
+static const char HLL_DENSE = 'D';
+
+// MurmurHash64A, by Austin Appleby
+static uint64_t murmurhash64a(const void *key, int len, uint64_t seed){
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = seed ^ (len * m);
+	const uint8_t *data = (const uint8_t *)key;
+	const uint8_t *end = data + (len - (len & 7));
+
+	while(data != end){
+		uint64_t k;
+		memcpy(&k, data, 8);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+		data += 8;
+	}
+	switch(len & 7){
+		case 7: h ^= (uint64_t)data[6] << 48;
+		case 6: h ^= (uint64_t)data[5] << 40;
+		case 5: h ^= (uint64_t)data[4] << 32;
+		case 4: h ^= (uint64_t)data[3] << 24;
+		case 3: h ^= (uint64_t)data[2] << 16;
+		case 2: h ^= (uint64_t)data[1] << 8;
+		case 1: h ^= (uint64_t)data[0];
+			h *= m;
+	}
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return h;
+}
+
+// register index and value(position of the first 1 bit) of an item
+static int hll_pattern(const Bytes &item, uint8_t *val){
+	uint64_t hash = murmurhash64a(item.data(), item.size(), 0xadc83b19ULL);
+	int index = (int)(hash & (HLL_REGISTERS - 1));
+	hash >>= HLL_P;
+	hash |= (uint64_t)1 << HLL_Q;
+	*val = (uint8_t)(__builtin_ctzll(hash) + 1);
+	return index;
+}
+
+static inline uint8_t dense_get(const uint8_t *p, int i){
+	int bit = i * 6;
+	int b = bit >> 3;
+	int s = bit & 7;
+	unsigned v = p[b] >> s;
+	if(s > 2){
+		v |= (unsigned)p[b + 1] << (8 - s);
+	}
+	return v & 63;
+}
+
+static inline void dense_set(uint8_t *p, int i, uint8_t v){
+	int bit = i * 6;
+	int b = bit >> 3;
+	int s = bit & 7;
+	p[b] = (uint8_t)((p[b] & ~(63 << s)) | (v << s));
+	if(s > 2){
+		p[b + 1] = (uint8_t)((p[b + 1] & ~(63 >> (8 - s))) | (v >> (8 - s)));
+	}
+}
+
+// a register is at most HLL_Q + 1, as hll_estimate() expects
+// @return -1: not a hyperloglog
+static int hll_decode(const std::string &val, uint8_t *regs){
+	memset(regs, 0, HLL_REGISTERS);
+	if(val.empty()){
+		return 0;
+	}
+	const uint8_t *p = (const uint8_t *)val.data() + 1;
+	if(val[0] == HLL_DENSE && (int)val.size() == HLL_DENSE_SIZE){
+		for(int i=0; i<HLL_REGISTERS; i++){
+			regs[i] = dense_get(p, i);
+			if(regs[i] > HLL_Q + 1){
+				return -1;
+			}
+		}
+		return 0;
+	}
+	if(val[0] == HLL_SPARSE && (val.size() - 1) % 3 == 0){
+		int n = (int)(val.size() - 1) / 3;
+		for(int i=0; i<n; i++, p+=3){
+			int index = (p[0] << 8) | p[1];
+			if(index >= HLL_REGISTERS || p[2] > HLL_Q + 1){
+				return -1;
+			}
+			regs[index] = p[2];
+		}
+		return 0;
+	}
+	return -1;
+}
+
+static std::string hll_encode(const uint8_t *regs){
+	int nonzero = 0;
+	for(int i=0; i<HLL_REGISTERS; i++){
+		nonzero += (regs[i] != 0);
+	}
+	std::string val;
+	if(1 + nonzero * 3 < HLL_SPARSE_MAX){
+		val.reserve(1 + nonzero * 3);
+		val.append(1, HLL_SPARSE);
+		for(int i=0; i<HLL_REGISTERS; i++){
+			if(regs[i]){
+				val.append(1, (char)(i >> 8));
+				val.append(1, (char)(i & 0xff));
+				val.append(1, (char)regs[i]);
+			}
+		}
+	}else{
+		val.assign(HLL_DENSE_SIZE, '\0');
+		val[0] = HLL_DENSE;
+		uint8_t *p = (uint8_t *)&val[1];
+		for(int i=0; i<HLL_REGISTERS; i++){
+			dense_set(p, i, regs[i]);
+		}
+	}
+	return val;
+}
+
+// dst = max(dst, src), a plain loop the compiler can vectorize
+static void hll_max(uint8_t *dst, const uint8_t *src){
+	for(int i=0; i<HLL_REGISTERS; i++){
+		dst[i] = dst[i] > src[i]? dst[i] : src[i];
+	}
+}
+
+static double hll_sigma(double x){
+	if(x == 1.0){
+		return INFINITY;
+	}
+	double z_prime;
+	double y = 1;
+	double z = x;
+	do{
+		x *= x;
+		z_prime = z;
+		z += x * y;
+		y += y;
+	}while(z_prime != z);
+	return z;
+}
+
+static double hll_tau(double x){
+	if(x == 0.0 || x == 1.0){
+		return 0.0;
+	}
+	double z_prime;
+	double y = 1.0;
+	double z = 1 - x;
+	do{
+		x = sqrt(x);
+		z_prime = z;
+		y *= 0.5;
+		z -= pow(1 - x, 2) * y;
+	}while(z_prime != z);
+	return z / 3;
+}
+
+// the improved estimator of Otmar Ertl, "New cardinality estimation
+// algorithms for HyperLogLog sketches", as in redis
+static int64_t hll_estimate(const uint8_t *regs){
+	int histo[HLL_Q + 2];
+	memset(histo, 0, sizeof(histo));
+	for(int i=0; i<HLL_REGISTERS; i++){
+		histo[regs[i]] ++;
+	}
+	double m = HLL_REGISTERS;
+	double z = m * hll_tau((m - histo[HLL_Q + 1]) / m);
+	for(int j=HLL_Q; j>=1; j--){
+		z += histo[j];
+		z *= 0.5;
+	}
+	z += m * hll_sigma(histo[0] / m);
+	const double alpha_inf = 0.5 / log(2.0);
+	return (int64_t)llround(alpha_inf * m * m / z);
+}
+
+// @return 1: found, 0: not found, -1: error or not a hyperloglog
+static int hll_load(const SSDB *ssdb, const Bytes &name, uint8_t *regs){
+	std::string val;
+	int ret = ssdb->raw_get(encode_hll_key(name), &val, true);
+	if(ret == -1){
+		return -1;
+	}
+	if(hll_decode(val, regs) == -1){
+		log_error("bad hyperloglog: %s", hexmem(name.data(), name.size()).c_str());
+		return -1;
+	}
+	return ret;
+}
+
+int SSDB::pfadd(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type){
+	if(name.empty() || name.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty name or name too long!");
+		return -1;
+	}
+	Transaction trans(binlogs);
+
+	std::string key = encode_hll_key(name);
+	std::string val;
+	int found = this->raw_get(key, &val, true);
+	if(found == -1){
+		return -1;
+	}
+	int changed = 0;
+	if(found && val[0] == HLL_DENSE && (int)val.size() == HLL_DENSE_SIZE){
+		// updated in place
+		uint8_t *p = (uint8_t *)&val[1];
+		for(int i=offset; i<(int)items.size(); i++){
+			uint8_t v;
+			int index = hll_pattern(items[i], &v);
+			if(dense_get(p, index) < v){
+				dense_set(p, index, v);
+				changed = 1;
+			}
+		}
+	}else{
+		uint8_t regs[HLL_REGISTERS];
+		if(hll_decode(val, regs) == -1){
+			log_error("bad hyperloglog: %s", hexmem(name.data(), name.size()).c_str());
+			return -1;
+		}
+		for(int i=offset; i<(int)items.size(); i++){
+			uint8_t v;
+			int index = hll_pattern(items[i], &v);
+			if(regs[index] < v){
+				regs[index] = v;
+				changed = 1;
+			}
+		}
+		if(changed || !found){
+			val = hll_encode(regs);
+		}
+	}
+	// as redis, an empty hyperloglog is created if not exists
+	if(!changed && found){
+		return 0;
+	}
+	binlogs->Put(key, val);
+	binlogs->add_log(log_type, BinlogCommand::PFSET, key);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("pfadd error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int64_t SSDB::pfcount(const std::vector<Bytes> &names, int offset) const{
+	uint8_t regs[HLL_REGISTERS];
+	if(hll_load(this, names[offset], regs) == -1){
+		return -1;
+	}
+	for(int i=offset+1; i<(int)names.size(); i++){
+		uint8_t tmp[HLL_REGISTERS];
+		if(hll_load(this, names[i], tmp) == -1){
+			return -1;
+		}
+		hll_max(regs, tmp);
+	}
+	return hll_estimate(regs);
+}
+
+int SSDB::pfmerge(const Bytes &dest, const std::vector<Bytes> &names, int offset, char log_type){
+	if(dest.empty() || dest.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty name or name too long!");
+		return -1;
+	}
+	Transaction trans(binlogs);
+
+	uint8_t regs[HLL_REGISTERS];
+	if(hll_load(this, dest, regs) == -1){
+		return -1;
+	}
+	for(int i=offset; i<(int)names.size(); i++){
+		uint8_t tmp[HLL_REGISTERS];
+		if(hll_load(this, names[i], tmp) == -1){
+			return -1;
+		}
+		hll_max(regs, tmp);
+	}
+	std::string key = encode_hll_key(dest);
+	binlogs->Put(key, hll_encode(regs));
+	binlogs->add_log(log_type, BinlogCommand::PFSET, key);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("pfmerge error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::pfclear(const Bytes &name, char log_type){
+	Transaction trans(binlogs);
+
+	std::string key = encode_hll_key(name);
+	binlogs->Delete(key);
+	binlogs->add_log(log_type, BinlogCommand::PFDEL, key);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("pfclear error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::pfset_raw(const Bytes &key, const Bytes &val, char log_type){
+	Transaction trans(binlogs);
+	binlogs->Put(key.Slice(), val.Slice());
+	binlogs->add_log(log_type, BinlogCommand::PFSET, key.Slice());
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("pfset_raw error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
@@ -0,0 +1,26 @@
+#ifndef SSDB_HLL_H_
+#define SSDB_HLL_H_
+
+#include "ssdb.h"
+
+inline static
+std::string encode_hll_key(const Bytes &name){
+	std::string buf;
+	buf.append(1, DataType::HLL);
+	buf.append(name.data(), name.size());
+	return buf;
+}
+
+inline static
+int decode_hll_key(const Bytes &slice, std::string *name){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_data(name) == -1){
+		return -1;
+	}
+	return 0;
+}
+
+#endif
@@ -1,6 +1,90 @@
 #include "t_kv.h"
+#include "ttl.h"
+#include "counter.h"
 #include "leveldb/write_batch.h"
 
+// in KV_FORMAT, a plain value which looks like having a ttl header must
+// be escaped
+static void put_plain_val(const SSDB *ssdb, const std::string &buf, const Bytes &val){
+	if(ssdb->kv_ttl_header && kv_val_has_header(val)){
+		ssdb->binlogs->Put(buf, encode_kv_val(val, 0));
+	}else{
+		ssdb->binlogs->Put(buf, val.Slice());
+	}
+}
+
+// raw value, with ttl header if any
+static int kv_raw_get(leveldb::DB *db, const std::string &buf, std::string *raw){
+	leveldb::Status s = db->Get(leveldb::ReadOptions(), buf, raw);
+	if(s.IsNotFound()){
+		return 0;
+	}
+	if(!s.ok()){
+		log_error("get error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::upgrade_kv_format(){
+	std::string format;
+	leveldb::Status s = meta_db->Get(leveldb::ReadOptions(), KV_FORMAT_KEY, &format);
+	if(s.ok() && format == KV_FORMAT){
+		kv_ttl_header = true;
+		return 0;
+	}
+	if(!s.ok() && !s.IsNotFound()){
+		log_error("read kv_format error: %s", s.ToString().c_str());
+		return -1;
+	}
+	if(!inline_ttl){
+		// values are kept as written by the versions before the header
+		return 0;
+	}
+	log_info("upgrading kv values to format %s", KV_FORMAT);
+	s = leveldb::Status::OK();
+
+	// not written by binlogs, the slaves upgrade their own dbs
+	int64_t num = 0;
+	leveldb::WriteBatch batch;
+	leveldb::ReadOptions iterate_options;
+	iterate_options.fill_cache = false;
+	leveldb::Iterator *it = db->NewIterator(iterate_options);
+	for(it->Seek(std::string(1, DataType::KV)); it->Valid(); it->Next()){
+		leveldb::Slice ks = it->key();
+		if(ks.size() == 0 || ks[0] != DataType::KV){
+			break;
+		}
+		Bytes val(it->value().data(), it->value().size());
+		if(!kv_val_has_header(val)){
+			continue;
+		}
+		batch.Put(ks, encode_kv_val(val, 0));
+		num ++;
+		if(num % CLEAR_CHUNK == 0){
+			s = db->Write(leveldb::WriteOptions(), &batch);
+			if(!s.ok()){
+				break;
+			}
+			batch.Clear();
+		}
+	}
+	delete it;
+	if(s.ok()){
+		s = db->Write(leveldb::WriteOptions(), &batch);
+	}
+	if(s.ok()){
+		s = meta_db->Put(leveldb::WriteOptions(), KV_FORMAT_KEY, KV_FORMAT);
+	}
+	if(!s.ok()){
+		log_error("upgrade kv values error: %s", s.ToString().c_str());
+		return -1;
+	}
+	log_info("%" PRId64 " kv values escaped", num);
+	kv_ttl_header = true;
+	return 0;
+}
+
 int SSDB::multi_set(const std::vector<Bytes> &kvs, int offset, char log_type){
 	Transaction trans(binlogs);
 
@@ -15,7 +99,7 @@ int SSDB::multi_set(const std::vector<Bytes> &kvs, int offset, char log_type){
 		}
 		const Bytes &val = *(it + 1);
 		std::string buf = encode_kv_key(key);
-		binlogs->Put(buf, val.Slice());
+		put_plain_val(this, buf, val);
 		binlogs->add_log(log_type, BinlogCommand::KSET, buf);
 	}
 	leveldb::Status s = binlogs->commit();
@@ -27,6 +111,7 @@ int SSDB::multi_set(const std::vector<Bytes> &kvs, int offset, char log_type){
 }
 
 int SSDB::multi_del(const std::vector<Bytes> &keys, int offset, char log_type){
+	CounterLocking cl(counters);
 	Transaction trans(binlogs);
 
 	std::vector<Bytes>::const_iterator it;
@@ -42,6 +127,11 @@ int SSDB::multi_del(const std::vector<Bytes> &keys, int offset, char log_type){
 		log_error("multi_del error: %s", s.ToString().c_str());
 		return -1;
 	}
+	if(counters){
+		for(it = keys.begin() + offset; it != keys.end(); it++){
+			counters->drop(encode_kv_key(*it));
+		}
+	}
 	return keys.size() - offset;
 }
 
@@ -54,7 +144,7 @@ int SSDB::set(const Bytes &key, const Bytes &val, char log_type){
 	Transaction trans(binlogs);
 
 	std::string buf = encode_kv_key(key);
-	binlogs->Put(buf, val.Slice());
+	put_plain_val(this, buf, val);
 	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
 	leveldb::Status s = binlogs->commit();
 	if(!s.ok()){
@@ -78,7 +168,7 @@ int SSDB::setnx(const Bytes &key, const Bytes &val, char log_type){
 		return 0;
 	}
 	std::string buf = encode_kv_key(key);
-	binlogs->Put(buf, val.Slice());
+	put_plain_val(this, buf, val);
 	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
 	leveldb::Status s = binlogs->commit();
 	if(!s.ok()){
@@ -98,7 +188,7 @@ int SSDB::getset(const Bytes &key, std::string *val, const Bytes &newval, char l
 
 	int found = this->get(key, val);
 	std::string buf = encode_kv_key(key);
-	binlogs->Put(buf, newval.Slice());
+	put_plain_val(this, buf, newval);
 	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
 	leveldb::Status s = binlogs->commit();
 	if(!s.ok()){
@@ -108,8 +198,112 @@ int SSDB::getset(const Bytes &key, std::string *val, const Bytes &newval, char l
 	return found;
 }
 
+int SSDB::setx(const Bytes &key, const Bytes &val, int64_t expire, char log_type){
+	if(key.empty()){
+		log_error("empty key!");
+		//return -1;
+		return 0;
+	}
+	Transaction trans(binlogs);
+
+	std::string buf = encode_kv_key(key);
+	binlogs->Put(buf, encode_kv_val(val, expire));
+	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("set error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::expire(const Bytes &key, int64_t expire, char log_type){
+	Transaction trans(binlogs);
+
+	std::string val;
+	int found = this->get(key, &val);
+	if(found != 1){
+		return found;
+	}
+	std::string buf = encode_kv_key(key);
+	binlogs->Put(buf, encode_kv_val(val, expire));
+	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("set error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::del_expired(const std::vector<std::string> &keys, char log_type){
+	CounterLocking cl(counters);
+	Transaction trans(binlogs);
+
+	int64_t now = time_ms();
+	int count = 0;
+	std::vector<std::string> deleted;
+	std::vector<std::string>::const_iterator it;
+	for(it = keys.begin(); it != keys.end(); it++){
+		std::string buf = encode_kv_key(*it);
+		std::string raw;
+		if(kv_raw_get(db, buf, &raw) != 1){
+			continue;
+		}
+		// may have been set again
+		int64_t expire = decode_kv_expire(raw);
+		if(expire == 0 || expire > now){
+			continue;
+		}
+		binlogs->Delete(buf);
+		binlogs->add_log(log_type, BinlogCommand::KDEL, buf);
+		deleted.push_back(buf);
+		count ++;
+	}
+	if(count == 0){
+		return 0;
+	}
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("del error: %s", s.ToString().c_str());
+		return -1;
+	}
+	if(counters){
+		for(int i=0; i<(int)deleted.size(); i++){
+			counters->drop(deleted[i]);
+		}
+	}
+	return count;
+}
+
+int SSDB::scan_expired(const Bytes &start, uint64_t limit,
+		std::vector<std::string> *keys, std::string *last) const
+{
+	int64_t now = time_ms();
+	int count = 0;
+	Iterator *it = this->iterator(encode_kv_key(start), "", limit);
+	while(it->next()){
+		Bytes ks = it->key();
+		if(ks.data()[0] != DataType::KV){
+			break;
+		}
+		std::string key;
+		if(decode_kv_key(ks, &key) == -1){
+			continue;
+		}
+		count ++;
+		int64_t expire = decode_kv_expire(it->val());
+		if(expire > 0 && expire <= now){
+			keys->push_back(key);
+		}
+		*last = key;
+	}
+	delete it;
+	return count;
+}
 
 int SSDB::del(const Bytes &key, char log_type){
+	CounterLocking cl(counters);
 	Transaction trans(binlogs);
 
 	std::string buf = encode_kv_key(key);
@@ -121,6 +315,9 @@ int SSDB::del(const Bytes &key, char log_type){
 		log_error("del error: %s", s.ToString().c_str());
 		return -1;
 	}
+	if(counters){
+		counters->drop(buf);
+	}
 	return 1;
 }
 
@@ -128,8 +325,9 @@ int SSDB::incr(const Bytes &key, int64_t by, std::string *new_val, char log_type
 	Transaction trans(binlogs);
 
 	int64_t val;
+	int64_t expire = 0;
 	std::string old;
-	int ret = this->get(key, &old);
+	int ret = this->get(key, &old, &expire);
 	if(ret == -1){
 		return -1;
 	}else if(ret == 0){
@@ -141,7 +339,12 @@ int SSDB::incr(const Bytes &key, int64_t by, std::string *new_val, char log_type
 	*new_val = int64_to_str(val);
 	std::string buf = encode_kv_key(key);
 	
-	binlogs->Put(buf, *new_val);
+	if(expire > 0){
+		// keeps the ttl
+		binlogs->Put(buf, encode_kv_val(*new_val, expire));
+	}else{
+		binlogs->Put(buf, *new_val);
+	}
 	binlogs->add_log(log_type, BinlogCommand::KSET, buf);
 
 	leveldb::Status s = binlogs->commit();
@@ -153,17 +356,65 @@ int SSDB::incr(const Bytes &key, int64_t by, std::string *new_val, char log_type
 }
 
 int SSDB::get(const Bytes &key, std::string *val) const{
+	return this->get(key, val, NULL);
+}
+
+// strip the ttl header of a raw value
+// @return 0: expired, 1: ok
+static int kv_strip_header(ExpirationHandler *expiration, const Bytes &key,
+		std::string *val, int64_t *expire)
+{
+	if(kv_val_has_header(*val)){
+		int64_t e = decode_kv_expire(*val);
+		if(e > 0 && e <= time_ms()){
+			if(expiration){
+				expiration->expired_key(key);
+			}
+			val->clear();
+			return 0;
+		}
+		val->erase(0, KV_TTL_HEADER_SIZE);
+		if(expire){
+			*expire = e;
+		}
+	}
+	return 1;
+}
+
+int SSDB::get(const Bytes &key, std::string *val, int64_t *expire) const{
 	std::string buf = encode_kv_key(key);
 
-	leveldb::Status s = db->Get(leveldb::ReadOptions(), buf, val);
-	if(s.IsNotFound()){
-		return 0;
+	int ret = kv_raw_get(db, buf, val);
+	if(ret != 1 || !kv_ttl_header){
+		return ret;
 	}
-	if(!s.ok()){
-		log_error("get error: %s", s.ToString().c_str());
+	return kv_strip_header(expiration, key, val, expire);
+}
+
+int SSDB::multi_get(const std::vector<Bytes> &keys, int offset, std::vector<std::string> *list) const{
+	std::vector<std::string> bufs;
+	for(int i=offset; i<(int)keys.size(); i++){
+		bufs.push_back(encode_kv_key(keys[i]));
+	}
+	std::vector<std::string> vals;
+	std::vector<bool> found;
+	if(this->batch_get(bufs, &vals, &found) == -1){
 		return -1;
 	}
-	return 1;
+	int num = 0;
+	for(int i=0; i<(int)bufs.size(); i++){
+		const Bytes &key = keys[offset + i];
+		if(!found[i]){
+			continue;
+		}
+		if(kv_ttl_header && kv_strip_header(expiration, key, &vals[i], NULL) == 0){
+			continue;
+		}
+		list->push_back(key.String());
+		list->push_back(vals[i]);
+		num ++;
+	}
+	return num;
 }
 
 KIterator* SSDB::scan(const Bytes &start, const Bytes &end, uint64_t limit) const{
@@ -177,7 +428,7 @@ KIterator* SSDB::scan(const Bytes &start, const Bytes &end, uint64_t limit) cons
 	//dump(key_start.data(), key_start.size(), "scan.start");
 	//dump(key_end.data(), key_end.size(), "scan.end");
 
-	return new KIterator(this->iterator(key_start, key_end, limit));
+	return new KIterator(this->iterator(key_start, key_end, UINT64_MAX), limit, kv_ttl_header);
 }
 
 KIterator* SSDB::rscan(const Bytes &start, const Bytes &end, uint64_t limit) const{
@@ -195,5 +446,5 @@ KIterator* SSDB::rscan(const Bytes &start, const Bytes &end, uint64_t limit) con
 	//dump(key_start.data(), key_start.size(), "scan.start");
 	//dump(key_end.data(), key_end.size(), "scan.end");
 
-	return new KIterator(this->rev_iterator(key_start, key_end, limit));
+	return new KIterator(this->rev_iterator(key_start, key_end, UINT64_MAX), limit, kv_ttl_header);
 }
@@ -23,20 +23,83 @@ int decode_kv_key(const Bytes &slice, std::string *key){
 	return 0;
 }
 
+/**
+ * Inline ttl(leveldb.inline_ttl): a value with an expire time is
+ * prefixed by KV_TTL_MAGIC and the expire time(unix time in ms, 8 bytes
+ * big endian). A plain value which happens to start with the magic is
+ * stored with an expire time of 0(never expires).
+ *
+ * "kv_format" in meta_db records that values may have the header. A db
+ * without it keeps plain values as they are, until it is opened with
+ * inline_ttl, then its plain values starting with the magic are escaped
+ * and the format is recorded. From then on values are decoded and
+ * escaped whatever the option is. A db in this format must not be opened
+ * by an older version, it would return the headers as a part of the
+ * values.
+ */
+#define KV_FORMAT_KEY		"kv_format"
+#define KV_FORMAT			"1"
+#define KV_TTL_MAGIC		"\xff" "TTL"
+#define KV_TTL_MAGIC_SIZE	4
+#define KV_TTL_HEADER_SIZE	(KV_TTL_MAGIC_SIZE + 8)
+
+static inline
+bool kv_val_has_header(const Bytes &raw){
+	return raw.size() >= KV_TTL_HEADER_SIZE
+		&& memcmp(raw.data(), KV_TTL_MAGIC, KV_TTL_MAGIC_SIZE) == 0;
+}
+
+static inline
+std::string encode_kv_val(const Bytes &val, int64_t expire){
+	std::string buf;
+	buf.append(KV_TTL_MAGIC, KV_TTL_MAGIC_SIZE);
+	uint64_t e = big_endian((uint64_t)expire);
+	buf.append((char *)&e, sizeof(uint64_t));
+	buf.append(val.data(), val.size());
+	return buf;
+}
+
+// @return expire time, 0 if the value never expires
+static inline
+int64_t decode_kv_expire(const Bytes &raw){
+	if(!kv_val_has_header(raw)){
+		return 0;
+	}
+	uint64_t e = *((uint64_t *)(raw.data() + KV_TTL_MAGIC_SIZE));
+	return (int64_t)big_endian(e);
+}
+
+// the user value of a stored value
+static inline
+Bytes decode_kv_val(const Bytes &raw){
+	if(!kv_val_has_header(raw)){
+		return raw;
+	}
+	return Bytes(raw.data() + KV_TTL_HEADER_SIZE, raw.size() - KV_TTL_HEADER_SIZE);
+}
+
 
 class KIterator{
 	private:
 		Iterator *it;
 		bool return_val_;
+		int64_t now;
+		uint64_t limit;
+		bool ttl_header;
 	public:
 		std::string key;
 		std::string val;
 		// Bytes raw_key;
 		// Bytes raw_val;
 
-		KIterator(Iterator *it){
+		// expired keys are skipped, they do not count against limit, so
+		// @it is not limited. ttl_header: values may have the ttl header
+		KIterator(Iterator *it, uint64_t limit, bool ttl_header){
 			this->it = it;
 			this->return_val_ = true;
+			this->now = time_ms();
+			this->limit = limit;
+			this->ttl_header = ttl_header;
 		}
 
 		~KIterator(){
@@ -48,6 +111,9 @@ class KIterator{
 		}
 
 		bool next(){
+			if(limit == 0){
+				return false;
+			}
 			while(it->next()){
 				Bytes ks = it->key();
 				Bytes vs = it->val();
@@ -56,12 +122,20 @@ class KIterator{
 				if(ks.data()[0] != DataType::KV){
 					return false;
 				}
+				if(ttl_header){
+					int64_t expire = decode_kv_expire(vs);
+					if(expire > 0 && expire <= now){
+						continue;
+					}
+				}
 				if(decode_kv_key(ks, &this->key) == -1){
 					continue;
 				}
 				if(return_val_){
-					this->val.assign(vs.data(), vs.size());
+					Bytes v = ttl_header? decode_kv_val(vs) : vs;
+					this->val.assign(v.data(), v.size());
 				}
+				limit --;
 				return true;
 			}
 			return  false;
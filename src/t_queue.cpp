@@ -1,6 +1,7 @@
 #include "t_queue.h"
 #include "ssdb.h"
 #include "leveldb/write_batch.h"
+#include "meta_cache.h"
 
 static int qget_by_seq(leveldb::DB* db, const Bytes &name, uint64_t seq, std::string *val){
 	std::string key = encode_qitem_key(name, seq);
@@ -17,9 +18,15 @@ static int qget_by_seq(leveldb::DB* db, const Bytes &name, uint64_t seq, std::st
 	}
 }
 
-static int qget_uint64(leveldb::DB* db, const Bytes &name, uint64_t seq, uint64_t *ret){
+// seq is QFRONT_SEQ or QBACK_SEQ
+static int qget_uint64(leveldb::DB* db, MetaCache *cache, const Bytes &name, uint64_t seq, uint64_t *ret){
 	std::string val;
 	*ret = 0;
+	int64_t cached;
+	if(cache->get(encode_qitem_key(name, seq), &cached) == 1){
+		*ret = (uint64_t)cached;
+		return cached == 0? 0 : 1;
+	}
 	int s = qget_by_seq(db, name, seq, &val);
 	if(s == 1){
 		if(val.size() != sizeof(uint64_t)){
@@ -30,11 +37,23 @@ static int qget_uint64(leveldb::DB* db, const Bytes &name, uint64_t seq, uint64_
 	return s;
 }
 
+// @return 1: found, 0: empty queue, -1: error
+static int qget_front_back(leveldb::DB* db, MetaCache *cache, const Bytes &name, uint64_t *f_seq, uint64_t *b_seq){
+	int ret = qget_uint64(db, cache, name, QFRONT_SEQ, f_seq);
+	if(ret != 1){
+		return ret;
+	}
+	return qget_uint64(db, cache, name, QBACK_SEQ, b_seq);
+}
+
 static int qdel_one(SSDB *ssdb, const Bytes &name, uint64_t seq){
 	std::string key = encode_qitem_key(name, seq);
 	leveldb::Status s;
 
 	ssdb->binlogs->Delete(key);
+	if(seq == QFRONT_SEQ || seq == QBACK_SEQ){
+		ssdb->meta_cache->set(key, 0);
+	}
 	return 0;
 }
 
@@ -43,6 +62,9 @@ static int qset_one(SSDB *ssdb, const Bytes &name, uint64_t seq, const Bytes &it
 	leveldb::Status s;
 
 	ssdb->binlogs->Put(key, item.Slice());
+	if(seq == QFRONT_SEQ || seq == QBACK_SEQ){
+		ssdb->meta_cache->set(key, *(int64_t *)item.data());
+	}
 	return 0;
 }
 
@@ -54,10 +76,15 @@ static int64_t incr_qsize(SSDB *ssdb, const Bytes &name, int64_t incr){
 	size += incr;
 	if(size <= 0){
 		ssdb->binlogs->Delete(encode_qsize_key(name));
+		ssdb->meta_cache->set(encode_qsize_key(name), 0);
 		qdel_one(ssdb, name, QFRONT_SEQ);
 		qdel_one(ssdb, name, QBACK_SEQ);
+		if(ssdb->del_container_ttl(DataType::QSIZE, name) == -1){
+			return -1;
+		}
 	}else{
 		ssdb->binlogs->Put(encode_qsize_key(name), leveldb::Slice((char *)&size, sizeof(size)));
+		ssdb->meta_cache->set(encode_qsize_key(name), size);
 	}
 	return size;
 }
@@ -65,7 +92,15 @@ static int64_t incr_qsize(SSDB *ssdb, const Bytes &name, int64_t incr){
 /****************/
 
 int64_t SSDB::qsize(const Bytes &name){
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
+	}
 	std::string key = encode_qsize_key(name);
+	int64_t size;
+	if(meta_cache->get(key, &size) == 1){
+		return size;
+	}
+
 	std::string val;
 
 	leveldb::Status s;
@@ -85,9 +120,12 @@ int64_t SSDB::qsize(const Bytes &name){
 
 // @return 0: empty queue, 1: item peeked, -1: error
 int SSDB::qfront(const Bytes &name, std::string *item){
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
+	}
 	int ret = 0;
 	uint64_t seq;
-	ret = qget_uint64(this->db, name, QFRONT_SEQ, &seq);
+	ret = qget_uint64(this->db, this->meta_cache, name, QFRONT_SEQ, &seq);
 	if(ret == -1){
 		return -1;
 	}
@@ -100,9 +138,12 @@ int SSDB::qfront(const Bytes &name, std::string *item){
 
 // @return 0: empty queue, 1: item peeked, -1: error
 int SSDB::qback(const Bytes &name, std::string *item){
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
+	}
 	int ret = 0;
 	uint64_t seq;
-	ret = qget_uint64(this->db, name, QBACK_SEQ, &seq);
+	ret = qget_uint64(this->db, this->meta_cache, name, QBACK_SEQ, &seq);
 	if(ret == -1){
 		return -1;
 	}
@@ -113,51 +154,68 @@ int SSDB::qback(const Bytes &name, std::string *item){
 	return ret;
 }
 
-int SSDB::_qpush(const Bytes &name, const Bytes &item, uint64_t front_or_back_seq, char log_type){
+int64_t SSDB::_qpush(const Bytes &name, const std::vector<Bytes> &items, int offset, uint64_t front_or_back_seq, char log_type, uint64_t *first_seq){
+	if(this->clear_expired(DataType::QSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
+	int64_t num = (int64_t)items.size() - offset;
+	if(num <= 0){
+		return this->qsize(name);
+	}
 	int ret;
-	// generate seq
 	uint64_t seq;
-	ret = qget_uint64(this->db, name, front_or_back_seq, &seq);
+	ret = qget_uint64(this->db, this->meta_cache, name, front_or_back_seq, &seq);
 	if(ret == -1){
 		return -1;
 	}
-	// update front and/or back
-	if(ret == 0){
-		seq = QITEM_SEQ_INIT;
-		ret = qset_one(this, name, QFRONT_SEQ, Bytes(&seq, sizeof(seq)));
+	bool front = (front_or_back_seq == QFRONT_SEQ);
+	bool created = (ret == 0);
+	if(created){
+		// new queue, the first item goes to QITEM_SEQ_INIT
+		seq = front? QITEM_SEQ_INIT + 1 : QITEM_SEQ_INIT - 1;
+	}
+	// items take the contiguous seqs next to the front or back
+	uint64_t last = front? seq - num : seq + num;
+	if(first_seq){
+		*first_seq = front? seq - 1 : seq + 1;
+	}
+	if((front && last <= QITEM_MIN_SEQ) || (!front && last >= QITEM_MAX_SEQ)){
+		log_info("queue is full, seq: %" PRIu64 " out of range", last);
+		return -1;
+	}
+
+	for(int64_t i=0; i<num; i++){
+		uint64_t item_seq = front? seq - 1 - i : seq + 1 + i;
+		ret = qset_one(this, name, item_seq, items[offset + i]);
 		if(ret == -1){
 			return -1;
 		}
-		ret = qset_one(this, name, QBACK_SEQ, Bytes(&seq, sizeof(seq)));
-	}else{
-		seq += (front_or_back_seq == QFRONT_SEQ)? -1 : +1;
-		ret = qset_one(this, name, front_or_back_seq, Bytes(&seq, sizeof(seq)));
+		std::string buf = encode_qitem_key(name, item_seq);
+		if(front){
+			binlogs->add_log(log_type, BinlogCommand::QPUSH_FRONT, buf);
+		}else{
+			binlogs->add_log(log_type, BinlogCommand::QPUSH_BACK, buf);
+		}
 	}
+
+	// update front and/or back
+	ret = qset_one(this, name, front_or_back_seq, Bytes(&last, sizeof(last)));
 	if(ret == -1){
 		return -1;
 	}
-	if(seq <= QITEM_MIN_SEQ || seq >= QITEM_MAX_SEQ){
-		log_info("queue is full, seq: %" PRIu64 " out of range", seq);
-		return -1;
+	if(created){
+		// the other end is the first item
+		uint64_t first = QITEM_SEQ_INIT;
+		ret = qset_one(this, name, front? QBACK_SEQ : QFRONT_SEQ, Bytes(&first, sizeof(first)));
 	}
-	
-	// prepend/append item
-	ret = qset_one(this, name, seq, item);
 	if(ret == -1){
 		return -1;
 	}
 
-	std::string buf = encode_qitem_key(name, seq);
-	if(front_or_back_seq == QFRONT_SEQ){
-		binlogs->add_log(log_type, BinlogCommand::QPUSH_FRONT, buf);
-	}else{
-		binlogs->add_log(log_type, BinlogCommand::QPUSH_BACK, buf);
-	}
-	
 	// update size
-	int64_t size = incr_qsize(this, name, +1);
+	int64_t size = incr_qsize(this, name, num);
 	if(size == -1){
 		return -1;
 	}
@@ -167,60 +225,178 @@ int SSDB::_qpush(const Bytes &name, const Bytes &item, uint64_t front_or_back_se
 		log_error("Write error!");
 		return -1;
 	}
-	return 1;
+	return size;
 }
 
 int SSDB::qpush_front(const Bytes &name, const Bytes &item, char log_type){
-	return _qpush(name, item, QFRONT_SEQ, log_type);
+	std::vector<Bytes> items(1, item);
+	if(_qpush(name, items, 0, QFRONT_SEQ, log_type) == -1){
+		return -1;
+	}
+	return 1;
 }
 
 int SSDB::qpush_back(const Bytes &name, const Bytes &item, char log_type){
-	return _qpush(name, item, QBACK_SEQ, log_type);
+	std::vector<Bytes> items(1, item);
+	if(_qpush(name, items, 0, QBACK_SEQ, log_type) == -1){
+		return -1;
+	}
+	return 1;
+}
+
+int64_t SSDB::qpush_front(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type){
+	return _qpush(name, items, offset, QFRONT_SEQ, log_type);
+}
+
+int64_t SSDB::qpush_back(const Bytes &name, const std::vector<Bytes> &items, int offset, char log_type){
+	return _qpush(name, items, offset, QBACK_SEQ, log_type);
 }
 
-int SSDB::_qpop(const Bytes &name, std::string *item, uint64_t front_or_back_seq, char log_type){
+int SSDB::qpush_seq(const Bytes &name, uint64_t seq, const Bytes &item, uint64_t front_or_back_seq, char log_type){
+	if(this->clear_expired(DataType::QSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
-	
-	int ret;
-	uint64_t seq;
-	ret = qget_uint64(this->db, name, front_or_back_seq, &seq);
+
+	bool front = (front_or_back_seq == QFRONT_SEQ);
+	uint64_t f_seq, b_seq;
+	int ret = qget_front_back(this->db, this->meta_cache, name, &f_seq, &b_seq);
 	if(ret == -1){
 		return -1;
 	}
+	if(ret != 0){
+		// not next to the end, the queues differ, pushed as usual
+		if(front && seq != f_seq - 1){
+			seq = f_seq - 1;
+		}else if(!front && seq != b_seq + 1){
+			seq = b_seq + 1;
+		}
+	}
+	if(seq <= QITEM_MIN_SEQ || seq >= QITEM_MAX_SEQ){
+		log_info("queue is full, seq: %" PRIu64 " out of range", seq);
+		return -1;
+	}
 	if(ret == 0){
-		return 0;
+		if(qset_one(this, name, QFRONT_SEQ, Bytes(&seq, sizeof(seq))) == -1){
+			return -1;
+		}
+		if(qset_one(this, name, QBACK_SEQ, Bytes(&seq, sizeof(seq))) == -1){
+			return -1;
+		}
+	}else{
+		if(qset_one(this, name, front_or_back_seq, Bytes(&seq, sizeof(seq))) == -1){
+			return -1;
+		}
+	}
+	if(qset_one(this, name, seq, item) == -1){
+		return -1;
+	}
+	std::string buf = encode_qitem_key(name, seq);
+	if(front){
+		binlogs->add_log(log_type, BinlogCommand::QPUSH_FRONT, buf);
+	}else{
+		binlogs->add_log(log_type, BinlogCommand::QPUSH_BACK, buf);
+	}
+	if(incr_qsize(this, name, +1) == -1){
+		return -1;
+	}
+
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("Write error!");
+		return -1;
+	}
+	return 1;
+}
+
+int64_t SSDB::_qpop(const Bytes &name, int64_t limit, std::vector<std::string> *items, uint64_t front_or_back_seq, char log_type){
+	if(this->clear_expired(DataType::QSIZE, name) == -1){
+		return -1;
 	}
+	Transaction trans(binlogs);
 	
-	ret = qget_by_seq(this->db, name, seq, item);
+	int ret;
+	uint64_t seq;
+	ret = qget_uint64(this->db, this->meta_cache, name, front_or_back_seq, &seq);
 	if(ret == -1){
 		return -1;
 	}
 	if(ret == 0){
 		return 0;
 	}
-
-	// delete item
-	ret = qdel_one(this, name, seq);
-	if(ret == -1){
+	int64_t size = this->qsize(name);
+	if(size == -1){
 		return -1;
 	}
+	if(limit > size){
+		limit = size;
+	}
+	if(limit > QPOP_MAX){
+		limit = QPOP_MAX;
+	}
+	bool front = (front_or_back_seq == QFRONT_SEQ);
 
-	if(front_or_back_seq == QFRONT_SEQ){
-		binlogs->add_log(log_type, BinlogCommand::QPOP_FRONT, name.String());
-	}else{
-		binlogs->add_log(log_type, BinlogCommand::QPOP_BACK, name.String());
+	// the items are read with one point lookup, or one iterator scan
+	int64_t num = 0;
+	if(limit == 1){
+		std::string item;
+		ret = qget_by_seq(this->db, name, seq, &item);
+		if(ret == -1){
+			return -1;
+		}
+		if(ret == 1){
+			items->push_back(item);
+			num = 1;
+		}
+	}else if(limit > 1){
+		Iterator *it;
+		if(front){
+			it = this->iterator(encode_qitem_key(name, seq - 1),
+				encode_qitem_key(name, seq + limit - 1), limit);
+		}else{
+			it = this->rev_iterator(encode_qitem_key(name, seq + 1),
+				encode_qitem_key(name, seq - limit + 1), limit);
+		}
+		while(it->next()){
+			uint64_t s;
+			if(decode_qitem_key(it->key(), NULL, &s) == -1){
+				break;
+			}
+			// stops at the first missing seq
+			if(s != (front? seq + num : seq - num)){
+				break;
+			}
+			items->push_back(it->val().String());
+			num ++;
+		}
+		delete it;
+	}
+	if(num == 0){
+		return 0;
+	}
+
+	// delete items
+	for(int64_t i=0; i<num; i++){
+		ret = qdel_one(this, name, front? seq + i : seq - i);
+		if(ret == -1){
+			return -1;
+		}
+		if(front){
+			binlogs->add_log(log_type, BinlogCommand::QPOP_FRONT, name.String());
+		}else{
+			binlogs->add_log(log_type, BinlogCommand::QPOP_BACK, name.String());
+		}
 	}
 
 	// update size
-	int64_t size = incr_qsize(this, name, -1);
+	size = incr_qsize(this, name, -num);
 	if(size == -1){
 		return -1;
 	}
 		
 	// update front
 	if(size > 0){
-		seq += (front_or_back_seq == QFRONT_SEQ)? +1 : -1;
-		//log_debug("seq: %" PRIu64 ", ret: %d", seq, ret);
+		seq = front? seq + num : seq - num;
 		ret = qset_one(this, name, front_or_back_seq, Bytes(&seq, sizeof(seq)));
 		if(ret == -1){
 			return -1;
@@ -232,16 +408,178 @@ int SSDB::_qpop(const Bytes &name, std::string *item, uint64_t front_or_back_seq
 		log_error("Write error!");
 		return -1;
 	}
-	return 1;
+	return num;
 }
 
 // @return 0: empty queue, 1: item popped, -1: error
 int SSDB::qpop_front(const Bytes &name, std::string *item, char log_type){
-	return _qpop(name, item, QFRONT_SEQ, log_type);
+	std::vector<std::string> items;
+	int64_t ret = _qpop(name, 1, &items, QFRONT_SEQ, log_type);
+	if(ret <= 0){
+		return (int)ret;
+	}
+	*item = items[0];
+	return 1;
 }
 
 int SSDB::qpop_back(const Bytes &name, std::string *item, char log_type){
-	return _qpop(name, item, QBACK_SEQ, log_type);
+	std::vector<std::string> items;
+	int64_t ret = _qpop(name, 1, &items, QBACK_SEQ, log_type);
+	if(ret <= 0){
+		return (int)ret;
+	}
+	*item = items[0];
+	return 1;
+}
+
+int64_t SSDB::qpop_front(const Bytes &name, int64_t limit, std::vector<std::string> *items, char log_type){
+	return _qpop(name, limit, items, QFRONT_SEQ, log_type);
+}
+
+int64_t SSDB::qpop_back(const Bytes &name, int64_t limit, std::vector<std::string> *items, char log_type){
+	return _qpop(name, limit, items, QBACK_SEQ, log_type);
+}
+
+int64_t SSDB::_qtrim(const Bytes &name, int64_t count, uint64_t front_or_back_seq, char log_type){
+	if(this->clear_expired(DataType::QSIZE, name) == -1){
+		return -1;
+	}
+	bool front = (front_or_back_seq == QFRONT_SEQ);
+	int64_t total = 0;
+	while(total < count){
+		Transaction trans(binlogs);
+
+		uint64_t seq;
+		int ret = qget_uint64(this->db, this->meta_cache, name, front_or_back_seq, &seq);
+		if(ret == -1){
+			return -1;
+		}
+		if(ret == 0){
+			break;
+		}
+		int64_t size = this->qsize(name);
+		if(size == -1){
+			return -1;
+		}
+		int64_t num = count - total;
+		if(num > size){
+			num = size;
+		}
+		if(num > TRIM_CHUNK){
+			num = TRIM_CHUNK;
+		}
+		if(num <= 0){
+			break;
+		}
+
+		// the seqs of a queue are contiguous, items are deleted by seq
+		for(int64_t i=0; i<num; i++){
+			ret = qdel_one(this, name, front? seq + i : seq - i);
+			if(ret == -1){
+				return -1;
+			}
+		}
+		size = incr_qsize(this, name, -num);
+		if(size == -1){
+			return -1;
+		}
+		if(size > 0){
+			seq = front? seq + num : seq - num;
+			ret = qset_one(this, name, front_or_back_seq, Bytes(&seq, sizeof(seq)));
+			if(ret == -1){
+				return -1;
+			}
+		}
+		// one record for the whole range
+		if(front){
+			binlogs->add_log(log_type, BinlogCommand::QTRIM_FRONT, encode_qtrim_log(name, num));
+		}else{
+			binlogs->add_log(log_type, BinlogCommand::QTRIM_BACK, encode_qtrim_log(name, num));
+		}
+
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("qtrim error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(size == 0){
+			break;
+		}
+	}
+	if(total > 0){
+		this->add_deletes(DataType::QUEUE, name, total);
+	}
+	return total;
+}
+
+int64_t SSDB::qtrim_front(const Bytes &name, int64_t count, char log_type){
+	return _qtrim(name, count, QFRONT_SEQ, log_type);
+}
+
+int64_t SSDB::qtrim_back(const Bytes &name, int64_t count, char log_type){
+	return _qtrim(name, count, QBACK_SEQ, log_type);
+}
+
+int64_t SSDB::qclear(const Bytes &name, char log_type){
+	std::string key_s = encode_qitem_key(name, QITEM_MIN_SEQ - 1);
+	std::string key_e = encode_qitem_key(name, QITEM_MAX_SEQ);
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
+
+		// items are deleted from the front without reading the queue's
+		// front seq, the queue may have expired
+		int num = 0;
+		uint64_t seq = 0;
+		Iterator *it = this->iterator(key_s, key_e, CLEAR_CHUNK);
+		while(it->next()){
+			if(decode_qitem_key(it->key(), NULL, &seq) == -1){
+				continue;
+			}
+			binlogs->Delete(it->key().Slice());
+			binlogs->add_log(log_type, BinlogCommand::QPOP_FRONT, name.String());
+			num ++;
+		}
+		delete it;
+
+		int64_t size = this->container_size(encode_qsize_key(name));
+		if(size == -1){
+			return -1;
+		}
+		size -= num;
+		if(num < CLEAR_CHUNK || size <= 0){
+			// the last chunk
+			size = 0;
+			binlogs->Delete(encode_qsize_key(name));
+			meta_cache->set(encode_qsize_key(name), 0);
+			qdel_one(this, name, QFRONT_SEQ);
+			qdel_one(this, name, QBACK_SEQ);
+			if(this->del_container_ttl(DataType::QSIZE, name) == -1){
+				return -1;
+			}
+		}else{
+			binlogs->Put(encode_qsize_key(name), leveldb::Slice((char *)&size, sizeof(size)));
+			meta_cache->set(encode_qsize_key(name), size);
+			seq += 1;
+			qset_one(this, name, QFRONT_SEQ, Bytes(&seq, sizeof(seq)));
+		}
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("qclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
+		}
+	}
+	// the groups of a stream go with it
+	if(this->xclear_groups(name, log_type) == -1){
+		return -1;
+	}
+	this->add_deletes(DataType::QUEUE, name, total);
+	return total;
 }
 
 int SSDB::qlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
@@ -301,10 +639,15 @@ int SSDB::qfix(const Bytes &name){
 	
 	if(count == 0){
 		this->binlogs->Delete(encode_qsize_key(name));
+		this->meta_cache->set(encode_qsize_key(name), 0);
 		qdel_one(this, name, QFRONT_SEQ);
 		qdel_one(this, name, QBACK_SEQ);
+		if(this->del_container_ttl(DataType::QSIZE, name) == -1){
+			return -1;
+		}
 	}else{
 		this->binlogs->Put(encode_qsize_key(name), leveldb::Slice((char *)&count, sizeof(count)));
+		this->meta_cache->set(encode_qsize_key(name), count);
 		qset_one(this, name, QFRONT_SEQ, Bytes(&seq_min, sizeof(seq_min)));
 		qset_one(this, name, QBACK_SEQ, Bytes(&seq_max, sizeof(seq_max)));
 	}
@@ -317,71 +660,98 @@ int SSDB::qfix(const Bytes &name){
 	return 0;
 }
 
+// items with seqs in [seq_s, seq_e], by one iterator scan from seq_s
+// (or from seq_e if reverse), at most @limit
+static int qscan_seq(const SSDB *ssdb, const Bytes &name, uint64_t seq_s, uint64_t seq_e,
+		bool reverse, uint64_t limit, std::vector<std::string> *list)
+{
+	if(seq_s > seq_e || limit == 0){
+		return 0;
+	}
+	Iterator *it;
+	if(reverse){
+		it = ssdb->rev_iterator(encode_qitem_key(name, seq_e + 1), encode_qitem_key(name, seq_s), limit);
+	}else{
+		it = ssdb->iterator(encode_qitem_key(name, seq_s - 1), encode_qitem_key(name, seq_e), limit);
+	}
+	while(it->next()){
+		list->push_back(it->val().String());
+	}
+	delete it;
+	return 0;
+}
+
 int SSDB::qslice(const Bytes &name, int64_t begin, int64_t end,
 		std::vector<std::string> *list)
 {
-	int ret;
-	uint64_t seq_begin, seq_end;
-	if(begin >= 0 && end >= 0){
-		uint64_t tmp_seq;
-		ret = qget_uint64(this->db, name, QFRONT_SEQ, &tmp_seq);
-		if(ret != 1){
-			return ret;
-		}
-		seq_begin = tmp_seq + begin;
-		seq_end = tmp_seq + end;
-	}else if(begin < 0 && end < 0){
-		uint64_t tmp_seq;
-		ret = qget_uint64(this->db, name, QBACK_SEQ, &tmp_seq);
-		if(ret != 1){
-			return ret;
-		}
-		seq_begin = tmp_seq + begin + 1;
-		seq_end = tmp_seq + end + 1;
-	}else{
-		uint64_t f_seq, b_seq;
-		ret = qget_uint64(this->db, name, QFRONT_SEQ, &f_seq);
-		if(ret != 1){
-			return ret;
-		}
-		ret = qget_uint64(this->db, name, QBACK_SEQ, &b_seq);
-		if(ret != 1){
-			return ret;
-		}
-		if(begin >= 0){
-			seq_begin = f_seq + begin;
-		}else{
-			seq_begin = b_seq + begin + 1;
-		}
-		if(end >= 0){
-			seq_end = f_seq + end;
-		}else{
-			seq_end = b_seq + end + 1;
-		}
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
 	}
-	
-	for(; seq_begin <= seq_end; seq_begin++){
-		std::string item;
-		ret = qget_by_seq(this->db, name, seq_begin, &item);
-		if(ret == -1){
-			return -1;
-		}
-		if(ret == 0){
-			return 0;
+	uint64_t f_seq, b_seq;
+	int ret = qget_front_back(this->db, this->meta_cache, name, &f_seq, &b_seq);
+	if(ret != 1){
+		return ret;
+	}
+	int64_t size = (int64_t)(b_seq - f_seq + 1);
+	if(begin < 0){
+		begin += size;
+	}
+	if(end < 0){
+		end += size;
+	}
+	if(begin < 0){
+		begin = 0;
+	}
+	if(end >= size){
+		end = size - 1;
+	}
+	if(begin > end){
+		return 0;
+	}
+	return qscan_seq(this, name, f_seq + begin, f_seq + end, false, (uint64_t)-1, list);
+}
+
+int SSDB::qrange(const Bytes &name, int64_t offset, int64_t limit, bool reverse,
+		std::vector<std::string> *list)
+{
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
+	}
+	if(limit <= 0){
+		return 0;
+	}
+	uint64_t f_seq, b_seq;
+	int ret = qget_front_back(this->db, this->meta_cache, name, &f_seq, &b_seq);
+	if(ret != 1){
+		return ret;
+	}
+	int64_t size = (int64_t)(b_seq - f_seq + 1);
+	if(offset < 0){
+		offset += size;
+		if(offset < 0){
+			offset = 0;
 		}
-		list->push_back(item);
 	}
-	return 0;
+	if(offset >= size){
+		return 0;
+	}
+	if(reverse){
+		return qscan_seq(this, name, f_seq, b_seq - offset, true, limit, list);
+	}
+	return qscan_seq(this, name, f_seq + offset, b_seq, false, limit, list);
 }
 
 int SSDB::qget(const Bytes &name, int64_t index, std::string *item){
+	if(this->container_expired(DataType::QSIZE, name)){
+		return 0;
+	}
 	int ret;
 	uint64_t seq;
 	if(index >= 0){
-		ret = qget_uint64(this->db, name, QFRONT_SEQ, &seq);
+		ret = qget_uint64(this->db, this->meta_cache, name, QFRONT_SEQ, &seq);
 		seq += index;
 	}else{
-		ret = qget_uint64(this->db, name, QBACK_SEQ, &seq);
+		ret = qget_uint64(this->db, this->meta_cache, name, QBACK_SEQ, &seq);
 		seq += index + 1;
 	}
 	if(ret == -1){
@@ -56,4 +56,28 @@ int decode_qitem_key(const Bytes &slice, std::string *name, uint64_t *seq){
 	return 0;
 }
 
+// key of a QTRIM_FRONT/QTRIM_BACK binlog: count(8 bytes, big endian) name,
+// seqs differ between master and slaves, so the count is logged
+inline static
+std::string encode_qtrim_log(const Bytes &name, uint64_t count){
+	std::string buf;
+	count = big_endian(count);
+	buf.append((char *)&count, sizeof(uint64_t));
+	buf.append(name.data(), name.size());
+	return buf;
+}
+
+inline static
+int decode_qtrim_log(const Bytes &slice, std::string *name, uint64_t *count){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.read_uint64(count) == -1){
+		return -1;
+	}
+	*count = big_endian(*count);
+	if(decoder.read_data(name) == -1){
+		return -1;
+	}
+	return 0;
+}
+
 #endif
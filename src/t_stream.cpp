@@ -0,0 +1,282 @@
+#include "t_stream.h"
+#include "t_queue.h"
+#include "util/strings.h"
+
+static int check_group(const Bytes &name, const Bytes &group){
+	if(name.empty() || name.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty name or name too long!");
+		return -1;
+	}
+	if(group.empty() || group.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty group or group too long!");
+		return -1;
+	}
+	return 0;
+}
+
+// @return 1: found, 0: new group, -1: error
+static int xgroup_offset(const SSDB *ssdb, const std::string &key, uint64_t *seq){
+	std::string val;
+	int ret = ssdb->raw_get(key, &val, true);
+	if(ret == 1){
+		if(val.size() != sizeof(uint64_t)){
+			log_error("bad stream group offset");
+			return -1;
+		}
+		*seq = *(uint64_t *)val.data();
+	}
+	return ret;
+}
+
+int64_t SSDB::xadd(const Bytes &name, const std::vector<Bytes> &items, int offset, uint64_t *first_id, char log_type){
+	if(name.empty() || name.size() > SSDB_KEY_LEN_MAX){
+		log_error("empty name or name too long!");
+		return -1;
+	}
+	return _qpush(name, items, offset, QBACK_SEQ, log_type, first_id);
+}
+
+int SSDB::xget(const Bytes &name, uint64_t id, std::string *item) const{
+	if(id <= QITEM_MIN_SEQ || id >= QITEM_MAX_SEQ){
+		return 0;
+	}
+	return this->raw_get(encode_qitem_key(name, id), item, true);
+}
+
+int SSDB::xread(const Bytes &name, const Bytes &group, int64_t limit,
+		std::vector<std::string> *list, char log_type)
+{
+	if(check_group(name, group) == -1){
+		return -1;
+	}
+	if(limit <= 0){
+		return 0;
+	}
+	Transaction trans(binlogs);
+
+	std::string gkey = encode_xgroup_key(name, group);
+	// a new group reads from the oldest item
+	uint64_t last = QITEM_MIN_SEQ;
+	if(xgroup_offset(this, gkey, &last) == -1){
+		return -1;
+	}
+	if(last < QITEM_MIN_SEQ){
+		// the queue pointers are not items
+		last = QITEM_MIN_SEQ;
+	}
+
+	int64_t now = time_ms();
+	int num = 0;
+	Iterator *it = this->iterator(encode_qitem_key(name, last),
+		encode_qitem_key(name, QITEM_MAX_SEQ), limit);
+	while(it->next()){
+		uint64_t seq;
+		if(decode_qitem_key(it->key(), NULL, &seq) == -1){
+			break;
+		}
+		list->push_back(uint64_to_str(seq));
+		list->push_back(it->val().String());
+
+		std::string pkey = encode_xpend_key(name, group, seq);
+		binlogs->Put(pkey, leveldb::Slice((char *)&now, sizeof(now)));
+		binlogs->add_log(log_type, BinlogCommand::XSET, pkey);
+		last = seq;
+		num ++;
+	}
+	delete it;
+	if(num == 0){
+		return 0;
+	}
+
+	binlogs->Put(gkey, leveldb::Slice((char *)&last, sizeof(last)));
+	binlogs->add_log(log_type, BinlogCommand::XSET, gkey);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("xread error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return num;
+}
+
+int64_t SSDB::xack(const Bytes &name, const Bytes &group, const std::vector<Bytes> &ids, int offset,
+		char log_type)
+{
+	if(check_group(name, group) == -1){
+		return -1;
+	}
+	Transaction trans(binlogs);
+
+	int64_t num = 0;
+	for(int i=offset; i<(int)ids.size(); i++){
+		std::string pkey = encode_xpend_key(name, group, ids[i].Uint64());
+		std::string val;
+		int ret = this->raw_get(pkey, &val);
+		if(ret == -1){
+			return -1;
+		}
+		if(ret == 0){
+			continue;
+		}
+		binlogs->Delete(pkey);
+		binlogs->add_log(log_type, BinlogCommand::XDEL, pkey);
+		num ++;
+	}
+	if(num == 0){
+		return 0;
+	}
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("xack error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return num;
+}
+
+int SSDB::xpending(const Bytes &name, const Bytes &group, int64_t limit,
+		std::vector<std::string> *list) const
+{
+	if(check_group(name, group) == -1){
+		return -1;
+	}
+	if(limit <= 0){
+		return 0;
+	}
+	Iterator *it = this->iterator(encode_xpend_key(name, group, 0),
+		encode_xpend_key(name, group, (uint64_t)-1), limit);
+	while(it->next()){
+		std::string n, g;
+		uint64_t seq;
+		if(decode_xpend_key(it->key(), &n, &g, &seq) == -1){
+			break;
+		}
+		if(it->val().size() != sizeof(int64_t)){
+			continue;
+		}
+		list->push_back(uint64_to_str(seq));
+		list->push_back(int64_to_str(*(int64_t *)it->val().data()));
+	}
+	delete it;
+	return 0;
+}
+
+int SSDB::xgroup_setid(const Bytes &name, const Bytes &group, uint64_t id, char log_type){
+	if(check_group(name, group) == -1){
+		return -1;
+	}
+	Transaction trans(binlogs);
+
+	std::string gkey = encode_xgroup_key(name, group);
+	binlogs->Put(gkey, leveldb::Slice((char *)&id, sizeof(id)));
+	binlogs->add_log(log_type, BinlogCommand::XSET, gkey);
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("xgroup_setid error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int64_t SSDB::xgroup_del(const Bytes &name, const Bytes &group, char log_type){
+	if(check_group(name, group) == -1){
+		return -1;
+	}
+	std::string start = encode_xpend_key(name, group, 0);
+	std::string end = encode_xpend_key(name, group, (uint64_t)-1);
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
+
+		int num = 0;
+		Iterator *it = this->iterator(start, end, CLEAR_CHUNK);
+		while(it->next()){
+			std::string key = it->key().String();
+			binlogs->Delete(key);
+			binlogs->add_log(log_type, BinlogCommand::XDEL, key);
+			num ++;
+		}
+		delete it;
+		if(num < CLEAR_CHUNK){
+			// the last chunk, with the offset
+			std::string gkey = encode_xgroup_key(name, group);
+			binlogs->Delete(gkey);
+			binlogs->add_log(log_type, BinlogCommand::XDEL, gkey);
+		}
+
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("xgroup_del error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
+		}
+	}
+	return total;
+}
+
+int64_t SSDB::xclear_groups(const Bytes &name, char log_type){
+	std::vector<std::string> prefixes;
+	// 'o', size, name, group
+	prefixes.push_back(encode_xgroup_key(name, ""));
+	// 'r', size, name, size, group, seq
+	prefixes.push_back(encode_xpend_key(name, "", 0).substr(0, 2 + name.size()));
+	int64_t total = 0;
+	for(int i=0; i<(int)prefixes.size(); i++){
+		const std::string &prefix = prefixes[i];
+		while(1){
+			Transaction trans(binlogs);
+
+			int num = 0;
+			Iterator *it = this->iterator(prefix, "", CLEAR_CHUNK);
+			while(it->next()){
+				Bytes ks = it->key();
+				if(ks.size() < (int)prefix.size() || memcmp(ks.data(), prefix.data(), prefix.size()) != 0){
+					break;
+				}
+				binlogs->Delete(ks.Slice());
+				binlogs->add_log(log_type, BinlogCommand::XDEL, ks.Slice());
+				num ++;
+			}
+			delete it;
+			if(num == 0){
+				break;
+			}
+
+			leveldb::Status s = binlogs->commit();
+			if(!s.ok()){
+				log_error("xclear_groups error: %s", s.ToString().c_str());
+				return -1;
+			}
+			total += num;
+			if(num < CLEAR_CHUNK){
+				break;
+			}
+		}
+	}
+	return total;
+}
+
+int SSDB::xset_raw(const Bytes &key, const Bytes &val, char log_type){
+	Transaction trans(binlogs);
+	binlogs->Put(key.Slice(), val.Slice());
+	binlogs->add_log(log_type, BinlogCommand::XSET, key.Slice());
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("xset_raw error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
+
+int SSDB::xdel_raw(const Bytes &key, char log_type){
+	Transaction trans(binlogs);
+	binlogs->Delete(key.Slice());
+	binlogs->add_log(log_type, BinlogCommand::XDEL, key.Slice());
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("xdel_raw error: %s", s.ToString().c_str());
+		return -1;
+	}
+	return 1;
+}
@@ -0,0 +1,72 @@
+#ifndef SSDB_STREAM_H_
+#define SSDB_STREAM_H_
+
+#include "ssdb.h"
+
+/*
+A stream is a queue only appended to by xadd, its items are read with
+range scans and never rewritten. An item id is its queue seq.
+
+Each consumer group of a stream keeps:
+	the offset, seq of the last item delivered to the group
+	a pending entry per item delivered but not yet acked
+*/
+
+inline static
+std::string encode_xgroup_key(const Bytes &name, const Bytes &group){
+	std::string buf;
+	buf.append(1, DataType::XGROUP);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	buf.append(group.data(), group.size());
+	return buf;
+}
+
+inline static
+int decode_xgroup_key(const Bytes &slice, std::string *name, std::string *group){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(name) == -1){
+		return -1;
+	}
+	if(decoder.read_data(group) == -1){
+		return -1;
+	}
+	return 0;
+}
+
+inline static
+std::string encode_xpend_key(const Bytes &name, const Bytes &group, uint64_t seq){
+	std::string buf;
+	buf.append(1, DataType::XPEND);
+	buf.append(1, (uint8_t)name.size());
+	buf.append(name.data(), name.size());
+	buf.append(1, (uint8_t)group.size());
+	buf.append(group.data(), group.size());
+	seq = big_endian(seq);
+	buf.append((char *)&seq, sizeof(uint64_t));
+	return buf;
+}
+
+inline static
+int decode_xpend_key(const Bytes &slice, std::string *name, std::string *group, uint64_t *seq){
+	Decoder decoder(slice.data(), slice.size());
+	if(decoder.skip(1) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(name) == -1){
+		return -1;
+	}
+	if(decoder.read_8_data(group) == -1){
+		return -1;
+	}
+	if(decoder.read_uint64(seq) == -1){
+		return -1;
+	}
+	*seq = big_endian(*seq);
+	return 0;
+}
+
+#endif
@@ -1,6 +1,12 @@
 #include <limits.h>
+#include <algorithm>
 #include "t_zset.h"
+#include "t_kv.h"
+#include "t_dzset.h"
 #include "leveldb/write_batch.h"
+#include "meta_cache.h"
+#include "ztop_cache.h"
+#include "counter.h"
 
 static const char *SSDB_SCORE_MIN		= "-9223372036854775808";
 static const char *SSDB_SCORE_MAX		= "+9223372036854775807";
@@ -8,11 +14,20 @@ static const char *SSDB_SCORE_MAX		= "+9223372036854775807";
 static int zset_one(SSDB *ssdb, const Bytes &name, const Bytes &key, const Bytes &score, char log_type);
 static int zdel_one(SSDB *ssdb, const Bytes &name, const Bytes &key, char log_type);
 static int incr_zsize(SSDB *ssdb, const Bytes &name, int64_t incr);
+static ZIterator* ziterator(
+	const SSDB *ssdb,
+	const Bytes &name, const Bytes &key_start,
+	const Bytes &score_start, const Bytes &score_end,
+	uint64_t limit, Iterator::Direction direction);
+static bool ztop_cached(const SSDB *ssdb, const Bytes &name);
 
 /**
  * @return -1: error, 0: item updated, 1: new item inserted
  */
 int SSDB::zset(const Bytes &name, const Bytes &key, const Bytes &score, char log_type){
+	if(this->clear_expired(DataType::ZSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int ret = zset_one(this, name, key, score, log_type);
@@ -32,6 +47,10 @@ int SSDB::zset(const Bytes &name, const Bytes &key, const Bytes &score, char log
 }
 
 int SSDB::zdel(const Bytes &name, const Bytes &key, char log_type){
+	CounterLocking cl(counters);
+	if(this->clear_expired(DataType::ZSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int ret = zdel_one(this, name, key, log_type);
@@ -47,10 +66,80 @@ int SSDB::zdel(const Bytes &name, const Bytes &key, char log_type){
 			return -1;
 		}
 	}
+	if(counters){
+		counters->drop(encode_zset_key(name, key));
+	}
+	return ret;
+}
+
+int SSDB::zdel_expired(const Bytes &list, const std::vector<std::string> &keys, int64_t now, char log_type){
+	CounterLocking cl(counters);
+	Transaction trans(binlogs);
+
+	int count = 0;
+	std::vector<std::string> deleted;
+	std::vector<std::string>::const_iterator it;
+	for(it = keys.begin(); it != keys.end(); it++){
+		const std::string &key = *it;
+		std::string score;
+		int ret = this->zget(list, key, &score);
+		if(ret == -1){
+			return -1;
+		}
+		if(ret == 0){
+			continue;
+		}
+		int64_t expire = str_to_int64(score);
+		if(expire < 2000000000){
+			// older version compatible
+			expire *= 1000;
+		}
+		if(expire > now){
+			// ttl has been reset
+			continue;
+		}
+		std::string buf = encode_kv_key(key);
+		binlogs->Delete(buf);
+		binlogs->add_log(log_type, BinlogCommand::KDEL, buf);
+		if(zdel_one(this, list, key, log_type) == -1){
+			return -1;
+		}
+		deleted.push_back(buf);
+		count ++;
+	}
+	if(count == 0){
+		return 0;
+	}
+	if(incr_zsize(this, list, -count) == -1){
+		return -1;
+	}
+	leveldb::Status s = binlogs->commit();
+	if(!s.ok()){
+		log_error("zdel_expired error: %s", s.ToString().c_str());
+		return -1;
+	}
+	if(counters){
+		for(int i=0; i<(int)deleted.size(); i++){
+			counters->drop(deleted[i]);
+		}
+	}
+	return count;
+}
+
+int SSDB::zdel_in_trans(const Bytes &name, const Bytes &key, char log_type){
+	int ret = zdel_one(this, name, key, log_type);
+	if(ret > 0){
+		if(incr_zsize(this, name, -ret) == -1){
+			return -1;
+		}
+	}
 	return ret;
 }
 
 int SSDB::zincr(const Bytes &name, const Bytes &key, int64_t by, std::string *new_val, char log_type){
+	if(this->clear_expired(DataType::ZSIZE, name) == -1){
+		return -1;
+	}
 	Transaction trans(binlogs);
 
 	int64_t val;
@@ -142,26 +231,105 @@ int SSDB::zincr(const Bytes &name, const Bytes &key, int64_t by, std::string *ne
 //	return ret;
 //}
 
-int64_t SSDB::zsize(const Bytes &name) const{
+int64_t SSDB::zclear(const Bytes &name, char log_type){
+	CounterLocking cl(counters);
+	if(counters){
+		// they go with the container
+		counters->drop_container(DataType::ZSIZE, name);
+	}
 	std::string size_key = encode_zsize_key(name);
-	std::string val;
-	leveldb::Status s;
+	std::string start = encode_zset_key(name, "");
+	int64_t total = 0;
+	while(1){
+		Transaction trans(binlogs);
 
-	s = db->Get(leveldb::ReadOptions(), size_key, &val);
-	if(s.IsNotFound()){
-		return 0;
-	}else if(!s.ok()){
-		return -1;
-	}else{
-		if(val.size() != sizeof(uint64_t)){
-			return 0;
+		// items are deleted without reading, the zset may have expired
+		int num = 0;
+		Iterator *it = this->iterator(start, "", CLEAR_CHUNK);
+		while(it->next()){
+			Bytes ks = it->key();
+			if(ks.data()[0] != DataType::ZSET){
+				break;
+			}
+			std::string n, key;
+			if(decode_zset_key(ks, &n, &key) == -1){
+				continue;
+			}
+			if(n != name){
+				break;
+			}
+			binlogs->Delete(encode_zscore_key(name, key, it->val()));
+			binlogs->Delete(ks.Slice());
+			binlogs->add_log(log_type, BinlogCommand::ZDEL, ks.Slice());
+			num ++;
+		}
+		delete it;
+
+		int64_t size = this->container_size(size_key);
+		if(size == -1){
+			return -1;
+		}
+		size -= num;
+		if(num < CLEAR_CHUNK || size <= 0){
+			// the last chunk
+			size = 0;
+			binlogs->Delete(size_key);
+			if(this->del_container_ttl(DataType::ZSIZE, name) == -1){
+				return -1;
+			}
+		}else{
+			binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
+		}
+		meta_cache->set(size_key, size);
+		if(ztop_cache){
+			ztop_cache->reset(name);
 		}
-		int64_t ret = *(int64_t *)val.data();
-		return ret < 0? 0 : ret;
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("zclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+		total += num;
+		if(num < CLEAR_CHUNK){
+			break;
+		}
+	}
+
+	// score keys left by a write racing with expiration
+	while(1){
+		Transaction trans(binlogs);
+		int num = 0;
+		ZIterator *it = ziterator(this, name, "", "", "", CLEAR_CHUNK, Iterator::FORWARD);
+		while(it->next()){
+			binlogs->Delete(encode_zscore_key(name, it->key, it->score));
+			num ++;
+		}
+		delete it;
+		if(num == 0){
+			break;
+		}
+		leveldb::Status s = binlogs->commit();
+		if(!s.ok()){
+			log_error("zclear error: %s", s.ToString().c_str());
+			return -1;
+		}
+	}
+
+	this->add_deletes(DataType::ZSET, name, total);
+	return total;
+}
+
+int64_t SSDB::zsize(const Bytes &name) const{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return 0;
 	}
+	return this->container_size(encode_zsize_key(name));
 }
 
 int SSDB::zget(const Bytes &name, const Bytes &key, std::string *score) const{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return 0;
+	}
 	std::string buf = encode_zset_key(name, key);
 	leveldb::Status s = db->Get(leveldb::ReadOptions(), buf, score);
 	if(s.IsNotFound()){
@@ -174,6 +342,33 @@ int SSDB::zget(const Bytes &name, const Bytes &key, std::string *score) const{
 	return 1;
 }
 
+int SSDB::multi_zget(const Bytes &name, const std::vector<Bytes> &keys, int offset,
+		std::vector<std::string> *list) const
+{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return 0;
+	}
+	// keys of one container share a prefix, and are mostly in the same blocks
+	std::vector<std::string> bufs;
+	for(int i=offset; i<(int)keys.size(); i++){
+		bufs.push_back(encode_zset_key(name, keys[i]));
+	}
+	std::vector<std::string> vals;
+	std::vector<bool> found;
+	if(this->batch_get(bufs, &vals, &found) == -1){
+		return -1;
+	}
+	int num = 0;
+	for(int i=0; i<(int)bufs.size(); i++){
+		if(found[i]){
+			list->push_back(keys[offset + i].String());
+			list->push_back(vals[i]);
+			num ++;
+		}
+	}
+	return num;
+}
+
 static ZIterator* ziterator(
 	const SSDB *ssdb,
 	const Bytes &name, const Bytes &key_start,
@@ -210,6 +405,13 @@ static ZIterator* ziterator(
 }
 
 int64_t SSDB::zrank(const Bytes &name, const Bytes &key) const{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return -1;
+	}
+	int64_t rank;
+	if(ztop_cached(this, name) && ztop_cache->rank(name, key, false, &rank) == 1){
+		return rank;
+	}
 	ZIterator *it = ziterator(this, name, "", "", "", INT_MAX, Iterator::FORWARD);
 	uint64_t ret = 0;
 	while(true){
@@ -227,6 +429,13 @@ int64_t SSDB::zrank(const Bytes &name, const Bytes &key) const{
 }
 
 int64_t SSDB::zrrank(const Bytes &name, const Bytes &key) const{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return -1;
+	}
+	int64_t rank;
+	if(ztop_cached(this, name) && ztop_cache->rank(name, key, true, &rank) == 1){
+		return rank;
+	}
 	ZIterator *it = ziterator(this, name, "", "", "", INT_MAX, Iterator::BACKWARD);
 	uint64_t ret = 0;
 	while(true){
@@ -243,7 +452,50 @@ int64_t SSDB::zrrank(const Bytes &name, const Bytes &key) const{
 	return ret;
 }
 
+// loads the windows of a cached zset if they are not loaded
+// @return whether @name is cached and not expired
+static bool ztop_cached(const SSDB *ssdb, const Bytes &name){
+	ZTopCache *cache = ssdb->ztop_cache;
+	if(cache == NULL || !cache->cached(name)){
+		return false;
+	}
+	if(cache->loaded(name)){
+		return true;
+	}
+	uint64_t gen = cache->loading(name);
+	std::vector<std::string> head, tail;
+	ZIterator *it = ziterator(ssdb, name, "", "", "", cache->top_size(), Iterator::FORWARD);
+	while(it->next()){
+		head.push_back(it->key.String());
+		head.push_back(int64_to_str(it->score));
+	}
+	delete it;
+	it = ziterator(ssdb, name, "", "", "", cache->top_size(), Iterator::BACKWARD);
+	while(it->next()){
+		tail.push_back(it->key.String());
+		tail.push_back(int64_to_str(it->score));
+	}
+	delete it;
+	cache->load(name, gen, head, tail);
+	return true;
+}
+
+int SSDB::zrange_cached(const Bytes &name, uint64_t offset, uint64_t limit, bool reverse,
+		std::vector<std::string> *list) const
+{
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return 0;
+	}
+	if(!ztop_cached(this, name)){
+		return 0;
+	}
+	return ztop_cache->range(name, offset, limit, reverse, list) == 1? 1 : 0;
+}
+
 ZIterator* SSDB::zrange(const Bytes &name, uint64_t offset, uint64_t limit){
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return new ZIterator(this->iterator("", "", 0), name);
+	}
 	if(offset + limit > limit){
 		limit = offset + limit;
 	}
@@ -253,6 +505,9 @@ ZIterator* SSDB::zrange(const Bytes &name, uint64_t offset, uint64_t limit){
 }
 
 ZIterator* SSDB::zrrange(const Bytes &name, uint64_t offset, uint64_t limit){
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return new ZIterator(this->iterator("", "", 0), name);
+	}
 	if(offset + limit > limit){
 		limit = offset + limit;
 	}
@@ -264,6 +519,9 @@ ZIterator* SSDB::zrrange(const Bytes &name, uint64_t offset, uint64_t limit){
 ZIterator* SSDB::zscan(const Bytes &name, const Bytes &key,
 		const Bytes &score_start, const Bytes &score_end, uint64_t limit) const
 {
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return new ZIterator(this->iterator("", "", 0), name);
+	}
 	std::string score;
 	// if only key is specified, load its value
 	if(!key.empty() && score_start.empty()){
@@ -306,6 +564,9 @@ ZIterator* SSDB::zscan(const Bytes &name, const Bytes &key,
 ZIterator* SSDB::zrscan(const Bytes &name, const Bytes &key,
 		const Bytes &score_start, const Bytes &score_end, uint64_t limit) const
 {
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return new ZIterator(this->iterator("", "", 0), name);
+	}
 	std::string score;
 	// if only key is specified, load its value
 	if(!key.empty() && score_start.empty()){
@@ -370,11 +631,556 @@ int SSDB::zlist(const Bytes &name_s, const Bytes &name_e, uint64_t limit,
 	return 0;
 }
 
-static std::string filter_score(const Bytes &score){
-	int64_t s = score.Int64();
-	char buf[32];
-	snprintf(buf, sizeof(buf), "%" PRId64 "", s);
-	return std::string(buf);
+/* lex range */
+
+// "-", "+", "[key" or "(key"
+// @return -1: bad bound
+static int parse_lex_bound(const Bytes &s, char *type, Bytes *key){
+	if(s.size() == 1 && (s.data()[0] == '-' || s.data()[0] == '+')){
+		*type = s.data()[0];
+		*key = Bytes("");
+		return 0;
+	}
+	if(s.size() >= 1 && (s.data()[0] == '[' || s.data()[0] == '(')){
+		*type = s.data()[0];
+		*key = Bytes(s.data() + 1, s.size() - 1);
+		return 0;
+	}
+	return -1;
+}
+
+/**
+ * Scans the score keys of one score from @start, members from @min_type
+ * on, up to @end(the same score and the max member), members start after
+ * @head bytes of a key.
+ */
+static int64_t lex_scan(leveldb::Iterator *it, const std::string &start, std::string end,
+		char min_type, char max_type, int head,
+		uint64_t offset, uint64_t limit, std::vector<std::string> *list)
+{
+	if(max_type == '+'){
+		// after every member of the score, '>' follows '='
+		end[end.size() - 1] = '>';
+	}
+	it->Seek(start);
+	if(min_type == '(' && it->Valid() && it->key() == start){
+		it->Next();
+	}
+	int64_t num = 0;
+	for(; it->Valid(); it->Next()){
+		leveldb::Slice ks = it->key();
+		int r = ks.compare(end);
+		if(r > 0 || (r == 0 && max_type == '(')){
+			break;
+		}
+		if(offset > 0){
+			offset --;
+			continue;
+		}
+		if(list){
+			if(ks.size() < (size_t)head){
+				continue;
+			}
+			list->push_back(std::string(ks.data() + head, ks.size() - head));
+		}
+		num ++;
+		if((uint64_t)num == limit){
+			break;
+		}
+	}
+	return num;
+}
+
+int64_t SSDB::zrangebylex(const Bytes &name, const Bytes &min, const Bytes &max, const Bytes &score,
+		uint64_t offset, uint64_t limit, std::vector<std::string> *list) const
+{
+	char min_type, max_type;
+	Bytes min_key, max_key;
+	if(parse_lex_bound(min, &min_type, &min_key) == -1 || parse_lex_bound(max, &max_type, &max_key) == -1){
+		return -2;
+	}
+	int64_t s = 0;
+	if(!score.empty() && str_to_score(score, &s) == -1){
+		return -2;
+	}
+	if(min_type == '+' || max_type == '-' || limit == 0){
+		return 0;
+	}
+	if(this->container_expired(DataType::ZSIZE, name)){
+		return 0;
+	}
+
+	leveldb::ReadOptions iterate_options;
+	iterate_options.fill_cache = false;
+	leveldb::Iterator *it = db->NewIterator(iterate_options);
+
+	if(score.empty()){
+		// members of a lex range share one score, take the lowest
+		std::string first = encode_zscore_key(name, "", INT64_MIN);
+		it->Seek(first);
+		Bytes key;
+		// type, len, name
+		int size = 2 + name.size();
+		if(!it->Valid() || it->key().size() <= (size_t)size
+			|| memcmp(it->key().data(), first.data(), size) != 0
+			|| decode_zscore_key(it->key(), &key, &s) == -1)
+		{
+			delete it;
+			return 0;
+		}
+	}
+
+	// all score keys of the range start with the same bytes, then sort
+	// by member: type, len, name, sign, score, =
+	int head = 2 + name.size() + 1 + sizeof(int64_t) + 1;
+	int64_t num = lex_scan(it, encode_zscore_key(name, min_key, s), encode_zscore_key(name, max_key, s),
+		min_type, max_type, head, offset, limit, list);
+	delete it;
+	return num;
+}
+
+int64_t SSDB::dzrangebylex(const Bytes &name, const Bytes &min, const Bytes &max, const Bytes &score,
+		uint64_t offset, uint64_t limit, std::vector<std::string> *list) const
+{
+	char min_type, max_type;
+	Bytes min_key, max_key;
+	if(parse_lex_bound(min, &min_type, &min_key) == -1 || parse_lex_bound(max, &max_type, &max_key) == -1){
+		return -2;
+	}
+	double d = 0;
+	if(!score.empty() && str_to_dzscore(score, &d) == -1){
+		return -2;
+	}
+	if(min_type == '+' || max_type == '-' || limit == 0){
+		return 0;
+	}
+
+	leveldb::ReadOptions iterate_options;
+	iterate_options.fill_cache = false;
+	leveldb::Iterator *it = db->NewIterator(iterate_options);
+
+	if(score.empty()){
+		// the lowest score, as in zrangebylex
+		std::string first = encode_dzscore_key(name, "", 0);
+		it->Seek(first);
+		Bytes key;
+		int size = 2 + name.size();
+		if(!it->Valid() || it->key().size() <= (size_t)size
+			|| memcmp(it->key().data(), first.data(), size) != 0
+			|| decode_dzscore_key(it->key(), &key, &d) == -1)
+		{
+			delete it;
+			return 0;
+		}
+	}
+	uint64_t u = encode_dzscore(d);
+
+	// type, len, name, score, =
+	int head = 2 + name.size() + sizeof(uint64_t) + 1;
+	int64_t num = lex_scan(it, encode_dzscore_key(name, min_key, u), encode_dzscore_key(name, max_key, u),
+		min_type, max_type, head, offset, limit, list);
+	delete it;
+	return num;
+}
+
+/* set algebra */
+
+// tries Next() this many times before a Seek() when a cursor jumps ahead
+static const int ZCURSOR_NEXT_STEPS = 8;
+
+/**
+ * Members of one zset in the order of their zset keys(by key length, then
+ * by bytes), which is the same for all zsets, so cursors of several zsets
+ * can be merged. member is the encoded key(length, key) in the zset key,
+ * valid until the cursor moves.
+ */
+class ZMemberCursor{
+	private:
+		leveldb::Iterator *it;
+		std::string prefix;
+
+		void load(){
+			valid = false;
+			if(it == NULL || !it->Valid()){
+				return;
+			}
+			Bytes ks = it->key();
+			if(ks.size() <= (int)prefix.size() || memcmp(ks.data(), prefix.data(), prefix.size()) != 0){
+				return;
+			}
+			member = Bytes(ks.data() + prefix.size(), ks.size() - prefix.size());
+			score = str_to_int64(it->value().data(), it->value().size());
+			valid = true;
+		}
+	public:
+		bool valid;
+		Bytes member;
+		int64_t score;
+		int64_t weight;
+		int64_t size;
+
+		// it: NULL for an empty or expired zset
+		ZMemberCursor(leveldb::Iterator *it, const Bytes &name, int64_t weight, int64_t size){
+			this->it = it;
+			this->weight = weight;
+			this->size = size;
+			// encode_zset_key(name, "") ends with the length 0 of the key
+			std::string start = encode_zset_key(name, "");
+			prefix = start.substr(0, start.size() - 1);
+			if(it){
+				it->Seek(start);
+			}
+			load();
+		}
+
+		~ZMemberCursor(){
+			delete it;
+		}
+
+		void next(){
+			it->Next();
+			load();
+		}
+
+		// moves to the first member not less than @target, which is usually
+		// near, so a few Next() are tried before a Seek()
+		void seek(const Bytes &target){
+			for(int step=0; valid && member.compare(target) < 0; step++){
+				if(step == ZCURSOR_NEXT_STEPS){
+					std::string key = prefix;
+					key.append(target.data(), target.size());
+					it->Seek(key);
+					load();
+					return;
+				}
+				this->next();
+			}
+		}
+};
+
+struct ZMemberCursorGreater{
+	bool operator()(const ZMemberCursor *a, const ZMemberCursor *b) const{
+		return a->member.compare(b->member) > 0;
+	}
+};
+
+struct ZMemberCursorSmaller{
+	bool operator()(const ZMemberCursor *a, const ZMemberCursor *b) const{
+		return a->size < b->size;
+	}
+};
+
+/**
+ * Collects the members of a zsetop result, puts them into @dest in the
+ * transaction of the caller, or appends them to @list if @dest is empty.
+ * dest has been cleared in the same transaction, so members are put
+ * without reading their old scores.
+ */
+class ZOpResult{
+	private:
+		SSDB *ssdb;
+		Bytes dest;
+		std::vector<std::string> *list;
+		char log_type;
+	public:
+		int64_t count;
+
+		ZOpResult(SSDB *ssdb, const Bytes &dest, std::vector<std::string> *list, char log_type){
+			this->ssdb = ssdb;
+			this->dest = dest;
+			this->list = list;
+			this->log_type = log_type;
+			this->count = 0;
+		}
+
+		// member: as in ZMemberCursor
+		int add(const Bytes &member, int64_t score){
+			count ++;
+			std::string key(member.data() + 1, member.size() - 1);
+			if(dest.empty()){
+				list->push_back(key);
+				list->push_back(int64_to_str(score));
+				return 0;
+			}
+			ssdb->binlogs->Put(encode_zscore_key(dest, key, score), "");
+			std::string k0 = encode_zset_key(dest, key);
+			ssdb->binlogs->Put(k0, int64_to_str(score));
+			ssdb->binlogs->add_log(log_type, BinlogCommand::ZSET, k0);
+			return 0;
+		}
+};
+
+// scores saturate at the int64 range, as str_to_int64() does
+static inline int64_t zscore_add(int64_t a, int64_t b){
+	if(b > 0 && a > INT64_MAX - b){
+		return INT64_MAX;
+	}
+	if(b < 0 && a < INT64_MIN - b){
+		return INT64_MIN;
+	}
+	return a + b;
+}
+
+static inline int64_t zscore_mul(int64_t a, int64_t b){
+	if(a == 0 || b == 0){
+		return 0;
+	}
+	bool neg = (a < 0) != (b < 0);
+	uint64_t ua = a < 0? 0 - (uint64_t)a : (uint64_t)a;
+	uint64_t ub = b < 0? 0 - (uint64_t)b : (uint64_t)b;
+	uint64_t max = neg? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	if(ua > max / ub){
+		return neg? INT64_MIN : INT64_MAX;
+	}
+	uint64_t r = ua * ub;
+	return neg? (int64_t)(0 - r) : (int64_t)r;
+}
+
+static inline int64_t zaggregate(char aggr, int64_t a, int64_t b){
+	if(aggr == 'n'){
+		return a < b? a : b;
+	}
+	if(aggr == 'x'){
+		return a > b? a : b;
+	}
+	return zscore_add(a, b);
+}
+
+// streaming k-way merge, a member is read once from each zset having it
+static int zunion_cursors(std::vector<ZMemberCursor *> &cursors, char aggr, ZOpResult *result){
+	ZMemberCursorGreater greater;
+	std::vector<ZMemberCursor *> heap;
+	for(int i=0; i<(int)cursors.size(); i++){
+		if(cursors[i]->valid){
+			heap.push_back(cursors[i]);
+		}
+	}
+	std::make_heap(heap.begin(), heap.end(), greater);
+	std::string member;
+	while(!heap.empty()){
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		ZMemberCursor *c = heap.back();
+		member.assign(c->member.data(), c->member.size());
+		int64_t score = zscore_mul(c->score, c->weight);
+		while(1){
+			c->next();
+			if(c->valid){
+				std::push_heap(heap.begin(), heap.end(), greater);
+			}else{
+				heap.pop_back();
+			}
+			if(heap.empty() || heap.front()->member != member){
+				break;
+			}
+			std::pop_heap(heap.begin(), heap.end(), greater);
+			c = heap.back();
+			score = zaggregate(aggr, score, zscore_mul(c->score, c->weight));
+		}
+		if(result->add(member, score) == -1){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// leapfrog join, the smallest zset drives, and each cursor seeks to the
+// member of the other, so runs of members missing in a zset are skipped
+static int zinter_cursors(std::vector<ZMemberCursor *> &cursors, char aggr, ZOpResult *result){
+	std::vector<ZMemberCursor *> cs = cursors;
+	std::sort(cs.begin(), cs.end(), ZMemberCursorSmaller());
+	ZMemberCursor *driver = cs[0];
+	while(driver->valid){
+		bool matched = true;
+		for(int i=1; i<(int)cs.size(); i++){
+			cs[i]->seek(driver->member);
+			if(!cs[i]->valid){
+				return 0;
+			}
+			if(cs[i]->member != driver->member){
+				driver->seek(cs[i]->member);
+				matched = false;
+				break;
+			}
+		}
+		if(!matched){
+			continue;
+		}
+		int64_t score = zscore_mul(driver->score, driver->weight);
+		for(int i=1; i<(int)cs.size(); i++){
+			score = zaggregate(aggr, score, zscore_mul(cs[i]->score, cs[i]->weight));
+		}
+		if(result->add(driver->member, score) == -1){
+			return -1;
+		}
+		driver->next();
+	}
+	return 0;
+}
+
+// members of the first zset in none of the others, with their scores
+static int zdiff_cursors(std::vector<ZMemberCursor *> &cursors, ZOpResult *result){
+	ZMemberCursor *driver = cursors[0];
+	while(driver->valid){
+		bool found = false;
+		for(int i=1; i<(int)cursors.size(); i++){
+			cursors[i]->seek(driver->member);
+			if(cursors[i]->valid && cursors[i]->member == driver->member){
+				found = true;
+				break;
+			}
+		}
+		if(!found){
+			if(result->add(driver->member, driver->score) == -1){
+				return -1;
+			}
+		}
+		driver->next();
+	}
+	return 0;
+}
+
+static int zsetop_merge(char o, char aggr, std::vector<ZMemberCursor *> &cursors, ZOpResult *result){
+	if(o == 'u'){
+		return zunion_cursors(cursors, aggr, result);
+	}else if(o == 'i'){
+		return zinter_cursors(cursors, aggr, result);
+	}else{
+		return zdiff_cursors(cursors, result);
+	}
+}
+
+/**
+ * Replaces @dest by the result in one transaction: the items and ttl of
+ * dest, and score keys left by a write racing with expiration, are
+ * deleted, then the result is put. Readers never see dest half written.
+ */
+static int zsetop_store(SSDB *ssdb, const Bytes &dest, char o, char aggr,
+		std::vector<ZMemberCursor *> &cursors, ZOpResult *result, char log_type)
+{
+	CounterLocking cl(ssdb->counters);
+	if(ssdb->counters){
+		ssdb->counters->drop_container(DataType::ZSIZE, dest);
+	}
+	Transaction trans(ssdb->binlogs);
+
+	int64_t num = 0;
+	Iterator *it = ssdb->iterator(encode_zset_key(dest, ""), "", -1);
+	while(it->next()){
+		Bytes ks = it->key();
+		if(ks.data()[0] != DataType::ZSET){
+			break;
+		}
+		std::string n, key;
+		if(decode_zset_key(ks, &n, &key) == -1){
+			continue;
+		}
+		if(n != dest){
+			break;
+		}
+		ssdb->binlogs->Delete(ks.Slice());
+		ssdb->binlogs->add_log(log_type, BinlogCommand::ZDEL, ks.Slice());
+		num ++;
+	}
+	delete it;
+	ZIterator *zit = ziterator(ssdb, dest, "", "", "", -1, Iterator::FORWARD);
+	while(zit->next()){
+		ssdb->binlogs->Delete(encode_zscore_key(dest, zit->key, zit->score));
+	}
+	delete zit;
+
+	if(zsetop_merge(o, aggr, cursors, result) == -1){
+		return -1;
+	}
+
+	std::string size_key = encode_zsize_key(dest);
+	if(result->count == 0){
+		ssdb->binlogs->Delete(size_key);
+	}else{
+		ssdb->binlogs->Put(size_key, leveldb::Slice((char *)&result->count, sizeof(int64_t)));
+	}
+	ssdb->meta_cache->set(size_key, result->count);
+	if(ssdb->ztop_cache){
+		ssdb->ztop_cache->reset(dest);
+	}
+	// as redis, the result does not inherit the ttl of dest
+	if(ssdb->del_container_ttl(DataType::ZSIZE, dest) == -1){
+		return -1;
+	}
+	leveldb::Status s = ssdb->binlogs->commit();
+	if(!s.ok()){
+		log_error("zsetop error: %s", s.ToString().c_str());
+		return -1;
+	}
+	ssdb->add_deletes(DataType::ZSET, dest, num);
+	return 0;
+}
+
+int64_t SSDB::zsetop(const std::string &op, const Bytes &dest, const std::vector<Bytes> &names, int offset,
+		const std::vector<int64_t> &weights, const std::string &aggregate,
+		std::vector<std::string> *list, char log_type)
+{
+	char o, aggr;
+	if(op == "union"){
+		o = 'u';
+	}else if(op == "inter"){
+		o = 'i';
+	}else if(op == "diff"){
+		o = 'd';
+	}else{
+		return -2;
+	}
+	if(aggregate.empty() || aggregate == "sum"){
+		aggr = 's';
+	}else if(aggregate == "min"){
+		aggr = 'n';
+	}else if(aggregate == "max"){
+		aggr = 'x';
+	}else{
+		return -2;
+	}
+	int num = (int)names.size() - offset;
+	if(num < 1 || (!weights.empty() && (int)weights.size() != num)){
+		return -2;
+	}
+	if(dest.size() > SSDB_KEY_LEN_MAX){
+		return -2;
+	}
+
+	// each iterator reads the db as of its creation, and dest is written
+	// at the end, so dest may be one of the sources
+	int ret = 0;
+	std::vector<ZMemberCursor *> cursors;
+	for(int i=offset; i<(int)names.size(); i++){
+		const Bytes &name = names[i];
+		int64_t weight = weights.empty()? 1 : weights[i - offset];
+		int64_t size = this->zsize(name);
+		if(size == -1){
+			ret = -1;
+		}
+		leveldb::Iterator *it = NULL;
+		if(size > 0){
+			leveldb::ReadOptions iterate_options;
+			iterate_options.fill_cache = false;
+			it = db->NewIterator(iterate_options);
+		}
+		cursors.push_back(new ZMemberCursor(it, name, weight, size));
+	}
+
+	ZOpResult result(this, dest, list, log_type);
+	if(ret == 0){
+		if(dest.empty()){
+			ret = zsetop_merge(o, aggr, cursors, &result);
+		}else{
+			ret = zsetop_store(this, dest, o, aggr, cursors, &result, log_type);
+		}
+	}
+	for(int i=0; i<(int)cursors.size(); i++){
+		delete cursors[i];
+	}
+	if(ret == -1){
+		return -1;
+	}
+	return result.count;
 }
 
 // returns the number of newly added items
@@ -392,7 +1198,9 @@ static int zset_one(SSDB *ssdb, const Bytes &name, const Bytes &key, const Bytes
 		log_error("key too long!");
 		return -1;
 	}
-	std::string new_score = filter_score(score);
+	// scores are stored in canonical form, parsed and formatted once
+	int64_t new_s = score.Int64();
+	std::string new_score = int64_to_str(new_s);
 	std::string old_score;
 	int found = ssdb->zget(name, key, &old_score);
 	if(found == 0 || old_score != new_score){
@@ -405,13 +1213,16 @@ static int zset_one(SSDB *ssdb, const Bytes &name, const Bytes &key, const Bytes
 		}
 
 		// add zscore key
-		k2 = encode_zscore_key(name, key, new_score);
+		k2 = encode_zscore_key(name, key, new_s);
 		ssdb->binlogs->Put(k2, "");
 
 		// update zset
 		k0 = encode_zset_key(name, key);
 		ssdb->binlogs->Put(k0, new_score);
 		ssdb->binlogs->add_log(log_type, BinlogCommand::ZSET, k0);
+		if(ssdb->ztop_cache){
+			ssdb->ztop_cache->set(name, key, new_score);
+		}
 
 		return found? 0 : 1;
 	}
@@ -442,18 +1253,28 @@ static int zdel_one(SSDB *ssdb, const Bytes &name, const Bytes &key, char log_ty
 	k0 = encode_zset_key(name, key);
 	ssdb->binlogs->Delete(k0);
 	ssdb->binlogs->add_log(log_type, BinlogCommand::ZDEL, k0);
+	if(ssdb->ztop_cache){
+		ssdb->ztop_cache->del(name, key);
+	}
 
 	return 1;
 }
 
 static int incr_zsize(SSDB *ssdb, const Bytes &name, int64_t incr){
 	int64_t size = ssdb->zsize(name);
+	if(size == -1){
+		return -1;
+	}
 	size += incr;
 	std::string size_key = encode_zsize_key(name);
 	if(size == 0){
 		ssdb->binlogs->Delete(size_key);
+		if(ssdb->del_container_ttl(DataType::ZSIZE, name) == -1){
+			return -1;
+		}
 	}else{
 		ssdb->binlogs->Put(size_key, leveldb::Slice((char *)&size, sizeof(int64_t)));
 	}
+	ssdb->meta_cache->set(size_key, size);
 	return 0;
 }
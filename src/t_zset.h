@@ -8,6 +8,28 @@
 #define encode_score(s) big_endian((uint64_t)(s))
 #define decode_score(s) big_endian((uint64_t)(s))
 
+/**
+ * Parse an integer score, spaces are not skipped.
+ * @return -1: not an integer, or out of the int64 range
+ */
+static inline
+int str_to_score(const Bytes &s, int64_t *score){
+	char buf[32];
+	if(s.empty() || s.size() >= (int)sizeof(buf) || isspace(s.data()[0])){
+		return -1;
+	}
+	memcpy(buf, s.data(), s.size());
+	buf[s.size()] = '\0';
+	char *end;
+	errno = 0;
+	long long v = strtoll(buf, &end, 10);
+	if(end != buf + s.size() || errno == ERANGE){
+		return -1;
+	}
+	*score = (int64_t)v;
+	return 0;
+}
+
 static inline
 std::string encode_zsize_key(const Bytes &name){
 	std::string buf;
@@ -56,13 +78,13 @@ int decode_zset_key(const Bytes &slice, std::string *name, std::string *key){
 
 // type, len, key, score, =, val
 static inline
-std::string encode_zscore_key(const Bytes &key, const Bytes &val, const Bytes &score){
+std::string encode_zscore_key(const Bytes &key, const Bytes &val, int64_t s){
 	std::string buf;
+	buf.reserve(1 + 1 + key.size() + 1 + sizeof(int64_t) + 1 + val.size());
 	buf.append(1, DataType::ZSCORE);
 	buf.append(1, (uint8_t)key.size());
 	buf.append(key.data(), key.size());
 
-	int64_t s = score.Int64();
 	if(s < 0){
 		buf.append(1, '-');
 	}else{
@@ -76,6 +98,11 @@ std::string encode_zscore_key(const Bytes &key, const Bytes &val, const Bytes &s
 	return buf;
 }
 
+static inline
+std::string encode_zscore_key(const Bytes &key, const Bytes &val, const Bytes &score){
+	return encode_zscore_key(key, val, score.Int64());
+}
+
 static inline
 int decode_zscore_key(const Bytes &slice, std::string *name, std::string *key, std::string *score){
 	Decoder decoder(slice.data(), slice.size());
@@ -93,10 +120,7 @@ int decode_zscore_key(const Bytes &slice, std::string *name, std::string *key, s
 		return -1;
 	}else{
 		if(score != NULL){
-			s = decode_score(s);
-			char buf[21] = {0};
-			snprintf(buf, sizeof(buf), "%" PRId64 "", s);
-			score->assign(buf);
+			*score = int64_to_str(decode_score(s));
 		}
 	}
 	if(decoder.skip(1) == -1){
@@ -108,18 +132,42 @@ int decode_zscore_key(const Bytes &slice, std::string *name, std::string *key, s
 	return 0;
 }
 
+// key is a view into @slice, nothing is copied
+static inline
+int decode_zscore_key(const Bytes &slice, Bytes *key, int64_t *score){
+	const char *p = slice.data();
+	int size = slice.size();
+	// type, len, name, sign, score, =
+	if(size < 2){
+		return -1;
+	}
+	int head = 2 + (uint8_t)p[1];
+	if(size < head + 1 + (int)sizeof(int64_t) + 1){
+		return -1;
+	}
+	uint64_t s;
+	memcpy(&s, p + head + 1, sizeof(uint64_t));
+	*score = (int64_t)decode_score(s);
+	head += 1 + sizeof(int64_t) + 1;
+	*key = Bytes(p + head, size - head);
+	return 0;
+}
+
 
 class ZIterator{
 	private:
 		Iterator *it;
 	public:
 		std::string name;
-		std::string key;
-		std::string score;
+		// the current item, key is a view into the db key, valid until
+		// the next call of next(), scores are formatted only when needed
+		Bytes key;
+		int64_t score;
 
 		ZIterator(Iterator *it, const Bytes &name){
 			this->it = it;
 			this->name.assign(name.data(), name.size());
+			this->score = 0;
 		}
 
 		~ZIterator(){
@@ -144,7 +192,7 @@ class ZIterator{
 				if(ks.data()[0] != DataType::ZSCORE){
 					return false;
 				}
-				if(decode_zscore_key(ks, NULL, &key, &score) == -1){
+				if(decode_zscore_key(ks, &key, &score) == -1){
 					continue;
 				}
 				return true;
@@ -1,41 +1,57 @@
 #include <pthread.h>
 #include <time.h>
 #include "t_zset.h"
+#include "t_kv.h"
 #include "ttl.h"
+#include "counter.h"
 
 #define EXPIRATION_LIST_KEY "\xff\xff\xff\xff\xff|EXPIRE_LIST|KV"
+#define CONTAINER_EXPIRATION_LIST_KEY "\xff\xff\xff\xff\xff|EXPIRE_LIST|CONTAINER"
 
-ExpirationHandler::ExpirationHandler(SSDB *ssdb){
+static std::string encode_container_key(char type, const Bytes &name){
+	std::string buf;
+	buf.append(1, type);
+	buf.append(name.data(), name.size());
+	return buf;
+}
+
+ExpirationHandler::ExpirationList::ExpirationList(const std::string &name, int64_t now)
+	: keys(now)
+{
+	this->name = name;
+	// nothing loaded
+	this->load_score = INT64_MIN;
+	this->load_key = "";
+}
+
+ExpirationHandler::ExpirationHandler(SSDB *ssdb, int speed, int window, int max_keys)
+	: kv_list(EXPIRATION_LIST_KEY, time_ms()),
+	container_list(CONTAINER_EXPIRATION_LIST_KEY, time_ms())
+{
 	this->ssdb = ssdb;
+	this->speed = speed > 0? speed : 0;
+	this->window = (int64_t)(window > 0? window : 10) * 60 * 1000;
+	this->max_keys = max_keys > 0? max_keys : 1000000;
 	this->thread_quit = false;
-	this->list_name = EXPIRATION_LIST_KEY;
+	this->containers_loaded = INT64_MIN;
+	this->lag = 0;
+	this->deleted = 0;
+	this->rate_time = time_ms();
+	this->rate_deleted = 0;
+	this->rate = 0;
 	this->start();
 }
 
 ExpirationHandler::~ExpirationHandler(){
 	this->stop();
 	ssdb = NULL;
-	thread_quit = true;
 }
 
 void ExpirationHandler::start(){
-	int count = 0;
-	ZIterator *it;
-	it = ssdb->zscan(this->list_name, "", "", "", 999999999);
-	while(it->next()){
-		int64_t score = str_to_int64(it->score);
-		if(score < 2000000000){
-			// older version compatible
-			score *= 1000;
-		}
-		expiration_keys.add(it->key, score);
-		count ++;
-	}
-	delete it;
-	log_debug("loaded %d expiration key(s)", count);
-	
+	// keys are loaded by the thread when they are about to expire, the
+	// first chunk is loaded now, so that expired containers are known
+	this->load();
 	thread_quit = false;
-	pthread_t tid;
 	int err = pthread_create(&tid, NULL, &ExpirationHandler::thread_func, this);
 	if(err != 0){
 		log_fatal("can't create thread: %s", strerror(err));
@@ -45,16 +61,21 @@ void ExpirationHandler::start(){
 
 void ExpirationHandler::stop(){
 	thread_quit = true;
-	for(int i=0; i<100; i++){
-		if(!thread_quit){
-			break;
-		}
-		usleep(10 * 1000);
+	void *tret;
+	int err = pthread_join(tid, &tret);
+	if(err != 0){
+		log_error("can't join thread: %s", strerror(err));
 	}
 }
 
 int ExpirationHandler::set_ttl(const Bytes &key, int64_t ttl){
 	int64_t expired = time_ms() + ttl * 1000;
+	if(ssdb->inline_ttl){
+		if(ssdb->expire(key, expired) == -1){
+			return -1;
+		}
+		return 0;
+	}
 	char data[30];
 	int size = snprintf(data, sizeof(data), "%" PRId64, expired);
 	if(size <= 0){
@@ -63,17 +84,371 @@ int ExpirationHandler::set_ttl(const Bytes &key, int64_t ttl){
 	}
 	
 	Locking l(&mutex);
-	int ret = ssdb->zset(this->list_name, key, Bytes(data, size));
+	int ret = ssdb->zset(kv_list.name, key, Bytes(data, size));
 	if(ret == -1){
 		return -1;
 	}
-	expiration_keys.add(key.String(), expired);
-	
+	this->key_loaded(&kv_list, key.String(), expired);
+	return 0;
+}
+
+void ExpirationHandler::key_loaded(ExpirationList *list, const std::string &key, int64_t expire){
+	if(expire > list->load_score || (expire == list->load_score && key > list->load_key)){
+		// will be loaded later
+		list->keys.del(key);
+		return;
+	}
+	list->keys.add(key, expire);
+	// keep memory bounded, by unloading the last keys
+	while(list->keys.size() > max_keys){
+		const std::string *last_key;
+		int64_t last_score;
+		list->keys.back(&last_key, &last_score);
+		list->load_score = last_score;
+		list->load_key = "";
+		list->keys.pop_back();
+	}
+}
+
+int ExpirationHandler::load(){
+	int count = 0;
+	std::vector<std::string> keys;
+	std::vector<int64_t> scores;
+	{
+		Locking l(&mutex);
+		count += this->load_list(&kv_list, &keys, &scores);
+		for(int i=0; i<(int)keys.size(); i++){
+			kv_list.keys.add(keys[i], scores[i]);
+		}
+	}
+	keys.clear();
+	scores.clear();
+	{
+		Locking l(&container_mutex);
+		count += this->load_list(&container_list, &keys, &scores);
+		WriteLocking l2(&container_keys_lock);
+		for(int i=0; i<(int)keys.size(); i++){
+			container_list.keys.add(keys[i], scores[i]);
+		}
+		containers_loaded = container_list.load_score;
+	}
+	return count;
+}
+
+int ExpirationHandler::load_list(ExpirationList *list, std::vector<std::string> *keys, std::vector<int64_t> *scores){
+	int64_t end = time_ms() + window;
+	if(list->load_score > end || list->keys.size() >= max_keys){
+		return 0;
+	}
+	std::string score_start, score_end;
+	if(list->load_score != INT64_MIN){
+		score_start = int64_to_str(list->load_score);
+	}
+	score_end = int64_to_str(end);
+
+	int count = 0;
+	ZIterator *it = ssdb->zscan(list->name, list->load_key, score_start, score_end, LOAD_KEYS);
+	while(it->next()){
+		int64_t score = it->score;
+		list->load_score = score;
+		list->load_key = it->key.String();
+		if(score < 2000000000){
+			// older version compatible
+			score *= 1000;
+		}
+		keys->push_back(it->key.String());
+		scores->push_back(score);
+		count ++;
+	}
+	delete it;
+	if(count < LOAD_KEYS){
+		// all keys expiring before end are loaded
+		list->load_score = end + 1;
+		list->load_key = "";
+	}
+	if(count > 0){
+		log_debug("loaded %d key(s) of %s", count, hexmem(list->name.data(), list->name.size()).c_str());
+	}
+	return count;
+}
+
+int ExpirationHandler::set_container_ttl(char type, const Bytes &name, int64_t ttl){
+	if(name == kv_list.name || name == container_list.name){
+		return -1;
+	}
+	std::string key = encode_container_key(type, name);
+	CounterLocking cl(ssdb->counters);
+	Locking l(&container_mutex);
+	if(ttl <= 0){
+		if(ssdb->zdel(container_list.name, key) == -1){
+			return -1;
+		}
+		WriteLocking l2(&container_keys_lock);
+		container_list.keys.del(key);
+		return 0;
+	}
+	int64_t expire = time_ms() + ttl * 1000;
+	if(ssdb->zset(container_list.name, key, int64_to_str(expire)) == -1){
+		return -1;
+	}
+	WriteLocking l2(&container_keys_lock);
+	this->key_loaded(&container_list, key, expire);
+	containers_loaded = container_list.load_score;
 	return 0;
 }
 
+int ExpirationHandler::del_container_ttl(char type, const Bytes &name){
+	if(name == kv_list.name || name == container_list.name){
+		return 0;
+	}
+	// container_mutex is taken before Transaction, it is not needed, the
+	// ttl row is deleted in the caller's transaction
+	std::string key = encode_container_key(type, name);
+	int ret = ssdb->zdel_in_trans(container_list.name, key);
+	if(ret <= 0){
+		return ret;
+	}
+	WriteLocking l(&container_keys_lock);
+	container_list.keys.del(key);
+	return 1;
+}
+
+int64_t ExpirationHandler::container_ttl(char type, const Bytes &name){
+	std::string score;
+	int ret = ssdb->zget(container_list.name, encode_container_key(type, name), &score);
+	if(ret == -1){
+		return -2;
+	}
+	if(ret == 0){
+		return -1;
+	}
+	int64_t ttl = str_to_int64(score) - time_ms();
+	return ttl < 0? 0 : ttl;
+}
+
+bool ExpirationHandler::container_expired(char type, const Bytes &name){
+	int64_t now = time_ms();
+	std::string key;
+	{
+		ReadLocking l(&container_keys_lock);
+		bool loaded = containers_loaded > now;
+		if(loaded && container_list.keys.size() == 0 && deleting_containers.empty()){
+			return false;
+		}
+		key = encode_container_key(type, name);
+		int64_t expire;
+		if(container_list.keys.get(key, &expire) == 1){
+			return expire <= now;
+		}
+		if(deleting_containers.find(key) != deleting_containers.end()){
+			return true;
+		}
+		if(loaded){
+			return false;
+		}
+	}
+	// memory is full(max_keys), or loading is behind, a container which
+	// has expired may not be loaded yet, read its ttl
+	if(name == kv_list.name || name == container_list.name){
+		return false;
+	}
+	std::string score;
+	if(ssdb->zget(container_list.name, key, &score) != 1){
+		return false;
+	}
+	return str_to_int64(score) <= now;
+}
+
+int ExpirationHandler::clear_expired_container(char type, const Bytes &name){
+	if(!this->container_expired(type, name)){
+		return 0;
+	}
+	// the sweeper may be deleting it, wait for it
+	CounterLocking cl(ssdb->counters);
+	Locking l(&container_mutex);
+	return this->del_container(encode_container_key(type, name), time_ms());
+}
+
+int ExpirationHandler::del_container(const std::string &key, int64_t now){
+	// the ttl may have been reset
+	std::string score;
+	int ret = ssdb->zget(container_list.name, key, &score);
+	if(ret == 1 && str_to_int64(score) <= now){
+		Bytes name(key.data() + 1, key.size() - 1);
+		int64_t count;
+		switch(key[0]){
+			case DataType::HSIZE:
+				count = ssdb->hclear(name);
+				break;
+			case DataType::ZSIZE:
+				count = ssdb->zclear(name);
+				break;
+			case DataType::QSIZE:
+				count = ssdb->qclear(name);
+				break;
+			default:
+				count = 0;
+				break;
+		}
+		if(count == -1 || ssdb->zdel(container_list.name, key) == -1){
+			ret = -1;
+		}else{
+			log_debug("expired %s, %" PRId64 " item(s)", hexmem(key.data(), key.size()).c_str(), count);
+		}
+	}else if(ret == 1){
+		ret = 0;
+	}
+
+	WriteLocking l(&container_keys_lock);
+	deleting_containers.erase(key);
+	int64_t expire;
+	if(ret != -1 && container_list.keys.get(key, &expire) == 1 && expire <= now){
+		container_list.keys.del(key);
+	}
+	return ret;
+}
+
+int ExpirationHandler::setx(const Bytes &key, const Bytes &val, int64_t ttl){
+	if(ssdb->inline_ttl){
+		// a single write
+		if(ssdb->setx(key, val, time_ms() + ttl * 1000) == -1){
+			return -1;
+		}
+		return 0;
+	}
+	if(ssdb->set(key, val) == -1){
+		return -1;
+	}
+	return this->set_ttl(key, ttl);
+}
+
+void ExpirationHandler::expired_key(const Bytes &key){
+	Locking l(&expired_mutex);
+	// the rest will be found by scanning
+	if((int)expired_keys.size() < MAX_EXPIRED_KEYS){
+		expired_keys.push_back(key.String());
+	}
+}
+
+int ExpirationHandler::reclaim(){
+	std::vector<std::string> keys;
+	{
+		Locking l(&expired_mutex);
+		keys.swap(expired_keys);
+	}
+	// scan for expired keys nobody reads
+	std::string last;
+	int n = ssdb->scan_expired(scan_cursor, SCAN_KEYS, &keys, &last);
+	if(n < SCAN_KEYS){
+		scan_cursor = "";
+	}else{
+		scan_cursor = last;
+	}
+	if(keys.empty()){
+		return 0;
+	}
+	int ret = ssdb->del_expired(keys);
+	if(ret > 0){
+		log_debug("deleted %d expired key(s)", ret);
+		this->add_deleted(ret);
+	}
+	return ret;
+}
+
+// @return number of keys processed
+int ExpirationHandler::sweep(){
+	std::vector<std::string> keys;
+	int64_t now = time_ms();
+	{
+		Locking l(&mutex);
+		std::string key;
+		int64_t score;
+		while((int)keys.size() < CHUNK_KEYS && kv_list.keys.pop(now, &key, &score)){
+			if(keys.empty()){
+				lag = now - score;
+			}
+			keys.push_back(key);
+		}
+		if(keys.empty()){
+			lag = 0;
+		}
+	}
+	if(keys.empty()){
+		return 0;
+	}
+	int ret = ssdb->zdel_expired(kv_list.name, keys, now);
+	if(ret == -1){
+		log_error("delete expired keys error");
+		return 0;
+	}
+	log_debug("expired %d of %d key(s)", ret, (int)keys.size());
+	this->add_deleted(ret);
+	return (int)keys.size();
+}
+
+int ExpirationHandler::sweep_containers(){
+	std::vector<std::string> keys;
+	int64_t now = time_ms();
+	{
+		WriteLocking l(&container_keys_lock);
+		std::string key;
+		while((int)keys.size() < CHUNK_KEYS && container_list.keys.pop(now, &key)){
+			// still looks expired to readers
+			deleting_containers.insert(key);
+			keys.push_back(key);
+		}
+	}
+	int count = 0;
+	for(int i=0; i<(int)keys.size(); i++){
+		CounterLocking cl(ssdb->counters);
+		Locking l(&container_mutex);
+		int ret = this->del_container(keys[i], now);
+		if(ret == -1){
+			log_error("delete expired container error");
+		}else{
+			count += ret;
+		}
+	}
+	if(count > 0){
+		this->add_deleted(count);
+	}
+	return (int)keys.size();
+}
+
+void ExpirationHandler::add_deleted(int count){
+	Locking l(&mutex);
+	deleted += count;
+	int64_t now = time_ms();
+	if(now - rate_time >= 1000){
+		rate = (int)((deleted - rate_deleted) * 1000 / (now - rate_time));
+		rate_time = now;
+		rate_deleted = deleted;
+	}
+}
+
+std::string ExpirationHandler::stats(){
+	Locking l(&mutex);
+	int64_t now = time_ms();
+	if(now - rate_time >= 2000){
+		// no key deleted recently
+		rate = 0;
+	}
+	int64_t loaded = 0;
+	if(kv_list.load_score > now){
+		loaded = (kv_list.load_score - now) / 1000;
+	}
+	int containers;
+	{
+		ReadLocking l2(&container_keys_lock);
+		containers = container_list.keys.size();
+	}
+	char buf[256];
+	snprintf(buf, sizeof(buf), "keys: %d, containers: %d, loaded: %" PRId64 " s ahead, lag: %" PRId64 " ms, deleted: %" PRIu64 ", speed: %d/s, max_speed: %d/s",
+		kv_list.keys.size(), containers, loaded, lag, deleted, rate, speed);
+	return std::string(buf);
+}
+
 void* ExpirationHandler::thread_func(void *arg){
-	log_debug("ExpirationHandler started");
 	ExpirationHandler *handler = (ExpirationHandler *)arg;
 	
 	while(!handler->thread_quit){
@@ -82,25 +457,26 @@ void* ExpirationHandler::thread_func(void *arg){
 			break;
 		}
 		
-		const std::string *key;
-		int64_t score;
-		{
-			Locking l(&handler->mutex);
-			if(handler->expiration_keys.front(&key, &score)){
-				int64_t now = time_ms();
-				if(score <= now){
-					log_debug("expired %s", key->c_str());
-					ssdb->del(*key);
-					ssdb->zdel(handler->list_name, *key);
-					handler->expiration_keys.pop_front();
-					continue;
-				}
+		int count = handler->sweep();
+		count += handler->sweep_containers();
+		count += handler->load();
+		// inline ttls written before the option was disabled still expire
+		if(ssdb->kv_ttl_header){
+			count += handler->reclaim();
+		}
+		if(count == 0){
+			usleep(50 * 1000);
+			continue;
+		}
+		if(handler->speed > 0){
+			int64_t pause = (int64_t)count * 1000 * 1000 / handler->speed;
+			while(pause > 0 && !handler->thread_quit){
+				usleep(pause > 100 * 1000? 100 * 1000 : pause);
+				pause -= 100 * 1000;
 			}
 		}
-		usleep(50 * 1000);
 	}
 	
 	log_debug("ExpirationHandler thread_func quit");
-	handler->thread_quit = false;
 	return (void *)NULL;
 }
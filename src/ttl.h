@@ -3,26 +3,124 @@
 
 #include "include.h"
 #include "ssdb.h"
-#include "util/sorted_set.h"
+#include "util/timing_wheel.h"
 #include "util/thread.h"
 #include <string>
+#include <vector>
+#include <set>
 
 class ExpirationHandler
 {
 public:
-	ExpirationHandler(SSDB *ssdb);
+	// Expired keys are deleted by one thread, in chunks of keys per
+	// transaction. More threads would only wait for each other on the
+	// lock of Transaction.
+	// speed: max keys deleted per second, 0 means not limited
+	// window: only keys expiring in @window minutes are kept in memory
+	// max_keys: max keys kept in memory
+	ExpirationHandler(SSDB *ssdb, int speed=0, int window=10, int max_keys=1000000);
 	~ExpirationHandler();
 	int set_ttl(const Bytes &key, int64_t ttl);
+	// set a key with ttl(in seconds)
+	int setx(const Bytes &key, const Bytes &val, int64_t ttl);
+	// inline ttl: an expired key is found by a reader, delete it later
+	void expired_key(const Bytes &key);
+
+	// Container ttl, type: DataType::HSIZE, ZSIZE or QSIZE. An expired
+	// container is deleted in the background, and looks empty until then.
+	// ttl <= 0 removes the ttl
+	int set_container_ttl(char type, const Bytes &name, int64_t ttl);
+	// removes the ttl in the Transaction held by the caller, which
+	// deletes the container(see SSDB::del_container_ttl)
+	int del_container_ttl(char type, const Bytes &name);
+	// @return remaining ttl in ms, -1: no ttl, -2: error
+	int64_t container_ttl(char type, const Bytes &name);
+	bool container_expired(char type, const Bytes &name);
+	// delete a container now if it is expired, called before writing to it
+	// @return 1: deleted, 0: not expired, -1: error
+	int clear_expired_container(char type, const Bytes &name);
+
+	std::string stats();
 
 private:
+	// expired keys are deleted in chunks, one transaction per chunk
+	static const int CHUNK_KEYS = 1000;
+	static const int MAX_EXPIRED_KEYS = 10000;
+	static const int SCAN_KEYS = 1000;
+	// keys loaded from expiration list at a time
+	static const int LOAD_KEYS = 10000;
+
+	// A zset of key => expire time(ms) in db, keys up to (load_score,
+	// load_key) of it are in memory, the rest are loaded when they are
+	// about to expire.
+	struct ExpirationList{
+		std::string name;
+		TimerSet keys;
+		int64_t load_score;
+		std::string load_key;
+		ExpirationList(const std::string &name, int64_t now);
+	};
+
 	SSDB *ssdb;
+	int speed;
+	int64_t window;
+	int max_keys;
 	volatile bool thread_quit;
-	std::string list_name;
-	SortedSet expiration_keys;
+	pthread_t tid;
+
+	// kv keys
+	ExpirationList kv_list;
 	Mutex mutex;
 
+	// containers, keys are type + name
+	ExpirationList container_list;
+	// protects the list in db and the load cursor, serializes deletions,
+	// the lock of CounterBuffer is taken before it
+	Mutex container_mutex;
+	// protects container_list.keys, containers_loaded and
+	// deleting_containers, never held while calling ssdb, taken for
+	// reading by container_expired(), on every read of a container
+	RWLock container_keys_lock;
+	// popped by the sweeper, being deleted
+	std::set<std::string> deleting_containers;
+	// copy of container_list.load_score, containers expiring before it
+	// are in memory
+	int64_t containers_loaded;
+
+	// stats, protected by mutex
+	// how late the first key of the last chunk is deleted
+	int64_t lag;
+	uint64_t deleted;
+	int64_t rate_time;
+	uint64_t rate_deleted;
+	int rate;
+
+	// inline ttl
+	std::vector<std::string> expired_keys;
+	Mutex expired_mutex;
+	std::string scan_cursor;
+
 	void start();
 	void stop();
+	// load a chunk of keys expiring in window of each list
+	// @return number of keys loaded
+	int load();
+	// scan a chunk of keys expiring in window from list, caller holds the
+	// lock of its cursor
+	int load_list(ExpirationList *list, std::vector<std::string> *keys, std::vector<int64_t> *scores);
+	// add or remove a key in memory after its ttl is set, caller holds the
+	// locks of the cursor and the keys
+	void key_loaded(ExpirationList *list, const std::string &key, int64_t expire);
+	// delete a chunk of expired keys in expiration list
+	int sweep();
+	// delete expired containers, @return number of containers processed
+	int sweep_containers();
+	// caller holds container_mutex, @return 1: deleted, 0: not expired, -1: error
+	int del_container(const std::string &key, int64_t now);
+	// inline ttl, @return number of keys deleted
+	int reclaim();
+	void add_deleted(int count);
+
 	static void* thread_func(void *arg);
 };
 
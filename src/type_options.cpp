@@ -0,0 +1,206 @@
+#include "type_options.h"
+#include <vector>
+#include "leveldb/slice.h"
+
+static const char *group_names[TypeOptions::GROUPS] = {
+	"default", "kv", "hash", "zset", "queue", "binlog"
+};
+
+TypeOptions::TypeOptions(int bloom_bits, size_t block_size, leveldb::CompressionType compression){
+	for(int i=0; i<GROUPS; i++){
+		this->bloom_bits[i] = bloom_bits;
+		this->block_size[i] = block_size;
+		this->compression[i] = compression;
+		this->prefix_bloom[i] = false;
+	}
+}
+
+int TypeOptions::group(const std::string &name){
+	for(int i=0; i<GROUPS; i++){
+		if(name == group_names[i]){
+			return i;
+		}
+	}
+	return -1;
+}
+
+const char* TypeOptions::group_name(int group){
+	return group_names[group];
+}
+
+int TypeOptions::key_group(const leveldb::Slice &key){
+	if(key.empty()){
+		return DEFAULT;
+	}
+	switch(key[0]){
+		case DataType::KV:
+		case DataType::BITMAP:
+		case DataType::HLL:
+			return KV;
+		case DataType::HASH:
+		case DataType::HSIZE:
+		case DataType::HPACK:
+			return HASH;
+		case DataType::ZSET:
+		case DataType::ZSCORE:
+		case DataType::ZSIZE:
+		case DataType::DZSET:
+		case DataType::DZSCORE:
+		case DataType::DZSIZE:
+			return ZSET;
+		case DataType::QUEUE:
+		case DataType::QSIZE:
+		case DataType::XGROUP:
+		case DataType::XPEND:
+			return QUEUE;
+		case DataType::SYNCLOG:
+			return BINLOG;
+		default:
+			return DEFAULT;
+	}
+}
+
+int TypeOptions::container_prefix_size(const leveldb::Slice &key){
+	if(key.size() < 2){
+		return 0;
+	}
+	switch(key[0]){
+		case DataType::HASH:
+		case DataType::ZSET:
+		case DataType::DZSET:
+		case DataType::QUEUE:
+		case DataType::BITMAP:
+			break;
+		default:
+			return 0;
+	}
+	int size = 2 + (uint8_t)key[1];
+	if(size > (int)key.size()){
+		return 0;
+	}
+	return size;
+}
+
+
+TypeFilterPolicy::TypeFilterPolicy(const TypeOptions &opts){
+	for(int i=0; i<TypeOptions::GROUPS; i++){
+		if(opts.bloom_bits[i] > 0){
+			blooms[i] = leveldb::NewBloomFilterPolicy(opts.bloom_bits[i]);
+		}else{
+			blooms[i] = NULL;
+		}
+		prefix_bloom[i] = opts.prefix_bloom[i];
+	}
+	reader = leveldb::NewBloomFilterPolicy(10);
+}
+
+TypeFilterPolicy::~TypeFilterPolicy(){
+	for(int i=0; i<TypeOptions::GROUPS; i++){
+		delete blooms[i];
+	}
+	delete reader;
+}
+
+// the name of the builtin bloom filter, so leveldb keeps using the filters
+// of sstables written before types was configured, and the other way round
+const char* TypeFilterPolicy::Name() const{
+	return "leveldb.BuiltinBloomFilter";
+}
+
+void TypeFilterPolicy::CreateFilter(const leveldb::Slice* keys, int n, std::string* dst) const{
+	std::vector<leveldb::Slice> groups[TypeOptions::GROUPS];
+	leveldb::Slice last_prefix;
+	for(int i=0; i<n; i++){
+		const leveldb::Slice &key = keys[i];
+		if(!key.empty() && (key[0] == DataType::ZSCORE || key[0] == DataType::DZSCORE)){
+			continue;
+		}
+		int group = TypeOptions::key_group(key);
+		groups[group].push_back(key);
+		if(prefix_bloom[group]){
+			// keys are sorted, items of a container are together
+			int size = TypeOptions::container_prefix_size(key);
+			if(size > 0){
+				leveldb::Slice prefix(key.data(), size);
+				if(prefix != last_prefix){
+					groups[group].push_back(prefix);
+					last_prefix = prefix;
+				}
+			}
+		}
+	}
+	for(int i=0; i<TypeOptions::GROUPS; i++){
+		if(blooms[i] == NULL){
+			continue;
+		}
+		dst->push_back((char)(prefix_bloom[i]? (i | PREFIX_FLAG) : i));
+		size_t pos = dst->size();
+		dst->append(4, '\0');
+		if(!groups[i].empty()){
+			blooms[i]->CreateFilter(&groups[i][0], (int)groups[i].size(), dst);
+		}
+		uint32_t len = dst->size() - pos - 4;
+		for(int j=0; j<4; j++){
+			(*dst)[pos + j] = (char)(len >> (j * 8));
+		}
+	}
+	dst->push_back((char)FILTER_MAGIC);
+}
+
+bool TypeFilterPolicy::KeyMayMatch(const leveldb::Slice& key, const leveldb::Slice& filter) const{
+	if(!key.empty() && (key[0] == DataType::ZSCORE || key[0] == DataType::DZSCORE)){
+		return true;
+	}
+	if(filter.empty() || (uint8_t)filter[filter.size() - 1] != FILTER_MAGIC){
+		// a builtin bloom filter
+		return reader->KeyMayMatch(key, filter);
+	}
+	int group = TypeOptions::key_group(key);
+	const char *p = filter.data();
+	const char *end = p + filter.size() - 1;
+	while(end - p >= 5){
+		int g = (uint8_t)p[0];
+		uint32_t len = 0;
+		for(int j=0; j<4; j++){
+			len |= (uint32_t)(uint8_t)p[1 + j] << (j * 8);
+		}
+		p += 5;
+		if(len > (uint32_t)(end - p)){
+			break;
+		}
+		if((g & ~PREFIX_FLAG) == group){
+			if(len == 0){
+				// no key of this group
+				return false;
+			}
+			leveldb::Slice bloom(p, len);
+			if(g & PREFIX_FLAG){
+				int size = TypeOptions::container_prefix_size(key);
+				if(size > 0 && !reader->KeyMayMatch(leveldb::Slice(key.data(), size), bloom)){
+					return false;
+				}
+			}
+			return reader->KeyMayMatch(key, bloom);
+		}
+		p += len;
+	}
+	return true;
+}
+
+
+TypeBlockPolicy::TypeBlockPolicy(const TypeOptions &opts)
+	: opts(opts)
+{
+}
+
+int TypeBlockPolicy::KeyGroup(const leveldb::Slice& key) const{
+	return TypeOptions::key_group(key);
+}
+
+size_t TypeBlockPolicy::BlockSize(int group) const{
+	return opts.block_size[group];
+}
+
+leveldb::CompressionType TypeBlockPolicy::Compression(int group) const{
+	return opts.compression[group];
+}
@@ -0,0 +1,97 @@
+#ifndef SSDB_TYPE_OPTIONS_H_
+#define SSDB_TYPE_OPTIONS_H_
+
+#include "include.h"
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/block_policy.h"
+
+/**
+ * Per data type tuning of the leveldb storage: bloom filter bits, data
+ * block size and compression are chosen by the key group(kv, hash,
+ * zset, queue, binlog) of each key.
+ */
+class TypeOptions{
+	public:
+		static const int DEFAULT	= 0; // keys of no data type
+		static const int KV			= 1;
+		static const int HASH		= 2;
+		static const int ZSET		= 3;
+		static const int QUEUE		= 4;
+		static const int BINLOG		= 5;
+		static const int GROUPS		= 6;
+
+		// 0: no bloom filter
+		int bloom_bits[GROUPS];
+		// also add container names of hash, zset and queue keys to the
+		// bloom filter
+		bool prefix_bloom[GROUPS];
+		size_t block_size[GROUPS];
+		leveldb::CompressionType compression[GROUPS];
+
+		// all groups use the same options
+		TypeOptions(int bloom_bits, size_t block_size, leveldb::CompressionType compression);
+
+		// @return -1: unknown group
+		static int group(const std::string &name);
+		static const char* group_name(int group);
+		// bitmaps and hyperloglogs are in kv, stream groups in queue
+		static int key_group(const leveldb::Slice &key);
+		// hash, zset and queue items are prefixed by type, len, name
+		// @return 0: key has no container prefix
+		static int container_prefix_size(const leveldb::Slice &key);
+};
+
+/**
+ * Bloom filters of each group are built separately, with the group's
+ * bloom_bits. ZSCORE and DZSCORE keys are only iterated, never looked up by
+ * Get(), so they never go into a filter.
+ *
+ * With prefix_bloom, the container prefix(type, len, name) of items is
+ * added to the same bloom, and a lookup of an item checks the prefix
+ * first. A miss on an absent container reads a data block only if both
+ * probes match. They probe the bits of one filter, which holds more
+ * entries, so they are not independent, the rate is somewhat above the
+ * square of a single probe's. A miss on a field of a present container
+ * is slightly more likely, the prefix matches and the key probe sees the
+ * fuller filter.
+ *
+ * Filter format, for each group with bloom_bits > 0 at build time:
+ *     group(1 byte) len(4 bytes) bloom(len bytes, empty if no key)
+ * the highest bit of group is set if prefixes are added. Keys of a group
+ * which is not in the filter may match. The filter ends with 0xff, which
+ * the builtin bloom filter, whose name it takes, reads as "may match",
+ * and a filter which does not end with it is a builtin one.
+ */
+class TypeFilterPolicy : public leveldb::FilterPolicy{
+	private:
+		static const int PREFIX_FLAG = 0x80;
+		// the builtin filter ends with the number of probes, at most 30
+		static const int FILTER_MAGIC = 0xff;
+
+		const leveldb::FilterPolicy *blooms[TypeOptions::GROUPS];
+		bool prefix_bloom[TypeOptions::GROUPS];
+		// to read filters of any bits
+		const leveldb::FilterPolicy *reader;
+	public:
+		TypeFilterPolicy(const TypeOptions &opts);
+		~TypeFilterPolicy();
+
+		virtual const char* Name() const;
+		virtual void CreateFilter(const leveldb::Slice* keys, int n, std::string* dst) const;
+		virtual bool KeyMayMatch(const leveldb::Slice& key, const leveldb::Slice& filter) const;
+};
+
+class TypeBlockPolicy : public leveldb::BlockPolicy{
+	private:
+		TypeOptions opts;
+	public:
+		TypeBlockPolicy(const TypeOptions &opts);
+
+		virtual int KeyGroup(const leveldb::Slice& key) const;
+		virtual size_t BlockSize(int group) const;
+		virtual leveldb::CompressionType Compression(int group) const;
+};
+
+#endif
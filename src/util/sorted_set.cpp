@@ -83,3 +83,29 @@ int SortedSet::pop_front(){
 	sorted_set.erase(it2);
 	return 1;
 }
+
+int SortedSet::back(const std::string **key, int64_t *score) const{
+	if(sorted_set.empty()){
+		return 0;
+	}
+	std::set<Item>::iterator it2 = sorted_set.end();
+	it2 --;
+	const Item &item = *it2;
+	*key = &item.key;
+	if(score){
+		*score = item.score;
+	}
+	return 1;
+}
+
+int SortedSet::pop_back(){
+	if(sorted_set.empty()){
+		return 0;
+	}
+	std::set<Item>::iterator it2 = sorted_set.end();
+	it2 --;
+	const Item &item = *it2;
+	existed.erase(item.key);
+	sorted_set.erase(it2);
+	return 1;
+}
@@ -17,6 +17,9 @@ public:
 	// the first item is copied into key if SortedSet not empty
 	int front(std::string *key, int64_t *score=NULL) const;
 	int pop_front();
+	// the last item(with the largest score)
+	int back(const std::string **key, int64_t *score=NULL) const;
+	int pop_back();
 	
 	/*
 	class Iterator
@@ -133,16 +133,72 @@ int64_t str_to_int64(const std::string &str){
 	return (int64_t)atoll(str.c_str());
 }
 
+// same as atoll(saturated on overflow), without copying @p
 static inline
 int64_t str_to_int64(const char *p, int size){
-	return (int64_t)atoll(std::string(p, size).c_str());
+	const char *end = p + size;
+	while(p < end && isspace(*p)){
+		p++;
+	}
+	bool neg = false;
+	if(p < end && (*p == '-' || *p == '+')){
+		neg = (*p == '-');
+		p++;
+	}
+	uint64_t max = neg? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	uint64_t v = 0;
+	for(; p < end && *p >= '0' && *p <= '9'; p++){
+		int d = *p - '0';
+		if(v > (max - d) / 10){
+			v = max;
+			break;
+		}
+		v = v * 10 + d;
+	}
+	return neg? (int64_t)(0 - v) : (int64_t)v;
+}
+
+/**
+ * Writes @v in decimal into @buf(at least 20 bytes), two digits at a
+ * time, not terminated.
+ * @return the length
+ */
+static inline
+int int64_to_buf(int64_t v, char *buf){
+	static const char digits[] =
+		"0001020304050607080910111213141516171819"
+		"2021222324252627282930313233343536373839"
+		"4041424344454647484950515253545556575859"
+		"6061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	char tmp[20];
+	char *p = tmp + sizeof(tmp);
+	uint64_t u = v < 0? 0 - (uint64_t)v : (uint64_t)v;
+	while(u >= 100){
+		int i = (int)(u % 100) * 2;
+		u /= 100;
+		*--p = digits[i + 1];
+		*--p = digits[i];
+	}
+	if(u >= 10){
+		int i = (int)u * 2;
+		*--p = digits[i + 1];
+		*--p = digits[i];
+	}else{
+		*--p = (char)('0' + u);
+	}
+	int len = (int)(tmp + sizeof(tmp) - p);
+	if(v < 0){
+		*buf++ = '-';
+	}
+	memcpy(buf, p, len);
+	return len + (v < 0);
 }
 
 static inline
 std::string int64_to_str(int64_t v){
-	char buf[21] = {0};
-	snprintf(buf, sizeof(buf), "%" PRId64 "", v);
-	return std::string(buf);
+	char buf[20];
+	return std::string(buf, int64_to_buf(v, buf));
 }
 
 static inline
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "log.h"
+#include "sorted_set.h"
+#include "timing_wheel.h"
+
+// compares SortedSet and TimerSet as an expiration index:
+// usage: test_timing_wheel [count], default 10M keys in 10 minutes(in ms)
+
+int main(int argc, char **argv){
+	int count = 10 * 1000 * 1000;
+	if(argc > 1){
+		count = atoi(argv[1]);
+	}
+	const int64_t now = 1400000000000LL;
+	const int range = 600 * 1000;
+
+	std::vector<std::string> keys;
+	std::vector<int64_t> times;
+	srand(0);
+	for(int i=0; i<count; i++){
+		char buf[32];
+		snprintf(buf, sizeof(buf), "key_%d", i);
+		keys.push_back(buf);
+		times.push_back(now + rand() % range);
+	}
+	double stime;
+
+	{
+		SortedSet zset;
+		stime = millitime();
+		for(int i=0; i<count; i++){
+			zset.add(keys[i], times[i]);
+		}
+		printf("SortedSet  add: %8.0f ms\n", (millitime() - stime) * 1000);
+		stime = millitime();
+		for(int i=0; i<count; i+=2){
+			zset.del(keys[i]);
+		}
+		printf("SortedSet  del: %8.0f ms (half)\n", (millitime() - stime) * 1000);
+		stime = millitime();
+		int n = 0;
+		const std::string *key;
+		int64_t score;
+		for(int64_t t=now; t<=now+range; t+=100){
+			while(zset.front(&key, &score) && score <= t){
+				zset.pop_front();
+				n ++;
+			}
+		}
+		printf("SortedSet  pop: %8.0f ms, %d keys\n", (millitime() - stime) * 1000, n);
+	}
+
+	{
+		TimerSet timers(now);
+		stime = millitime();
+		for(int i=0; i<count; i++){
+			timers.add(keys[i], times[i]);
+		}
+		printf("TimerSet   add: %8.0f ms\n", (millitime() - stime) * 1000);
+		stime = millitime();
+		for(int i=0; i<count; i+=2){
+			timers.del(keys[i]);
+		}
+		printf("TimerSet   del: %8.0f ms (half)\n", (millitime() - stime) * 1000);
+		stime = millitime();
+		int n = 0;
+		std::string key;
+		int64_t last = 0;
+		int64_t time;
+		for(int64_t t=now; t<=now+range; t+=100){
+			while(timers.pop(t, &key, &time)){
+				if(time > t){
+					log_error("bad pop, time: %" PRId64 ", now: %" PRId64 "", time, t);
+					return 1;
+				}
+				// keys are out of order within a slot(1 tick) at most
+				if(time < last - 100){
+					log_error("bad order, time: %" PRId64 ", last: %" PRId64 "", time, last);
+					return 1;
+				}
+				last = time;
+				n ++;
+			}
+		}
+		printf("TimerSet   pop: %8.0f ms, %d keys\n", (millitime() - stime) * 1000, n);
+	}
+
+	return 0;
+}
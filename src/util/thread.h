@@ -11,8 +11,17 @@ class Mutex{
 	private:
 		pthread_mutex_t mutex;
 	public:
-		Mutex(){
-			pthread_mutex_init(&mutex, NULL);
+		// a recursive mutex may be locked again by the thread holding it
+		Mutex(bool recursive=false){
+			if(recursive){
+				pthread_mutexattr_t attr;
+				pthread_mutexattr_init(&attr);
+				pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+				pthread_mutex_init(&mutex, &attr);
+				pthread_mutexattr_destroy(&attr);
+			}else{
+				pthread_mutex_init(&mutex, NULL);
+			}
 		}
 		~Mutex(){
 			pthread_mutex_destroy(&mutex);
@@ -42,6 +51,60 @@ class Locking{
 
 };
 
+// many readers or one writer
+class RWLock{
+	private:
+		pthread_rwlock_t rwlock;
+	public:
+		RWLock(){
+			pthread_rwlock_init(&rwlock, NULL);
+		}
+		~RWLock(){
+			pthread_rwlock_destroy(&rwlock);
+		}
+		void rdlock(){
+			pthread_rwlock_rdlock(&rwlock);
+		}
+		void wrlock(){
+			pthread_rwlock_wrlock(&rwlock);
+		}
+		void unlock(){
+			pthread_rwlock_unlock(&rwlock);
+		}
+};
+
+class ReadLocking{
+	private:
+		RWLock *lock;
+		// No copying allowed
+		ReadLocking(const ReadLocking&);
+		void operator=(const ReadLocking&);
+	public:
+		ReadLocking(RWLock *lock){
+			this->lock = lock;
+			this->lock->rdlock();
+		}
+		~ReadLocking(){
+			this->lock->unlock();
+		}
+};
+
+class WriteLocking{
+	private:
+		RWLock *lock;
+		// No copying allowed
+		WriteLocking(const WriteLocking&);
+		void operator=(const WriteLocking&);
+	public:
+		WriteLocking(RWLock *lock){
+			this->lock = lock;
+			this->lock->wrlock();
+		}
+		~WriteLocking(){
+			this->lock->unlock();
+		}
+};
+
 /*
 class Semaphore {
 	private:
@@ -144,6 +207,14 @@ class WorkerPool{
 		
 		int push(JOB job);
 		int pop(JOB *job);
+		// a result not made by the job being processed, called by workers
+		int push_result(JOB job){
+			return this->results.push(job);
+		}
+		// number of jobs waiting for a worker
+		int size(){
+			return jobs.size();
+		}
 };
 
 
@@ -0,0 +1,337 @@
+#include "timing_wheel.h"
+
+static inline void list_init(TimingWheel::Node *head){
+	head->prev = head;
+	head->next = head;
+}
+
+static inline void list_append(TimingWheel::Node *head, TimingWheel::Node *node){
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+static inline void list_unlink(TimingWheel::Node *node){
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->prev = NULL;
+	node->next = NULL;
+}
+
+TimingWheel::TimingWheel(int64_t now){
+	this->current = now;
+	this->count = 0;
+	for(int l=0; l<LEVELS; l++){
+		level_count[l] = 0;
+		for(int s=0; s<SLOTS; s++){
+			list_init(&slots[l][s]);
+		}
+	}
+	list_init(&overflow);
+	list_init(&expired);
+}
+
+int TimingWheel::size() const{
+	return count;
+}
+
+void TimingWheel::add(Node *node){
+	count ++;
+	this->place(node);
+}
+
+void TimingWheel::del(Node *node){
+	if(node->level >= 0 && node->level < LEVELS){
+		level_count[node->level] --;
+	}
+	list_unlink(node);
+	count --;
+}
+
+void TimingWheel::place(Node *node){
+	int64_t time = node->time;
+	if(time <= current){
+		node->level = EXPIRED;
+		list_append(&expired, node);
+		return;
+	}
+	uint64_t diff = (uint64_t)time ^ (uint64_t)current;
+	for(int l=0; l<LEVELS; l++){
+		if((diff >> (SLOT_BITS * (l + 1))) == 0){
+			int s = (int)((time >> (SLOT_BITS * l)) & SLOT_MASK);
+			node->level = l;
+			level_count[l] ++;
+			list_append(&slots[l][s], node);
+			return;
+		}
+	}
+	node->level = OVERFLOW;
+	list_append(&overflow, node);
+}
+
+// move the nodes of a list to where they belong now
+void TimingWheel::cascade(Node *head){
+	while(!empty(head)){
+		Node *node = head->next;
+		if(node->level >= 0 && node->level < LEVELS){
+			level_count[node->level] --;
+		}
+		list_unlink(node);
+		this->place(node);
+	}
+}
+
+void TimingWheel::advance(int64_t now){
+	while(current < now){
+		// the next tick when some nodes have to be moved
+		int64_t next;
+		if(level_count[0] > 0){
+			int s = (int)(current & SLOT_MASK) + 1;
+			while(s < SLOTS && empty(&slots[0][s])){
+				s ++;
+			}
+			next = (current & ~(int64_t)SLOT_MASK) + s;
+		}else{
+			int l = 1;
+			while(l < LEVELS && level_count[l] == 0){
+				l ++;
+			}
+			if(l == LEVELS && empty(&overflow)){
+				current = now;
+				break;
+			}
+			next = ((current >> (SLOT_BITS * l)) + 1) << (SLOT_BITS * l);
+		}
+		if(next > now){
+			current = now;
+			break;
+		}
+		current = next;
+
+		// from the highest level whose byte changed, down to level 0
+		if((current & (((int64_t)1 << (SLOT_BITS * LEVELS)) - 1)) == 0){
+			this->cascade(&overflow);
+		}
+		for(int l=LEVELS-1; l>=0; l--){
+			int64_t mask = ((int64_t)1 << (SLOT_BITS * l)) - 1;
+			if((current & mask) == 0){
+				int s = (int)((current >> (SLOT_BITS * l)) & SLOT_MASK);
+				this->cascade(&slots[l][s]);
+			}
+		}
+	}
+}
+
+TimingWheel::Node* TimingWheel::pop(int64_t now){
+	if(empty(&expired)){
+		this->advance(now);
+		if(empty(&expired)){
+			return NULL;
+		}
+	}
+	Node *node = expired.next;
+	this->del(node);
+	return node;
+}
+
+TimingWheel::Node* TimingWheel::max_node(const Node *head){
+	Node *ret = NULL;
+	for(Node *node = head->next; node != head; node = node->next){
+		if(ret == NULL || node->time > ret->time){
+			ret = node;
+		}
+	}
+	return ret;
+}
+
+TimingWheel::Node* TimingWheel::back() const{
+	if(!empty(&overflow)){
+		return max_node(&overflow);
+	}
+	for(int l=LEVELS-1; l>=0; l--){
+		if(level_count[l] == 0){
+			continue;
+		}
+		for(int s=SLOT_MASK; s>=0; s--){
+			if(!empty(&slots[l][s])){
+				return max_node(&slots[l][s]);
+			}
+		}
+	}
+	return max_node(&expired);
+}
+
+
+TimerSet::TimerSet(int64_t now) : wheel(now){
+	this->count = 0;
+	this->free_items = NULL;
+	buckets.resize(POOL_CHUNK, NULL);
+}
+
+TimerSet::~TimerSet(){
+	for(int i=0; i<(int)chunks.size(); i++){
+		delete[] chunks[i];
+	}
+}
+
+int TimerSet::size() const{
+	return count;
+}
+
+// FNV-1a
+uint32_t TimerSet::hash_of(const std::string &key){
+	uint32_t h = 2166136261u;
+	for(int i=0; i<(int)key.size(); i++){
+		h ^= (unsigned char)key[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// @return the pointer to the item, or to the NULL at the end of the bucket
+TimerSet::Item** TimerSet::find(const std::string &key, uint32_t hash){
+	Item **p = &buckets[hash & (buckets.size() - 1)];
+	while(*p){
+		if((*p)->hash == hash && (*p)->key == key){
+			break;
+		}
+		p = &(*p)->hash_next;
+	}
+	return p;
+}
+
+int TimerSet::add(const std::string &key, int64_t time){
+	uint32_t hash = hash_of(key);
+	Item **p = this->find(key, hash);
+	if(*p){
+		Item *item = *p;
+		if(item->time != time){
+			wheel.del(item);
+			item->time = time;
+			wheel.add(item);
+		}
+		return 0;
+	}
+	Item *item = this->alloc_item();
+	item->key = key;
+	item->hash = hash;
+	item->time = time;
+	item->hash_next = NULL;
+	*p = item;
+	wheel.add(item);
+	count ++;
+	if(count > (int)buckets.size()){
+		this->rehash();
+	}
+	return 1;
+}
+
+int TimerSet::del(const std::string &key){
+	Item **p = this->find(key, hash_of(key));
+	if(*p == NULL){
+		return 0;
+	}
+	this->remove(*p);
+	return 1;
+}
+
+int TimerSet::get(const std::string &key, int64_t *time) const{
+	uint32_t hash = hash_of(key);
+	const Item *item = buckets[hash & (buckets.size() - 1)];
+	for(; item; item = item->hash_next){
+		if(item->hash == hash && item->key == key){
+			*time = item->time;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void TimerSet::remove(Item *item){
+	wheel.del(item);
+	this->unhash(item);
+}
+
+// unlink from the hash table and free, item is not in the wheel
+void TimerSet::unhash(Item *item){
+	Item **p = &buckets[item->hash & (buckets.size() - 1)];
+	while(*p != item){
+		p = &(*p)->hash_next;
+	}
+	*p = item->hash_next;
+	count --;
+	this->free_item(item);
+}
+
+int TimerSet::pop(int64_t now, std::string *key, int64_t *time){
+	Item *item = static_cast<Item *>(wheel.pop(now));
+	if(item == NULL){
+		return 0;
+	}
+	if(time){
+		*time = item->time;
+	}
+	// hash is kept in item, key can be taken before unhash
+	key->swap(item->key);
+	this->unhash(item);
+	return 1;
+}
+
+int TimerSet::back(const std::string **key, int64_t *time) const{
+	const Item *item = static_cast<const Item *>(wheel.back());
+	if(item == NULL){
+		return 0;
+	}
+	*key = &item->key;
+	if(time){
+		*time = item->time;
+	}
+	return 1;
+}
+
+int TimerSet::pop_back(){
+	Item *item = static_cast<Item *>(wheel.back());
+	if(item == NULL){
+		return 0;
+	}
+	this->remove(item);
+	return 1;
+}
+
+void TimerSet::rehash(){
+	std::vector<Item *> old;
+	old.swap(buckets);
+	buckets.resize(old.size() * 2, NULL);
+	for(int i=0; i<(int)old.size(); i++){
+		Item *item = old[i];
+		while(item){
+			Item *next = item->hash_next;
+			Item **p = &buckets[item->hash & (buckets.size() - 1)];
+			item->hash_next = *p;
+			*p = item;
+			item = next;
+		}
+	}
+}
+
+TimerSet::Item* TimerSet::alloc_item(){
+	if(free_items == NULL){
+		Item *chunk = new Item[POOL_CHUNK];
+		chunks.push_back(chunk);
+		for(int i=0; i<POOL_CHUNK; i++){
+			chunk[i].hash_next = free_items;
+			free_items = &chunk[i];
+		}
+	}
+	Item *item = free_items;
+	free_items = item->hash_next;
+	return item;
+}
+
+void TimerSet::free_item(Item *item){
+	// key's buffer is kept for reuse
+	item->key.clear();
+	item->hash_next = free_items;
+	free_items = item;
+}
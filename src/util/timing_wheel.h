@@ -0,0 +1,129 @@
+#ifndef UTIL_TIMING_WHEEL_H
+#define UTIL_TIMING_WHEEL_H
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+/*
+Hierarchical timing wheel, time is in ticks(the caller decides what a
+tick is, e.g. 1 ms).
+
+There are 4 levels of 256 slots, slot i of level n holds the nodes whose
+time has i as its n-th byte, and whose higher bytes are the same as the
+current tick's, so the nodes of a level are always later than the nodes
+of the levels below it. When the current tick moves into a slot of level
+n, the nodes in that slot are moved down(cascaded). Nodes more than 2^32
+ticks later are kept in an overflow list.
+
+Nodes are intrusive, they are owned by the caller, add() and del() are
+O(1). Empty ranges of ticks are skipped, so pop() does not have to be
+called on every tick.
+*/
+class TimingWheel
+{
+public:
+	// inherited by timer objects
+	struct Node
+	{
+		int64_t time;
+		Node *prev;
+		Node *next;
+		int level;
+	};
+
+	TimingWheel(int64_t now=0);
+	int size() const;
+	// node->time must be set
+	void add(Node *node);
+	// node must be in this wheel
+	void del(Node *node);
+	// remove and return a node with time <= now, NULL if there is none
+	Node* pop(int64_t now);
+	// the node with the largest time, NULL if empty
+	Node* back() const;
+
+private:
+	static const int LEVELS = 4;
+	static const int SLOT_BITS = 8;
+	static const int SLOTS = 1 << SLOT_BITS;
+	static const int SLOT_MASK = SLOTS - 1;
+	// level of nodes in the overflow and the expired list
+	static const int OVERFLOW = LEVELS;
+	static const int EXPIRED = -1;
+
+	int64_t current;
+	int count;
+	int level_count[LEVELS];
+	// circular lists, the heads are not used as nodes
+	Node slots[LEVELS][SLOTS];
+	Node overflow;
+	Node expired;
+
+	void place(Node *node);
+	void cascade(Node *head);
+	void advance(int64_t now);
+	static bool empty(const Node *head){
+		return head->next == head;
+	}
+	static Node* max_node(const Node *head);
+
+	TimingWheel(const TimingWheel&);
+	void operator=(const TimingWheel&);
+};
+
+
+/*
+Keys with a time, backed by a TimingWheel. Items are allocated from a
+pool and indexed by an intrusive hash table, so add() and del() are O(1)
+and need no allocation once the pool has grown.
+*/
+class TimerSet
+{
+public:
+	TimerSet(int64_t now=0);
+	~TimerSet();
+	int size() const;
+	// @return 1: new key, 0: updated
+	int add(const std::string &key, int64_t time);
+	// @return 1: deleted, 0: not found
+	int del(const std::string &key);
+	// @return 1: found, 0: not found
+	int get(const std::string &key, int64_t *time) const;
+	// remove a key with time <= now
+	// @return 1: found, 0: none
+	int pop(int64_t now, std::string *key, int64_t *time=NULL);
+	// the item with the largest time
+	int back(const std::string **key, int64_t *time=NULL) const;
+	int pop_back();
+
+private:
+	static const int POOL_CHUNK = 1024;
+
+	struct Item : public TimingWheel::Node
+	{
+		std::string key;
+		uint32_t hash;
+		Item *hash_next;
+	};
+
+	TimingWheel wheel;
+	std::vector<Item *> buckets;
+	int count;
+	// free items are linked by hash_next
+	Item *free_items;
+	std::vector<Item *> chunks;
+
+	static uint32_t hash_of(const std::string &key);
+	Item** find(const std::string &key, uint32_t hash);
+	void remove(Item *item);
+	void unhash(Item *item);
+	void rehash();
+	Item* alloc_item();
+	void free_item(Item *item);
+
+	TimerSet(const TimerSet&);
+	void operator=(const TimerSet&);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "waiter.h"
+
+QueueWaiters::QueueWaiters() : deadlines(time_ms()){
+}
+
+void QueueWaiters::add(const Bytes &name, Link *link, int64_t timeout){
+	Locking l(&mutex);
+	std::string n = name.String();
+	waiters[link] = n;
+	queues[n].push_back(link);
+	if(timeout > 0){
+		deadlines.add(link_key(link), time_ms() + timeout);
+	}
+}
+
+bool QueueWaiters::waiting(const Bytes &name){
+	Locking l(&mutex);
+	return queues.find(name.String()) != queues.end();
+}
+
+Link* QueueWaiters::take(const Bytes &name){
+	Locking l(&mutex);
+	std::map<std::string, std::list<Link *> >::iterator it;
+	it = queues.find(name.String());
+	if(it == queues.end()){
+		return NULL;
+	}
+	Link *link = it->second.front();
+	it->second.pop_front();
+	if(it->second.empty()){
+		queues.erase(it);
+	}
+	waiters.erase(link);
+	deadlines.del(link_key(link));
+	return link;
+}
+
+void QueueWaiters::park(Link *link){
+	parked_.insert(link);
+}
+
+void QueueWaiters::resume(Link *link){
+	parked_.erase(link);
+}
+
+int QueueWaiters::cancel(Link *link){
+	Locking l(&mutex);
+	if(waiters.find(link) == waiters.end()){
+		return 0;
+	}
+	this->remove(link);
+	parked_.erase(link);
+	return 1;
+}
+
+void QueueWaiters::remove(Link *link){
+	std::map<Link *, std::string>::iterator it = waiters.find(link);
+	if(it == waiters.end()){
+		return;
+	}
+	std::map<std::string, std::list<Link *> >::iterator q = queues.find(it->second);
+	if(q != queues.end()){
+		q->second.remove(link);
+		if(q->second.empty()){
+			queues.erase(q);
+		}
+	}
+	waiters.erase(it);
+	deadlines.del(link_key(link));
+}
+
+void QueueWaiters::expire(int64_t now, std::vector<Link *> *links){
+	Locking l(&mutex);
+	std::vector<std::string> later;
+	std::string key;
+	while(deadlines.pop(now, &key) == 1){
+		Link *link;
+		memcpy(&link, key.data(), sizeof(link));
+		if(parked_.find(link) == parked_.end()){
+			// not parked yet, its PROC_BLOCKED result is on the way
+			later.push_back(key);
+			continue;
+		}
+		this->remove(link);
+		parked_.erase(link);
+		links->push_back(link);
+	}
+	for(int i=0; i<(int)later.size(); i++){
+		deadlines.add(later[i], now);
+	}
+}
+
+int QueueWaiters::size(){
+	Locking l(&mutex);
+	return (int)waiters.size();
+}
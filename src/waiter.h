@@ -0,0 +1,72 @@
+#ifndef SSDB_WAITER_H_
+#define SSDB_WAITER_H_
+
+#include "include.h"
+#include <string>
+#include <map>
+#include <list>
+#include <set>
+#include "link.h"
+#include "util/thread.h"
+#include "util/timing_wheel.h"
+
+/**
+ * Links blocked in qpop_block on empty queues.
+ *
+ * A waiter is added by the writer thread when qpop_block finds the queue
+ * empty, and taken by the writer thread when a qpush to that queue
+ * commits, so a push never slips in between the empty pop and the
+ * registration. The taken link is answered by the pusher and handed back
+ * to the main loop as a PROC_WOKEN result of the writer.
+ *
+ * The main loop parks a link when it sees its PROC_BLOCKED result, keeps
+ * watching it for disconnection, and cancels waiters which time out or
+ * are closed. A waiter which is already taken can not be cancelled, its
+ * PROC_WOKEN result is on the way. Deadlines are kept in a timing wheel,
+ * so expire() only visits the waiters which time out.
+ */
+class QueueWaiters{
+	private:
+		Mutex mutex;
+		// queue name => links in arrival order
+		std::map<std::string, std::list<Link *> > queues;
+		// link => queue name
+		std::map<Link *, std::string> waiters;
+		// deadlines(ms) of the waiters with a timeout, keyed by link_key()
+		TimerSet deadlines;
+
+		static std::string link_key(Link *link){
+			return std::string((char *)&link, sizeof(link));
+		}
+		// with the mutex held
+		void remove(Link *link);
+
+		// main thread only
+		std::set<Link *> parked_;
+	public:
+		QueueWaiters();
+
+		/* writer thread */
+
+		// timeout: in ms, 0 waits forever
+		void add(const Bytes &name, Link *link, int64_t timeout);
+		bool waiting(const Bytes &name);
+		// removes and returns the oldest waiter of @name, NULL if none
+		Link* take(const Bytes &name);
+
+		/* main thread */
+
+		void park(Link *link);
+		void resume(Link *link);
+		bool parked(Link *link) const{
+			return parked_.find(link) != parked_.end();
+		}
+		// @return 1: cancelled and resumed, 0: already taken
+		int cancel(Link *link);
+		// cancels parked waiters whose deadline has passed
+		void expire(int64_t now, std::vector<Link *> *links);
+
+		int size();
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "ztop_cache.h"
+#include "util/log.h"
+
+// by (score, key), the order of zscore keys
+static inline int item_cmp(int64_t s1, const Bytes &k1, int64_t s2, const Bytes &k2){
+	if(s1 != s2){
+		return s1 < s2? -1 : 1;
+	}
+	return k1.compare(k2);
+}
+
+ZTopCache::ZTopCache(int top, int64_t memory){
+	this->top = top;
+	this->memory = memory;
+	this->bytes = 0;
+	this->clock = 0;
+	this->hits = 0;
+	this->misses = 0;
+}
+
+ZTopCache::~ZTopCache(){
+}
+
+void ZTopCache::add(const std::string &name){
+	Entry &e = zsets[name];
+	e.loaded = false;
+	e.gen = 0;
+	e.last_access = 0;
+	e.bytes = 0;
+}
+
+int64_t ZTopCache::item_bytes(const Item &item){
+	return sizeof(Item) + item.key.size() + item.score_str.size();
+}
+
+ZTopCache::Entry* ZTopCache::find(const Bytes &name){
+	std::map<std::string, Entry>::iterator it = zsets.find(name.String());
+	if(it == zsets.end()){
+		return NULL;
+	}
+	return &it->second;
+}
+
+void ZTopCache::set(const Bytes &name, const Bytes &key, const std::string &score){
+	if(!this->cached(name)){
+		return;
+	}
+	Change c;
+	c.op = 's';
+	c.name = name.String();
+	c.key = key.String();
+	c.score = score;
+	pending.push_back(c);
+}
+
+void ZTopCache::del(const Bytes &name, const Bytes &key){
+	if(!this->cached(name)){
+		return;
+	}
+	Change c;
+	c.op = 'd';
+	c.name = name.String();
+	c.key = key.String();
+	pending.push_back(c);
+}
+
+void ZTopCache::reset(const Bytes &name){
+	if(!this->cached(name)){
+		return;
+	}
+	Change c;
+	c.op = 'r';
+	c.name = name.String();
+	pending.push_back(c);
+}
+
+void ZTopCache::commit(){
+	if(pending.empty()){
+		return;
+	}
+	Locking l(&mutex);
+	for(std::vector<Change>::iterator it=pending.begin(); it!=pending.end(); it++){
+		this->apply(*it);
+	}
+	pending.clear();
+}
+
+void ZTopCache::rollback(){
+	pending.clear();
+}
+
+void ZTopCache::unload(Entry *e){
+	bytes -= e->bytes;
+	e->bytes = 0;
+	e->loaded = false;
+	std::vector<Item>().swap(e->head.items);
+	std::vector<Item>().swap(e->tail.items);
+}
+
+void ZTopCache::window_del(Entry *e, Window *w, const std::string &key){
+	for(std::vector<Item>::iterator it=w->items.begin(); it!=w->items.end(); it++){
+		if(it->key == key){
+			int64_t n = item_bytes(*it);
+			e->bytes -= n;
+			bytes -= n;
+			w->items.erase(it);
+			return;
+		}
+	}
+}
+
+void ZTopCache::window_set(Entry *e, Window *w, bool desc, const Item &item){
+	int pos = 0;
+	for(; pos<(int)w->items.size(); pos++){
+		const Item &t = w->items[pos];
+		int r = item_cmp(item.score, item.key, t.score, t.key);
+		if(desc? r > 0 : r < 0){
+			break;
+		}
+	}
+	if(pos == (int)w->items.size() && !w->complete){
+		// after the window, where items are unknown
+		return;
+	}
+	w->items.insert(w->items.begin() + pos, item);
+	int64_t n = item_bytes(item);
+	e->bytes += n;
+	bytes += n;
+	if((int)w->items.size() > top){
+		n = item_bytes(w->items.back());
+		e->bytes -= n;
+		bytes -= n;
+		w->items.pop_back();
+		w->complete = false;
+	}
+}
+
+void ZTopCache::apply(const Change &c){
+	Entry *e = this->find(c.name);
+	if(e == NULL){
+		return;
+	}
+	e->gen ++;
+	if(!e->loaded){
+		return;
+	}
+	if(c.op == 'r'){
+		this->unload(e);
+		return;
+	}
+	window_del(e, &e->head, c.key);
+	window_del(e, &e->tail, c.key);
+	if(c.op == 's'){
+		Item item;
+		item.key = c.key;
+		item.score = str_to_int64(c.score);
+		item.score_str = c.score;
+		window_set(e, &e->head, false, item);
+		window_set(e, &e->tail, true, item);
+	}
+	if((!e->head.complete && (int)e->head.items.size() * 2 < top)
+		|| (!e->tail.complete && (int)e->tail.items.size() * 2 < top))
+	{
+		this->unload(e);
+	}
+}
+
+int ZTopCache::range(const Bytes &name, uint64_t offset, uint64_t limit, bool reverse,
+		std::vector<std::string> *list)
+{
+	Locking l(&mutex);
+	Entry *e = this->find(name);
+	if(e == NULL){
+		return -1;
+	}
+	if(!e->loaded){
+		misses ++;
+		return 0;
+	}
+	const Window &w = reverse? e->tail : e->head;
+	uint64_t size = w.items.size();
+	uint64_t end = offset + limit;
+	if(end < offset || end > size){
+		if(!w.complete){
+			misses ++;
+			return -1;
+		}
+		end = size;
+	}
+	for(uint64_t i=offset; i<end; i++){
+		list->push_back(w.items[i].key);
+		list->push_back(w.items[i].score_str);
+	}
+	e->last_access = ++clock;
+	hits ++;
+	return 1;
+}
+
+int ZTopCache::rank(const Bytes &name, const Bytes &key, bool reverse, int64_t *rank){
+	Locking l(&mutex);
+	Entry *e = this->find(name);
+	if(e == NULL){
+		return -1;
+	}
+	if(!e->loaded){
+		misses ++;
+		return 0;
+	}
+	const Window &w = reverse? e->tail : e->head;
+	*rank = -1;
+	for(int i=0; i<(int)w.items.size(); i++){
+		if(key == w.items[i].key){
+			*rank = i;
+			break;
+		}
+	}
+	if(*rank == -1 && !w.complete){
+		misses ++;
+		return -1;
+	}
+	e->last_access = ++clock;
+	hits ++;
+	return 1;
+}
+
+bool ZTopCache::loaded(const Bytes &name){
+	Locking l(&mutex);
+	Entry *e = this->find(name);
+	return e != NULL && e->loaded;
+}
+
+uint64_t ZTopCache::loading(const Bytes &name){
+	Locking l(&mutex);
+	Entry *e = this->find(name);
+	return e? e->gen : 0;
+}
+
+void ZTopCache::load(const Bytes &name, uint64_t gen,
+		const std::vector<std::string> &head, const std::vector<std::string> &tail)
+{
+	Window wins[2];
+	const std::vector<std::string> *lists[2] = {&head, &tail};
+	int64_t nb = 0;
+	for(int i=0; i<2; i++){
+		const std::vector<std::string> &list = *lists[i];
+		for(int j=0; j+1<(int)list.size(); j+=2){
+			Item item;
+			item.key = list[j];
+			item.score_str = list[j + 1];
+			item.score = str_to_int64(item.score_str);
+			nb += item_bytes(item);
+			wins[i].items.push_back(item);
+		}
+		wins[i].complete = ((int)wins[i].items.size() < top);
+	}
+
+	Locking l(&mutex);
+	Entry *e = this->find(name);
+	if(e == NULL || e->loaded || e->gen != gen){
+		return;
+	}
+	while(bytes + nb > memory){
+		Entry *lru = NULL;
+		std::map<std::string, Entry>::iterator it;
+		for(it = zsets.begin(); it != zsets.end(); it++){
+			Entry *t = &it->second;
+			if(t->loaded && (lru == NULL || t->last_access < lru->last_access)){
+				lru = t;
+			}
+		}
+		if(lru == NULL){
+			log_debug("zset cache: %s does not fit in memory", hexmem(name.data(), name.size()).c_str());
+			return;
+		}
+		this->unload(lru);
+	}
+	e->head.items.swap(wins[0].items);
+	e->head.complete = wins[0].complete;
+	e->tail.items.swap(wins[1].items);
+	e->tail.complete = wins[1].complete;
+	e->bytes = nb;
+	e->loaded = true;
+	e->last_access = ++clock;
+	bytes += nb;
+}
+
+std::string ZTopCache::stats(){
+	Locking l(&mutex);
+	int loaded = 0;
+	std::map<std::string, Entry>::iterator it;
+	for(it = zsets.begin(); it != zsets.end(); it++){
+		loaded += it->second.loaded;
+	}
+	char buf[256];
+	snprintf(buf, sizeof(buf), "zsets: %d, loaded: %d, top: %d, memory: %" PRId64 "/%" PRId64 ", hits: %" PRIu64 ", misses: %" PRIu64 "",
+		(int)zsets.size(), loaded, top, bytes, memory, hits, misses);
+	return std::string(buf);
+}
@@ -0,0 +1,126 @@
+#ifndef SSDB_ZTOP_CACHE_H_
+#define SSDB_ZTOP_CACHE_H_
+
+#include "include.h"
+#include <string>
+#include <map>
+#include <vector>
+#include "util/bytes.h"
+#include "util/thread.h"
+
+/**
+ * In-memory windows of the first and last @top items of the zsets named
+ * in the config, for leaderboards read by zrange/zrrange/zrank far more
+ * often than they are written.
+ *
+ * A window is loaded from the db by a reader when it is first needed,
+ * and kept up to date by zset_one/zdel_one: like MetaCache, changes made
+ * by the writer are pending until BinlogQueue::commit() succeeds. A
+ * change is applied by removing the key and inserting it again if it
+ * falls into the window, so it is harmless when a window loaded after
+ * the db write already has it. A window which is not the whole zset
+ * shrinks when its items leave, and is dropped to be loaded again when
+ * it has less than half of @top.
+ *
+ * Loaded zsets are dropped, least recently used first, to stay in the
+ * memory budget.
+ */
+class ZTopCache{
+	private:
+		struct Item{
+			std::string key;
+			int64_t score;
+			std::string score_str;
+		};
+		struct Window{
+			// by (score, key), descending in the tail window
+			std::vector<Item> items;
+			// all items of the zset are in the window
+			bool complete;
+		};
+		struct Entry{
+			bool loaded;
+			// bumped by every change, a load started before a change is
+			// not installed
+			uint64_t gen;
+			uint64_t last_access;
+			int64_t bytes;
+			Window head;
+			Window tail;
+		};
+		struct Change{
+			// 's': set, 'd': del, 'r': reset
+			char op;
+			std::string name;
+			std::string key;
+			std::string score;
+		};
+
+		int top;
+		int64_t memory;
+		int64_t bytes;
+		uint64_t clock;
+		uint64_t hits;
+		uint64_t misses;
+		// the cached zsets, fixed after the config is loaded
+		std::map<std::string, Entry> zsets;
+		std::vector<Change> pending;
+		Mutex mutex;
+
+		static int64_t item_bytes(const Item &item);
+		void apply(const Change &c);
+		void window_del(Entry *e, Window *w, const std::string &key);
+		void window_set(Entry *e, Window *w, bool desc, const Item &item);
+		void unload(Entry *e);
+		Entry* find(const Bytes &name);
+	public:
+		// memory: in bytes
+		ZTopCache(int top, int64_t memory);
+		~ZTopCache();
+
+		void add(const std::string &name);
+		int size() const{
+			return (int)zsets.size();
+		}
+		int top_size() const{
+			return top;
+		}
+		// whether @name is one of the cached zsets
+		bool cached(const Bytes &name) const{
+			return zsets.find(name.String()) != zsets.end();
+		}
+
+		/* writer thread, take effect after commit() */
+
+		void set(const Bytes &name, const Bytes &key, const std::string &score);
+		void del(const Bytes &name, const Bytes &key);
+		// forget the windows, after a write not made by zset_one/zdel_one
+		void reset(const Bytes &name);
+		void commit();
+		void rollback();
+
+		/* readers */
+
+		/**
+		 * list: key, score, ...
+		 * @return 1: served, 0: not loaded, -1: not in the window or not cached
+		 */
+		int range(const Bytes &name, uint64_t offset, uint64_t limit, bool reverse,
+				std::vector<std::string> *list);
+		// rank: -1 if not in the zset
+		// @return same as range()
+		int rank(const Bytes &name, const Bytes &key, bool reverse, int64_t *rank);
+		bool loaded(const Bytes &name);
+		// @return the generation to pass to load()
+		uint64_t loading(const Bytes &name);
+		/**
+		 * Install the windows read from the db, head and tail: key,
+		 * score, ... at most @top items each, from each end.
+		 */
+		void load(const Bytes &name, uint64_t gen,
+				const std::vector<std::string> &head, const std::vector<std::string> &tail);
+
+		std::string stats();
+};
+
+#endif
@@ -109,6 +109,11 @@ void bench(std::string cmd){
 				link->send(cmd, "z", d->key);
 			}else if(cmd == "zdel"){
 				link->send(cmd, "z", d->key);
+			}else if(cmd == "hget_miss"){
+				// field of an absent hash
+				link->send("hget", d->key, "h");
+			}else if(cmd == "zget_miss"){
+				link->send("zget", d->key, "z");
 			}else if(cmd == "qpush"){
 				link->send(cmd, "h", d->key, d->val);
 			}else if(cmd == "qpop"){
@@ -148,7 +153,8 @@ void bench(std::string cmd){
 				}
 				continue;
 			}else{
-				if(resp->at(0) != "ok"){
+				bool miss = (cmd.size() > 5 && cmd.substr(cmd.size() - 5) == "_miss");
+				if(resp->at(0) != (miss? "not_found" : "ok")){
 					log_error("bad response: %s", resp->at(0).String().c_str());
 					exit(0);
 				}
@@ -203,10 +209,12 @@ int main(int argc, char **argv){
 
 	bench("hset");
 	bench("hget");
+	bench("hget_miss");
 	bench("hdel");
 
 	bench("zset");
 	bench("zget");
+	bench("zget_miss");
 	bench("zdel");
 
 	bench("qpush");
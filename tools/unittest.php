@@ -12,11 +12,11 @@ include(dirname(__FILE__) . '/../api/php/SSDB.php');
 
 class SSDBTest extends UnitTest{
 	private $ssdb;
+	private $host = '127.0.0.1';
+	private $port = 8888;
 
 	function __construct(){
-		$host = '127.0.0.1';
-		$port = 8888;
-		$this->ssdb = new SimpleSSDB($host, $port);
+		$this->ssdb = new SimpleSSDB($this->host, $this->port);
 		$this->clear();
 	}
 
@@ -150,6 +150,143 @@ class SSDBTest extends UnitTest{
 		$this->assert($ret === 'b');
 	}
 	
+	// with server.counter_flush_interval, a counter buffered when its key
+	// expires must not be written back by the flush
+	function test_counter_expire(){
+		$ssdb = $this->ssdb;
+		$ssdb->del('TEST_c');
+		$ssdb->incr('TEST_c', 1);
+		$ssdb->request('ttl', 'TEST_c', 1);
+		$ret = $ssdb->incr('TEST_c', 1);
+		$this->assert($ret === 2);
+		$ssdb->hincr('TEST_c', 'a', 1);
+		$ssdb->request('hexpire', 'TEST_c', 1);
+		$ssdb->hincr('TEST_c', 'a', 1);
+		$ssdb->zincr('TEST_c', 'a', 1);
+		$ssdb->request('zexpire', 'TEST_c', 1);
+		$ssdb->zincr('TEST_c', 'a', 1);
+		usleep(2.5 * 1000 * 1000);
+		$ssdb->request('flush', 'counters');
+		$ret = $ssdb->get('TEST_c');
+		$this->assert($ret === null);
+		$ret = $ssdb->hget('TEST_c', 'a');
+		$this->assert($ret === null);
+		$ret = $ssdb->zget('TEST_c', 'a');
+		$this->assert($ret === null);
+	}
+
+	// with server.counter_flush_interval, every read sees a counter right
+	// after its increment, not only get, hget and zget
+	function test_counter_read(){
+		$ssdb = $this->ssdb;
+		$ssdb->del('TEST_c');
+		$ssdb->incr('TEST_c', 5);
+		$ret = $ssdb->exists('TEST_c');
+		$this->assert($ret === true);
+		$ret = $ssdb->multi_get(array('TEST_c', 'TEST_c_none'));
+		$this->assert($ret === array('TEST_c' => '5'));
+		$ret = $ssdb->scan('TEST_c', 'TEST_c'.pack('C', 255), 10);
+		$this->assert(count($ret) == 0);
+		$ret = $ssdb->scan('TEST_b'.pack('C', 255), 'TEST_c', 10);
+		$this->assert($ret === array('TEST_c' => '5'));
+		$ssdb->del('TEST_c');
+
+		$ssdb->hclear('TEST_c');
+		$ssdb->hincr('TEST_c', 'a', 2);
+		$ret = $ssdb->hexists('TEST_c', 'a');
+		$this->assert($ret === true);
+		$ret = $ssdb->multi_hget('TEST_c', array('a', 'b'));
+		$this->assert($ret === array('a' => '2'));
+		$ret = $ssdb->hsize('TEST_c');
+		$this->assert($ret === 1);
+		$ssdb->hclear('TEST_c');
+
+		$ssdb->zclear('TEST_c');
+		$ssdb->zincr('TEST_c', 'a', 3);
+		$ret = $ssdb->zexists('TEST_c', 'a');
+		$this->assert($ret === true);
+		$ret = $ssdb->zsize('TEST_c');
+		$this->assert($ret === 1);
+		$ssdb->zincr('TEST_c', 'b', 1);
+		$ret = $ssdb->zrange('TEST_c', 0, 10);
+		$this->assert($ret === array('b' => '1', 'a' => '3'));
+		$ret = $ssdb->zrank('TEST_c', 'a');
+		$this->assert($ret === 1);
+		$ssdb->zclear('TEST_c');
+	}
+
+	// expired keys in a page do not count against the limit of a scan
+	function test_kv_scan_expired(){
+		$ssdb = $this->ssdb;
+		for($i=0; $i<5; $i++){
+			$ssdb->setx('TEST_e' . $i, $i, 1);
+		}
+		for($i=5; $i<10; $i++){
+			$ssdb->set('TEST_e' . $i, $i);
+		}
+		usleep(1.5 * 1000 * 1000);
+		$ret = $ssdb->scan('TEST_e', 'TEST_e'.pack('C', 255), 5);
+		$this->assert(array_keys($ret) === array('TEST_e5', 'TEST_e6', 'TEST_e7', 'TEST_e8', 'TEST_e9'));
+		$ret = $ssdb->keys('TEST_e', 'TEST_e'.pack('C', 255), 3);
+		$this->assert($ret === array('TEST_e5', 'TEST_e6', 'TEST_e7'));
+		for($i=0; $i<5; $i++){
+			$ssdb->set('TEST_e' . $i, $i);
+			$ssdb->setx('TEST_e' . ($i + 5), $i, 1);
+		}
+		usleep(1.5 * 1000 * 1000);
+		$ret = $ssdb->rscan('TEST_e'.pack('C', 255), 'TEST_e', 5);
+		$this->assert(array_keys($ret) === array('TEST_e4', 'TEST_e3', 'TEST_e2', 'TEST_e1', 'TEST_e0'));
+		for($i=0; $i<10; $i++){
+			$ssdb->del('TEST_e' . $i);
+		}
+	}
+
+	// a value looking like having an inline ttl header is returned as set,
+	// whether leveldb.inline_ttl is enabled or not
+	function test_kv_ttl_magic(){
+		$ssdb = $this->ssdb;
+		$val = pack('C', 255) . 'TTL' . str_repeat(pack('C', 0), 7) . pack('C', 5) . 'xyz';
+		$ssdb->set('TEST_m', $val);
+		$ret = $ssdb->get('TEST_m');
+		$this->assert($ret === $val);
+		$ret = $ssdb->scan('TEST_l', 'TEST_m', 10);
+		$this->assert($ret === array('TEST_m' => $val));
+		$ssdb->del('TEST_m');
+	}
+
+	// a container emptied by hdel, zdel or qpop loses its ttl, a new
+	// container of the same name does not inherit it
+	function test_container_ttl_emptied(){
+		$ssdb = $this->ssdb;
+		$name = 'TEST_t';
+		$ssdb->hclear($name);
+		$ssdb->hset($name, 'a', 1);
+		$ssdb->request('hexpire', $name, 100);
+		$ssdb->hdel($name, 'a');
+		$ssdb->hset($name, 'b', 1);
+		$ret = $ssdb->request('httl', $name);
+		$this->assert($ret === array('-1'));
+		$ssdb->hclear($name);
+
+		$ssdb->zclear($name);
+		$ssdb->zset($name, 'a', 1);
+		$ssdb->request('zexpire', $name, 100);
+		$ssdb->zdel($name, 'a');
+		$ssdb->zset($name, 'b', 1);
+		$ret = $ssdb->request('zttl', $name);
+		$this->assert($ret === array('-1'));
+		$ssdb->zclear($name);
+
+		$ssdb->qclear($name);
+		$ssdb->qpush($name, 'a');
+		$ssdb->request('qexpire', $name, 100);
+		$ssdb->qpop($name);
+		$ssdb->qpush($name, 'b');
+		$ret = $ssdb->request('qttl', $name);
+		$this->assert($ret === array('-1'));
+		$ssdb->qclear($name);
+	}
+
 	function test_queue(){
 		$ssdb = $this->ssdb;
 		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
@@ -190,6 +327,187 @@ class SSDBTest extends UnitTest{
 		$this->assert($ret == 9);
 		$ret = $ssdb->qback($name);
 		$this->assert($ret == 0);
+		$ssdb->qclear($name);
+
+		// multi push returns the size, multi pop takes from one end
+		$ret = $ssdb->qpush_back($name, 'a', 'b', 'c');
+		$this->assert($ret === 3);
+		$ret = $ssdb->qpush_front($name, 'y', 'z');
+		$this->assert($ret === 5);
+		$ret = $ssdb->qslice($name, 0, -1);
+		$this->assert($ret == array('z', 'y', 'a', 'b', 'c'));
+		$ret = $ssdb->qpop_front($name, 2);
+		$this->assert($ret == array('z', 'y'));
+		$ret = $ssdb->qpop_back($name, 2);
+		$this->assert($ret == array('c', 'b'));
+		$ret = $ssdb->qpop_back($name, 10);
+		$this->assert($ret === array('a'));
+		$ret = $ssdb->qpop_front($name, 10);
+		$this->assert($ret === array());
+		$ret = $ssdb->qpop_front($name);
+		$this->assert($ret === null);
+		$ret = $ssdb->qpop_front($name, 0);
+		$this->assert($ret === false);
+
+		// at most 1000 items are popped at a time
+		$items = array();
+		for($i=0; $i<1500; $i++){
+			$items[] = $i;
+		}
+		$ret = call_user_func_array(array($ssdb, 'qpush_back'), array_merge(array($name), $items));
+		$this->assert($ret === 1500);
+		$ret = $ssdb->qpop_front($name, 2000);
+		$this->assert(count($ret) == 1000 && $ret[999] == 999);
+		$ret = $ssdb->qsize($name);
+		$this->assert($ret === 500);
+		$ssdb->qclear($name);
+
+		// lpush and rpush reply with the size as integers
+		$ret = $this->redis_request(array('rpush', $name, 'a', 'b'));
+		$this->assert($ret === ':2');
+		$ret = $this->redis_request(array('lpush', $name, 'c'));
+		$this->assert($ret === ':3');
+		$ssdb->qclear($name);
+	}
+
+	// send a command in the redis protocol, returns the first line of
+	// the reply
+	function redis_request($args){
+		$sock = @fsockopen($this->host, $this->port);
+		if(!$sock){
+			return false;
+		}
+		$s = '*' . count($args) . "\r\n";
+		foreach($args as $arg){
+			$s .= '$' . strlen($arg) . "\r\n" . $arg . "\r\n";
+		}
+		fwrite($sock, $s);
+		$line = fgets($sock);
+		fclose($sock);
+		return $line === false? false : rtrim($line, "\r\n");
+	}
+
+	function test_queue_block(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$ssdb->qclear($name);
+
+		// times out on an empty queue
+		$time = microtime(true);
+		$ret = $ssdb->request('qpop_block', $name, 0.5);
+		$time = microtime(true) - $time;
+		$this->assert($ssdb->last_resp->code == 'not_found');
+		$this->assert($time >= 0.45 && $time < 1.5);
+		$ssdb->request('bqpop', $name, -1);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+
+		// an item already there is popped at once
+		$ssdb->qpush($name, 'a');
+		$ret = $ssdb->request('bqpop', $name, 1);
+		$this->assert($ret === array('a'));
+
+		// a blocked client is woken up by a push on another link
+		$sock = @fsockopen($this->host, $this->port);
+		$this->assert($sock !== false);
+		if(!$sock){
+			return;
+		}
+		$req = array('bqpop', $name, '5');
+		$s = '';
+		foreach($req as $p){
+			$s .= strlen($p) . "\n" . $p . "\n";
+		}
+		fwrite($sock, $s . "\n");
+		usleep(200 * 1000);
+		$time = microtime(true);
+		$ssdb->qpush($name, 'w');
+		$resp = array();
+		while(($line = fgets($sock)) !== false && $line !== "\n"){
+			$resp[] = fgets($sock);
+		}
+		fclose($sock);
+		$time = microtime(true) - $time;
+		$this->assert($resp === array("ok\n", "w\n"));
+		$this->assert($time < 1);
+		$ret = $ssdb->qsize($name);
+		$this->assert($ret === 0);
+	}
+
+	function test_queue_trim(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$ssdb->qclear($name);
+
+		// more items than qtrim deletes in one transaction
+		for($j=0; $j<12; $j++){
+			$items = array();
+			for($i=0; $i<1000; $i++){
+				$items[] = $j * 1000 + $i;
+			}
+			$ssdb->qpush_back($name, $items);
+		}
+		$ret = $ssdb->request('qtrim_front', $name, 10500);
+		$this->assert($ret === array('10500'));
+		$ret = $ssdb->qsize($name);
+		$this->assert($ret === 1500);
+		$ret = $ssdb->qfront($name);
+		$this->assert($ret === '10500');
+		$ret = $ssdb->qback($name);
+		$this->assert($ret === '11999');
+
+		$ret = $ssdb->request('qtrim_back', $name, 1200);
+		$this->assert($ret === array('1200'));
+		$ret = $ssdb->qsize($name);
+		$this->assert($ret === 300);
+		$ret = $ssdb->qback($name);
+		$this->assert($ret === '10799');
+
+		// a count larger than the queue deletes it all
+		$ret = $ssdb->request('qtrim_front', $name, 1000);
+		$this->assert($ret === array('300'));
+		$ret = $ssdb->qsize($name);
+		$this->assert($ret === 0);
+		$ret = $ssdb->qfront($name);
+		$this->assert($ret === null);
+		$ret = $ssdb->request('qtrim_back', $name, 5);
+		$this->assert($ret === array('0'));
+		$ssdb->request('qtrim_front', $name, -1);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+
+		$ssdb->qpush_back($name, 'a', 'b', 'c');
+		$ret = $ssdb->request('qtrim_back', $name, 10);
+		$this->assert($ret === array('3'));
+		$ret = $ssdb->qback($name);
+		$this->assert($ret === null);
+		$ssdb->qpush_back($name, 'x');
+		$ret = $ssdb->qslice($name, 0, -1);
+		$this->assert($ret === array('x'));
+		$ssdb->qclear($name);
+	}
+
+	function test_stream(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+
+		$ids = $ssdb->request('xadd', $name, 'a', 'b', 'c');
+		$this->assert(count($ids) == 3);
+		$ret = $ssdb->request('xread', $name, 'g', 2);
+		$this->assert($ret == array($ids[0], 'a', $ids[1], 'b'));
+		$ret = $ssdb->request('xpending', $name, 'g', 10);
+		$this->assert(count($ret) == 4);
+		$ret = $ssdb->request('xack', $name, 'g', $ids[0]);
+		$this->assert($ret == array(1));
+		$ret = $ssdb->request('xpending', $name, 'g', 10);
+		$this->assert(count($ret) == 2 && $ret[0] == $ids[1]);
+
+		// the groups are deleted with the stream
+		$ssdb->qclear($name);
+		$ret = $ssdb->request('xpending', $name, 'g', 10);
+		$this->assert(count($ret) == 0);
+		$ssdb->request('xadd', $name, 'd');
+		$ret = $ssdb->request('xread', $name, 'g', 10);
+		$this->assert(count($ret) == 2 && $ret[1] == 'd');
+		$ssdb->qclear($name);
 	}
 
 	function test_hash(){
@@ -282,6 +600,50 @@ class SSDBTest extends UnitTest{
 		$this->assert($ret === null);
 	}
 
+	// with leveldb.small_hash_fields, a small hash is packed, and turns
+	// into rows when it grows
+	function test_hash_pack(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$ssdb->hclear($name);
+
+		$ret = $ssdb->multi_hset($name, array('a' => '1', 'b' => '2', 'c' => '3'));
+		$this->assert($ret === 3);
+		$ret = $ssdb->hget($name, 'b');
+		$this->assert($ret === '2');
+
+		// a long value converts the hash
+		$long = str_repeat('x', 300);
+		$ret = $ssdb->hset($name, 'd', $long);
+		$this->assert($ret === 1);
+		$this->assert($ssdb->hsize($name) === 4);
+		$ret = $ssdb->hscan($name, '', '', 10);
+		$this->assert($ret == array('a' => '1', 'b' => '2', 'c' => '3', 'd' => $long));
+		$ret = $ssdb->hget($name, 'a');
+		$this->assert($ret === '1');
+		$ret = $ssdb->hget($name, 'e');
+		$this->assert($ret === null);
+
+		// so does growing over small_hash_fields
+		$other = $name . '_2';
+		$ssdb->hclear($other);
+		for($i=0; $i<300; $i++){
+			$ssdb->hset($other, "k$i", $i);
+		}
+		$this->assert($ssdb->hsize($other) === 300);
+		$ret = $ssdb->hget($other, 'k0');
+		$this->assert($ret === '0');
+		$ret = $ssdb->hget($other, 'k299');
+		$this->assert($ret === '299');
+
+		$ret = $ssdb->hdel($name, 'a');
+		$this->assert($ret === 1);
+		$ret = $ssdb->hclear($name);
+		$this->assert($ret === 3);
+		$this->assert($ssdb->hsize($name) === 0);
+		$ssdb->hclear($other);
+	}
+
 	function test_zset(){
 		$ssdb = $this->ssdb;
 		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
@@ -386,6 +748,393 @@ class SSDBTest extends UnitTest{
 		$ret = $ssdb->zRemRangeByRank('z', 1, 2);
 		$this->assert($ret === 2);
 	}
+
+	// hits + misses of leveldb.zset_cache, -1 if it is not configured
+	function zset_cache_reads(){
+		$info = $this->ssdb->request('info');
+		$i = array_search('zset_cache', $info);
+		if($i === false || !preg_match('/hits: (\d+), misses: (\d+)/', $info[$i + 1], $m)){
+			return -1;
+		}
+		return $m[1] + $m[2];
+	}
+
+	// writes the same to each zset
+	function zset_cache_write($names, $cmd, $args){
+		foreach($names as $name){
+			call_user_func_array(array($this->ssdb, $cmd), array_merge(array($name), $args));
+		}
+	}
+
+	function zset_cache_check($cached, $plain){
+		$ssdb = $this->ssdb;
+		foreach(array(array(0, 20), array(90, 20), array(180, 40)) as $r){
+			$ret = $ssdb->zrange($cached, $r[0], $r[1]);
+			$this->assert($ret === $ssdb->zrange($plain, $r[0], $r[1]));
+			$ret = $ssdb->zrrange($cached, $r[0], $r[1]);
+			$this->assert($ret === $ssdb->zrrange($plain, $r[0], $r[1]));
+		}
+		foreach(array('k0', 'k5', 'k100', 'k199', 'new', 'none') as $key){
+			$ret = $ssdb->zrank($cached, $key);
+			$this->assert($ret === $ssdb->zrank($plain, $key));
+			$ret = $ssdb->zrrank($cached, $key);
+			$this->assert($ret === $ssdb->zrrank($plain, $key));
+		}
+	}
+
+	// run the server with leveldb.zset_cache for TEST_zcache, a top below
+	// 200 moves items in and out of the windows, the results must be the
+	// same as of a zset not cached
+	function test_zset_cache(){
+		$ssdb = $this->ssdb;
+		$cached = 'TEST_zcache';
+		$plain = 'TEST_zcache_plain';
+		$names = array($cached, $plain);
+		$ssdb->zclear($cached);
+		$ssdb->zclear($plain);
+		$reads = $this->zset_cache_reads();
+
+		for($i=0; $i<200; $i++){
+			$this->zset_cache_write($names, 'zset', array('k' . $i, $i * 10));
+		}
+		$this->zset_cache_check($cached, $plain);
+		// from the tail into the head, and back
+		$this->zset_cache_write($names, 'zset', array('k199', -5));
+		$this->zset_cache_check($cached, $plain);
+		$this->zset_cache_write($names, 'zincr', array('k199', 3000));
+		$this->zset_cache_check($cached, $plain);
+		// a new item between two others, then deleted
+		$this->zset_cache_write($names, 'zset', array('new', 15));
+		$this->zset_cache_check($cached, $plain);
+		$this->zset_cache_write($names, 'zdel', array('new'));
+		$this->zset_cache_check($cached, $plain);
+		// the head shrinks below half of the window
+		for($i=0; $i<150; $i++){
+			$this->zset_cache_write($names, 'zdel', array('k' . $i));
+		}
+		$this->zset_cache_check($cached, $plain);
+		for($i=0; $i<150; $i++){
+			$this->zset_cache_write($names, 'zset', array('k' . $i, 2000 - $i));
+		}
+		$this->zset_cache_check($cached, $plain);
+		$this->zset_cache_write($names, 'zclear', array());
+		$this->zset_cache_check($cached, $plain);
+
+		if($reads != -1){
+			$this->assert($this->zset_cache_reads() > $reads);
+		}
+	}
+
+	function test_zset_store(){
+		$ssdb = $this->ssdb;
+		$a = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$b = $a . '_b';
+		$dest = $a . '_dest';
+		$ssdb->zclear($a);
+		$ssdb->zclear($b);
+		$ssdb->zclear($dest);
+		$ssdb->request('multi_zset', $a, 'x', 1, 'y', 2, 'z', 3);
+		$ssdb->request('multi_zset', $b, 'y', 10, 'w', 20);
+		$ssdb->request('multi_zset', $dest, 'old', 1);
+
+		// dest is replaced
+		$ret = $ssdb->request('zunionstore', $dest, 2, $a, $b);
+		$this->assert($ret == array(4));
+		$ret = $ssdb->zscan($dest, '', '', '', 10);
+		$this->assert($ret == array('x' => 1, 'z' => 3, 'y' => 12, 'w' => 20));
+		$this->assert($ssdb->zsize($dest) === 4);
+
+		$ret = $ssdb->request('zinterstore', $dest, 2, $a, $b, 'weights', 2, 1, 'aggregate', 'max');
+		$this->assert($ret == array(1));
+		$ret = $ssdb->zscan($dest, '', '', '', 10);
+		$this->assert($ret == array('y' => 10));
+
+		$ret = $ssdb->request('zdiffstore', $dest, 2, $a, $b);
+		$this->assert($ret == array(2));
+		$ret = $ssdb->zscan($dest, '', '', '', 10);
+		$this->assert($ret == array('x' => 1, 'z' => 3));
+
+		// dest may be a source
+		$ret = $ssdb->request('zunionstore', $dest, 2, $dest, $b);
+		$this->assert($ret == array(4));
+		$this->assert($ssdb->zsize($dest) === 4);
+
+		// an empty result deletes dest
+		$ret = $ssdb->request('zinterstore', $dest, 2, $a, $a . '_none');
+		$this->assert($ret == array(0));
+		$this->assert($ssdb->zsize($dest) === 0);
+
+		// scores saturate at the int64 range
+		$ssdb->zset($b, 'y', '9223372036854775807');
+		$ret = $ssdb->request('zunionstore', $dest, 2, $a, $b, 'weights', 1, 2);
+		$this->assert($ret == array(4));
+		$ret = $ssdb->zget($dest, 'y');
+		$this->assert($ret == '9223372036854775807');
+
+		// dest keeps its ttl when the arguments are bad, loses it when replaced
+		$ssdb->request('zexpire', $dest, 100);
+		$ssdb->request('zunionstore', $dest, 2, $a, $b, 'aggregate', 'avg');
+		$ret = $ssdb->request('zttl', $dest);
+		$this->assert($ret[0] > 0);
+		$ret = $ssdb->request('zunionstore', $dest, 2, $a, $b);
+		$this->assert($ret == array(4));
+		$ret = $ssdb->request('zttl', $dest);
+		$this->assert($ret === array('-1'));
+
+		$ssdb->zclear($a);
+		$ssdb->zclear($b);
+		$ssdb->zclear($dest);
+	}
+
+	function test_zset_lex(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$ssdb->zclear($name);
+		$ssdb->request('multi_zset', $name, 'a', 0, 'b', 0, 'c', 0, 'd', 0, 'x', 1);
+
+		// the lowest score by default
+		$ret = $ssdb->request('zrangebylex', $name, '-', '+', 0, 10);
+		$this->assert($ret == array('a', 'b', 'c', 'd'));
+		$ret = $ssdb->request('zrangebylex', $name, '[b', '(d', 0, 10);
+		$this->assert($ret == array('b', 'c'));
+		$ret = $ssdb->request('zrangebylex', $name, '(a', '[c', 0, 10);
+		$this->assert($ret == array('b', 'c'));
+		$ret = $ssdb->request('zrangebylex', $name, '+', '-', 0, 10);
+		$this->assert($ret == array());
+		$ret = $ssdb->request('zrangebylex', $name, '-', '+', 1, 2);
+		$this->assert($ret == array('b', 'c'));
+		$ret = $ssdb->request('zrangebylex', $name, '-', '+', 0, 10, 1);
+		$this->assert($ret == array('x'));
+		$ret = $ssdb->request('zlexcount', $name, '[b', '+');
+		$this->assert($ret == array(3));
+
+		$ssdb->request('zrangebylex', $name, 'b', '+', 0, 10);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('zrangebylex', $name, '-', '+', 0, 10, 'x');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('zlexcount', $name, '-', '+', '1.5');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+
+		// a negative offset of LIMIT returns nothing, a negative count all
+		$ret = $this->redis_request(array('zrangebylex', $name, '-', '+', 'LIMIT', '-1', '2'));
+		$this->assert($ret === '*0');
+		$ret = $this->redis_request(array('zrangebylex', $name, '-', '+', 'LIMIT', '1', '-1'));
+		$this->assert($ret === '*3');
+		$ssdb->zclear($name);
+
+		$ssdb->request('dzclear', $name);
+		$ssdb->request('multi_dzset', $name, 'a', 0.5, 'b', 0.5, 'c', 2.5);
+		$ret = $ssdb->request('dzrangebylex', $name, '(a', '+', 0, 10);
+		$this->assert($ret == array('b'));
+		$ret = $ssdb->request('dzlexcount', $name, '-', '+', 2.5);
+		$this->assert($ret == array(1));
+		$ssdb->request('dzclear', $name);
+	}
+
+	function test_dzset(){
+		$ssdb = $this->ssdb;
+		$name = "TEST_" . str_repeat(mt_rand(), mt_rand(1, 6));
+		$ssdb->request('dzclear', $name);
+		$ssdb->request('multi_dzset', $name, 'a', '-1.5', 'b', '0', 'c', '-0',
+			'd', 'inf', 'e', '-inf', 'f', '0.25', 'g', '-100', 'h', '3');
+
+		// -0 is stored as 0, members of equal scores are in key order
+		$ret = $ssdb->request('dzrange', $name, 0, 10);
+		$this->assert($ret === array('e', '-inf', 'g', '-100', 'a', '-1.5', 'b', '0',
+			'c', '0', 'f', '0.25', 'h', '3', 'd', 'inf'));
+		$ret = $ssdb->request('dzrrange', $name, 0, 3);
+		$this->assert($ret === array('d', 'inf', 'h', '3', 'f', '0.25'));
+		$ret = $ssdb->request('dzrank', $name, 'f');
+		$this->assert($ret == array(5));
+
+		// "(" makes a bound exclusive, an empty bound is the end
+		$ret = $ssdb->request('dzscan', $name, '', '(0', 'inf', 10);
+		$this->assert($ret === array('f', '0.25', 'h', '3', 'd', 'inf'));
+		$ret = $ssdb->request('dzscan', $name, '', '-inf', '(0', 10);
+		$this->assert($ret === array('e', '-inf', 'g', '-100', 'a', '-1.5'));
+		$ret = $ssdb->request('dzcount', $name, '(-1.5', '(inf');
+		$this->assert($ret == array(4));
+
+		// paged by the last key of a page
+		$ret = $ssdb->request('dzscan', $name, '', '', '', 3);
+		$this->assert($ret === array('e', '-inf', 'g', '-100', 'a', '-1.5'));
+		$ret = $ssdb->request('dzscan', $name, 'a', '', '', 3);
+		$this->assert($ret === array('b', '0', 'c', '0', 'f', '0.25'));
+		$ret = $ssdb->request('dzscan', $name, 'b', '0', '', 3);
+		$this->assert($ret === array('c', '0', 'f', '0.25', 'h', '3'));
+		$ret = $ssdb->request('dzrscan', $name, 'h', '', '', 2);
+		$this->assert($ret === array('f', '0.25', 'c', '0'));
+
+		// not a number, or spaces around it
+		$ssdb->request('dzset', $name, 'x', 'nan');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('dzset', $name, 'x', ' 1');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('dzset', $name, 'x', '1 ');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('dzscan', $name, '', '(nan', '', 10);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		// inf + -inf is not a number
+		$ssdb->request('dzincr', $name, 'd', '-inf');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ret = $ssdb->request('dzget', $name, 'd');
+		$this->assert($ret === array('inf'));
+		$ret = $ssdb->request('dzincr', $name, 'h', '0.5');
+		$this->assert($ret === array('3.5'));
+		$ret = $ssdb->request('dzsize', $name);
+		$this->assert($ret == array(8));
+		$ssdb->request('dzclear', $name);
+
+		// with server.redis_zset: double, the redis zset commands are
+		// served by the dzset commands
+		$ssdb->zclear($name);
+		$this->redis_request(array('zadd', $name, '1.5', 'r'));
+		$ret = $ssdb->request('dzget', $name, 'r');
+		if($ssdb->last_resp->code == 'ok'){
+			$this->assert($ret === array('1.5'));
+			$ret = $this->redis_request(array('zincrby', $name, '0.25', 'r'));
+			$this->assert($ret === '$4');
+			$ret = $this->redis_request(array('zcount', $name, '(1.5', '+inf'));
+			$this->assert($ret === ':1');
+			$this->assert($ssdb->zsize($name) === 0);
+		}
+		$ssdb->zclear($name);
+		$ssdb->request('dzclear', $name);
+	}
+
+	function test_bitmap(){
+		$ssdb = $this->ssdb;
+		$a = 'TEST_bit_a';
+		$b = 'TEST_bit_b';
+		$dest = 'TEST_bit_d';
+		$ssdb->request('bclear', $a);
+		$ssdb->request('bclear', $b);
+		$ssdb->request('bclear', $dest);
+
+		$ret = $ssdb->request('setbit', $a, 7, 1);
+		$this->assert($ret === array('0'));
+		$ret = $ssdb->request('setbit', $a, 7, 1);
+		$this->assert($ret === array('1'));
+		$ret = $ssdb->request('getbit', $a, 7);
+		$this->assert($ret === array('1'));
+		$ret = $ssdb->request('getbit', $a, 6);
+		$this->assert($ret === array('0'));
+		$ret = $ssdb->request('getbit', $a, 99999);
+		$this->assert($ret === array('0'));
+		$ssdb->request('setbit', $a, 2, 'x');
+		$this->assert($ssdb->last_resp->code == 'client_error');
+
+		// a: 12 bits in 2 bytes, b: 2 bits, one of them in another chunk
+		for($i=0; $i<8; $i++){
+			$ssdb->request('setbit', $a, $i, 1);
+		}
+		for($i=12; $i<16; $i++){
+			$ssdb->request('setbit', $a, $i, 1);
+		}
+		$ssdb->request('setbit', $b, 7, 1);
+		$ssdb->request('setbit', $b, 20000, 1);
+		$ret = $ssdb->request('bitcount', $a);
+		$this->assert($ret === array('12'));
+		$ret = $ssdb->request('bitcount', $a, 1, 1);
+		$this->assert($ret === array('4'));
+		$ret = $ssdb->request('bitcount', $a, -1, -1);
+		$this->assert($ret === array('4'));
+
+		// the shorter source reads as zeros, the result is as long as the
+		// longest source
+		$ret = $ssdb->request('bitop', 'and', $dest, $a, $b);
+		$this->assert($ret === array('2501'));
+		$ret = $ssdb->request('bitcount', $dest);
+		$this->assert($ret === array('1'));
+		$ret = $ssdb->request('bitop', 'or', $dest, $a, $b);
+		$this->assert($ret === array('2501'));
+		$ret = $ssdb->request('bitcount', $dest);
+		$this->assert($ret === array('13'));
+		$ret = $ssdb->request('getbit', $dest, 20000);
+		$this->assert($ret === array('1'));
+		$ssdb->request('bitop', 'xor', $dest, $a, $b);
+		$ret = $ssdb->request('bitcount', $dest);
+		$this->assert($ret === array('12'));
+		$ret = $ssdb->request('bitop', 'not', $dest, $a);
+		$this->assert($ret === array('2'));
+		$ret = $ssdb->request('bitcount', $dest);
+		$this->assert($ret === array('4'));
+		$ssdb->request('bitop', 'not', $dest, $a, $b);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+		$ssdb->request('bitop', 'nand', $dest, $a);
+		$this->assert($ssdb->last_resp->code == 'client_error');
+
+		$ret = $ssdb->request('bclear', $dest);
+		$this->assert($ret === array('1'));
+		$ret = $ssdb->request('getbit', $dest, 0);
+		$this->assert($ret === array('0'));
+
+		// more chunks than bclear deletes in one transaction
+		for($i=0; $i<1001; $i++){
+			$ssdb->request('setbit', $a, $i * 1024 * 8 + 3, 1);
+		}
+		$ret = $ssdb->request('bclear', $a);
+		$this->assert($ret === array('1001'));
+		$ret = $ssdb->request('bitcount', $a);
+		$this->assert($ret === array('0'));
+		$ret = $ssdb->request('getbit', $a, 3);
+		$this->assert($ret === array('0'));
+		$ssdb->request('bclear', $b);
+	}
+
+	function test_hll(){
+		$ssdb = $this->ssdb;
+		$a = 'TEST_hll_a';
+		$b = 'TEST_hll_b';
+		$dest = 'TEST_hll_d';
+		$ssdb->request('pfclear', $a);
+		$ssdb->request('pfclear', $b);
+		$ssdb->request('pfclear', $dest);
+
+		$ret = $ssdb->request('pfadd', $a, 'x', 'y', 'z');
+		$this->assert($ret === array('1'));
+		$ret = $ssdb->request('pfadd', $a, 'x');
+		$this->assert($ret === array('0'));
+		$ret = $ssdb->request('pfcount', $a);
+		$this->assert($ret === array('3'));
+		$ret = $ssdb->request('pfcount', $dest);
+		$this->assert($ret === array('0'));
+
+		// b: dense, the standard error is 0.81%
+		for($j=0; $j<20; $j++){
+			$items = array();
+			for($i=0; $i<1000; $i++){
+				$items[] = 'b' . ($j * 1000 + $i);
+			}
+			$ssdb->request('pfadd', $b, $items);
+		}
+		$ret = $ssdb->request('pfcount', $b);
+		$this->assert(abs($ret[0] - 20000) < 20000 * 0.03);
+
+		// a: sparse, small counts are nearly exact
+		$items = array();
+		for($i=0; $i<97; $i++){
+			$items[] = 'a' . $i;
+		}
+		$ssdb->request('pfadd', $a, $items);
+		$ret = $ssdb->request('pfcount', $a);
+		$this->assert(abs($ret[0] - 100) <= 2);
+		$ret = $ssdb->request('pfcount', $a, $b);
+		$this->assert(abs($ret[0] - 20100) < 20100 * 0.03);
+
+		// a sparse dest becomes dense
+		$ssdb->request('pfmerge', $a, $a, $b);
+		$this->assert($ssdb->last_resp->code == 'ok');
+		$ret = $ssdb->request('pfcount', $a);
+		$this->assert(abs($ret[0] - 20100) < 20100 * 0.03);
+		$ssdb->request('pfmerge', $dest, $a, $b);
+		$ret2 = $ssdb->request('pfcount', $dest);
+		$this->assert($ret2 === $ret);
+
+		$ssdb->request('pfclear', $a);
+		$ssdb->request('pfclear', $b);
+		$ssdb->request('pfclear', $dest);
+	}
 }
 
 class UnitTest{